@@ -0,0 +1,279 @@
+// Throughput and latency benchmark for the queued logger (src/modules/logger.cpp).
+// Measures, against whatever filesystem the HAL provides:
+//   - enqueue: logger_log() latency percentiles into a non-full queue
+//   - drain:   logger_process_queue() cost per entry and entries/s, including rotation
+//   - bursts:  drop rate for burst profiles against one drain call per loop iteration
+//   - allocs:  heap allocations per enqueued and per written entry (host only)
+// and prints the results as one JSON document, so runs from different commits
+// can be compared with tools/bench_compare.py.
+//
+// Host, against the RAM filesystem of src/hal/native:
+//   pio run -e logger_bench && .pio/build/logger_bench/program [--iterations N] > before.json
+// Device, against LittleFS (erases /logs.txt and /logs_old.txt; JSON is printed once over serial):
+//   pio run -e logger_bench_esp32 -t upload && pio device monitor
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal/clock.h"
+#include "hal/fs.h"
+#include "modules/logger.h"
+
+#ifdef HAL_NATIVE
+#include <chrono>
+#include <new>
+#include "native.h"
+#define BENCH_PLATFORM "native"
+#define BENCH_MAX_SAMPLES 200000
+#define BENCH_DEFAULT_ITERATIONS 100000
+#else
+#define BENCH_PLATFORM "esp32"
+#define BENCH_MAX_SAMPLES 4000
+#define BENCH_DEFAULT_ITERATIONS 2000
+#endif
+
+// A typical control-loop message and a message at the entry size limit
+static const char *SHORT_MESSAGE = "Pump 3 dosed 12.50 ml in 4210 ms (cal 1.042 ml/s)";
+static char long_message[MAX_LOG_ENTRY_SIZE];
+
+static uint32_t samples[BENCH_MAX_SAMPLES];
+static int iterations = BENCH_DEFAULT_ITERATIONS;
+
+#ifdef HAL_NATIVE
+// Every String and RAM-file allocation goes through operator new
+static unsigned long alloc_count = 0;
+
+void *operator new(size_t size) {
+    alloc_count++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#else
+static uint64_t now_ns() {
+    // Cycle counter: 4.2 ns resolution at 240 MHz, wraps after ~17 s
+    static uint32_t last = 0;
+    static uint64_t high = 0;
+    uint32_t now = ESP.getCycleCount();
+    if (now < last) high += 1ULL << 32;
+    last = now;
+    return (high + now) * 1000ULL / getCpuFrequencyMhz();
+}
+#endif
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *sorted, int count, int pct) {
+    int index = (int)((long)count * pct / 100);
+    if (index >= count) index = count - 1;
+    return sorted[index];
+}
+
+static void drain_all() {
+    while (logger_get_queue_count() > 0) logger_process_queue();
+}
+
+static void reset_logger() {
+    logger_clear();
+    logger_init();
+    drain_all();
+    logger_clear();
+}
+
+// Latency of logger_log() with room in the queue; the queue is drained between
+// rounds outside the timed region
+static void bench_enqueue(const char *name, const char *message, String &json) {
+    reset_logger();
+    int count = iterations < BENCH_MAX_SAMPLES ? iterations : BENCH_MAX_SAMPLES;
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        if (logger_get_queue_count() >= LOG_QUEUE_SIZE - 1) drain_all();
+        uint64_t start = now_ns();
+        logger_log(message);
+        uint32_t ns = (uint32_t)(now_ns() - start);
+        samples[i] = ns;
+        total += ns;
+    }
+    qsort(samples, count, sizeof(samples[0]), compare_u32);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "\"%s\":{\"calls\":%d,\"mean_ns\":%lu,\"p50_ns\":%lu,\"p90_ns\":%lu,\"p99_ns\":%lu,\"max_ns\":%lu}",
+             name, count, (unsigned long)(total / count), (unsigned long)percentile(samples, count, 50),
+             (unsigned long)percentile(samples, count, 90), (unsigned long)percentile(samples, count, 99),
+             (unsigned long)samples[count - 1]);
+    json += buf;
+}
+
+// Cost of writing queued entries out; runs long enough to rotate the file several times
+static void bench_drain(const char *name, const char *message, String &json) {
+    reset_logger();
+    unsigned long written_before = logger_get_written_count();
+    unsigned long entries = 0;
+    unsigned long calls = 0;
+    uint64_t total = 0;
+    uint32_t max_call = 0;
+    while (entries < (unsigned long)iterations) {
+        while (logger_get_queue_count() < LOG_QUEUE_SIZE) logger_log(message);
+        entries += LOG_QUEUE_SIZE;
+        while (logger_get_queue_count() > 0) {
+            uint64_t start = now_ns();
+            logger_process_queue();
+            uint32_t ns = (uint32_t)(now_ns() - start);
+            total += ns;
+            if (ns > max_call) max_call = ns;
+            calls++;
+        }
+    }
+    unsigned long written = logger_get_written_count() - written_before;
+    double seconds = total / 1e9;
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "\"%s\":{\"entries\":%lu,\"calls\":%lu,\"ns_per_entry\":%lu,\"entries_per_s\":%lu,"
+             "\"max_call_ns\":%lu,\"file_bytes\":%lu}",
+             name, written, calls, written ? (unsigned long)(total / written) : 0UL,
+             seconds > 0 ? (unsigned long)(written / seconds) : 0UL, (unsigned long)max_call,
+             (unsigned long)logger_get_file_size());
+    json += buf;
+}
+
+struct BurstProfile {
+    const char *name;
+    int burst;       // Messages logged ...
+    int every;       // ... every this many loop iterations
+};
+
+// One logger_process_queue() per loop iteration, as in loop(); drops are what
+// logger_get_dropped_count() reports
+static const BurstProfile profiles[] = {
+    {"steady_5", 5, 1},
+    {"steady_20", 20, 1},
+    {"steady_25", 25, 1},
+    {"burst_50_every_5", 50, 5},
+    {"burst_150_every_10", 150, 10},
+    {"burst_500_once", 500, 0},
+};
+
+static void bench_bursts(String &json) {
+    json += "\"bursts\":{";
+    for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+        const BurstProfile &profile = profiles[p];
+        reset_logger();
+        unsigned long dropped_before = logger_get_dropped_count();
+        unsigned long logged = 0;
+        int max_queue = 0;
+        int loops = profile.every ? iterations / profile.burst * profile.every : 1;
+        for (int i = 0; i < loops; i++) {
+            if (profile.every ? i % profile.every == 0 : i == 0) {
+                for (int m = 0; m < profile.burst; m++) logger_log(SHORT_MESSAGE);
+                logged += profile.burst;
+            }
+            if (logger_get_queue_count() > max_queue) max_queue = logger_get_queue_count();
+            logger_process_queue();
+        }
+        drain_all();
+        unsigned long dropped = logger_get_dropped_count() - dropped_before;
+
+        char buf[192];
+        snprintf(buf, sizeof(buf), "%s\"%s\":{\"logged\":%lu,\"dropped\":%lu,\"drop_rate\":%.4f,\"max_queue\":%d}",
+                 p ? "," : "", profile.name, logged, dropped, logged ? (double)dropped / logged : 0.0, max_queue);
+        json += buf;
+    }
+    json += "}";
+}
+
+static void bench_allocations(String &json) {
+#ifdef HAL_NATIVE
+    reset_logger();
+    const int rounds = 50;
+    unsigned long enqueue_allocs = 0, drain_allocs = 0;
+    for (int r = 0; r < rounds; r++) {
+        unsigned long before = alloc_count;
+        for (int i = 0; i < LOG_QUEUE_SIZE; i++) logger_log(SHORT_MESSAGE);
+        enqueue_allocs += alloc_count - before;
+        before = alloc_count;
+        drain_all();
+        drain_allocs += alloc_count - before;
+    }
+    unsigned long entries = (unsigned long)rounds * LOG_QUEUE_SIZE;
+    char buf[128];
+    snprintf(buf, sizeof(buf), "\"allocations\":{\"per_enqueue\":%.2f,\"per_written_entry\":%.2f}",
+             (double)enqueue_allocs / entries, (double)drain_allocs / entries);
+    json += buf;
+#else
+    // No allocation hook on the device; the heap low-water mark shows the peak instead
+    json += "\"allocations\":null,\"min_free_heap\":" + String(ESP.getMinFreeHeap());
+#endif
+}
+
+static String run_suite() {
+    memset(long_message, 'x', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+
+    String json = "{\"suite\":\"logger\",\"platform\":\"" BENCH_PLATFORM "\"";
+    json += ",\"config\":{\"queue_size\":" + String(LOG_QUEUE_SIZE) + ",\"max_entry\":" +
+            String(MAX_LOG_ENTRY_SIZE) + ",\"max_file\":" + String(MAX_LOG_FILE_SIZE) +
+            ",\"iterations\":" + String(iterations) + "},\"enqueue\":{";
+    bench_enqueue("short", SHORT_MESSAGE, json);
+    json += ",";
+    bench_enqueue("long", long_message, json);
+    json += "},\"drain\":{";
+    bench_drain("short", SHORT_MESSAGE, json);
+    json += ",";
+    bench_drain("long", long_message, json);
+    json += "},";
+    bench_bursts(json);
+    json += ",";
+    bench_allocations(json);
+    json += "}";
+    logger_clear();
+    return json;
+}
+
+#ifdef HAL_NATIVE
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations < LOG_QUEUE_SIZE) iterations = LOG_QUEUE_SIZE;
+    hal_native_set_epoch(1704063600);
+    String json = run_suite();
+    puts(json.c_str());
+    return 0;
+}
+#else
+void setup() {
+    Serial.begin(115200);
+    delay(2000); // Time to open the monitor
+    String json = run_suite();
+    Serial.println();
+    Serial.println("LOGGER_BENCH_JSON " + json);
+}
+
+void loop() {
+    delay(1000);
+}
+#endif
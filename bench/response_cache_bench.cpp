@@ -0,0 +1,92 @@
+// Host-side microbenchmark for the cached GET handlers.
+// Compares rebuilding a response body on every request (the old handler path)
+// with serving it from the response cache, for a settings endpoint and for
+// a cache that is invalidated every few requests.
+//
+//   pio run -e native_bench && .pio/build/native_bench/program
+// or
+//   g++ -O2 -Isrc bench/response_cache_bench.cpp src/modules/response_cache.cpp src/modules/api_json.cpp
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config/config.h"
+#include "modules/api_json.h"
+#include "modules/response_cache.h"
+#include "modules/settings_store.h"
+
+float weekly_dosing_ml[7][NUM_FERTILIZERS];
+bool weekly_watering_enabled[7];
+ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS] = {{8, 0, SCHEDULE_EVERY_DAY}};
+unsigned long schedule_catchup_s = SCHEDULE_MAX_LATE_S;
+float pump_calibration[NUM_FERTILIZERS] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+int fertilizer_motor_speed = 255;
+unsigned long watering_duration_ms = 30000;
+
+static const int ITERATIONS = 200000;
+static volatile size_t sink = 0; // Keeps the compiler from dropping the work
+
+static double ns_per_op(std::chrono::steady_clock::time_point start, int ops) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+// Old path: every request allocates and renders the body
+static double bench_rebuild(ResponseBuilder builder) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t needed = builder(nullptr, 0);
+        char *buf = (char *)malloc(needed + 1);
+        builder(buf, needed + 1);
+        sink += buf[needed / 2];
+        free(buf);
+    }
+    return ns_per_op(start, ITERATIONS);
+}
+
+// New path: rebuild only when the version changes. A 200 response still copies
+// the body (String(cached.body) in send_cached_json), so that is timed too.
+static double bench_cached(ResponseCacheSlot slot, ResponseBuilder builder, int requests_per_change) {
+    response_cache_clear();
+    uint64_t version = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (requests_per_change > 0 && i % requests_per_change == 0) version++;
+        CachedResponse cached;
+        if (response_cache_get(slot, version, builder, cached)) {
+            size_t length = strlen(cached.body);
+            char *body = (char *)malloc(length + 1);
+            memcpy(body, cached.body, length + 1);
+            sink += body[length / 2];
+            free(body);
+        }
+    }
+    return ns_per_op(start, ITERATIONS);
+}
+
+static void report(const char *name, ResponseCacheSlot slot, ResponseBuilder builder) {
+    double rebuild = bench_rebuild(builder);
+    double hit = bench_cached(slot, builder, 0);
+    double mixed = bench_cached(slot, builder, 10);
+    printf("%-26s rebuild %8.1f ns  cached %8.1f ns  (1 change/10 req) %8.1f ns  speedup %5.1fx\n",
+           name, rebuild, hit, mixed, rebuild / hit);
+}
+
+int main() {
+    for (int day = 0; day < 7; day++) {
+        weekly_watering_enabled[day] = day % 2 == 0;
+        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+            weekly_dosing_ml[day][fert] = 1.25f * (day + 1) * (fert + 1);
+        }
+    }
+
+    report("/api/weekly_dosing", RC_WEEKLY_DOSING, api_json_weekly_dosing);
+    report("/api/weekly_watering", RC_WEEKLY_WATERING, api_json_weekly_watering_enabled);
+    report("/api/schedule", RC_SCHEDULE, api_json_schedule);
+    report("/api/calibration", RC_CALIBRATION, api_json_calibration);
+    report("/api/watering_duration", RC_WATERING_DURATION, api_json_watering_duration);
+
+    printf("cache hits %lu, misses %lu\n", response_cache_get_hits(), response_cache_get_misses());
+    return 0;
+}
@@ -0,0 +1,456 @@
+// REST API load generator. Keeps --concurrency requests in flight against the
+// controller (or the host stand-in, loadtest/standin.cpp) for --duration seconds,
+// picking each request from a weighted mix of
+//   status    GET  /api/status
+//   logs      GET  /api/logs
+//   settings  POST /api/schedule with the catch-up window read at startup, so nothing changes
+// and polls the free heap from /api/metrics once a second while it runs.
+// Prints one JSON document: per endpoint p50/p95/p99 latency (connect to last
+// byte), status codes and error rate, and the heap over the run. Runs can be
+// compared with tools/bench_compare.py.
+//
+//   pio run -e loadgen
+//   .pio/build/loadgen/program --host 192.168.1.50 --concurrency 4 --duration 30 --mix status:70,logs:20,settings:10
+// Against the stand-in:
+//   pio run -e api_standin && .pio/build/api_standin/program &
+//   .pio/build/loadgen/program --port 8080
+//
+// Errors: connect (refused or timed out), timeout (no complete response within
+// --timeout-ms), reset (connection dropped mid-response), http (4xx/5xx other
+// than 503) and rejected (503, the command queue was full).
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum Endpoint {
+    EP_STATUS,
+    EP_LOGS,
+    EP_SETTINGS,
+    EP_COUNT
+};
+
+static const char *endpoint_names[EP_COUNT] = {"status", "logs", "settings"};
+
+enum Outcome {
+    OUT_OK,
+    OUT_CONNECT,
+    OUT_TIMEOUT,
+    OUT_RESET,
+    OUT_HTTP,
+    OUT_REJECTED,
+    OUT_COUNT
+};
+
+static const char *outcome_names[OUT_COUNT] = {"ok", "connect", "timeout", "reset", "http", "rejected"};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 80;
+    int concurrency = 4;
+    double duration_s = 10;
+    long max_requests = 0;          // 0 = run for duration_s
+    int timeout_ms = 5000;
+    int weights[EP_COUNT] = {70, 20, 10};
+    std::string metrics_path = "/api/metrics";
+    int metrics_interval_ms = 1000;
+    unsigned seed = 1;
+};
+
+struct EndpointStats {
+    std::vector<uint32_t> latency_us;   // Successful requests only
+    unsigned long outcomes[OUT_COUNT] = {};
+    std::map<int, unsigned long> codes;
+};
+
+struct Response {
+    Outcome outcome;
+    int code;
+    std::string body;
+};
+
+struct HeapStats {
+    unsigned long samples = 0;
+    unsigned long errors = 0;
+    long start = -1;
+    long end = -1;
+    long min_free = -1;
+    long min_largest_block = -1;
+};
+
+static Options options;
+static struct sockaddr_in target;
+static std::string settings_body;
+static std::atomic<long> requests_started(0);
+static std::atomic<bool> stopping(false);
+
+static bool resolve(const std::string &host, int port) {
+    struct addrinfo hints, *result = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) return false;
+    memcpy(&target, result->ai_addr, sizeof(target));
+    target.sin_port = htons(port);
+    freeaddrinfo(result);
+    return true;
+}
+
+static bool timed_out() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == ETIMEDOUT;
+}
+
+// One request on a fresh connection, as a browser talking to AsyncWebServer does
+static Response request(const char *method, const std::string &path, const std::string &body) {
+    Response response = {OUT_OK, 0, std::string()};
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        response.outcome = OUT_CONNECT;
+        return response;
+    }
+    struct timeval tv = {options.timeout_ms / 1000, (options.timeout_ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)); // Also bounds connect()
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (struct sockaddr *)&target, sizeof(target)) < 0) {
+        response.outcome = OUT_CONNECT;
+        close(fd);
+        return response;
+    }
+
+    std::string out = std::string(method) + " " + path + " HTTP/1.1\r\nHost: " + options.host +
+                      "\r\nConnection: close\r\n";
+    if (!body.empty()) {
+        out += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+               std::to_string(body.size()) + "\r\n";
+    }
+    out += "\r\n" + body;
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            response.outcome = n < 0 && timed_out() ? OUT_TIMEOUT : OUT_RESET;
+            close(fd);
+            return response;
+        }
+        sent += n;
+    }
+
+    // Read to the end of the body (Content-Length) or until the server closes
+    std::string in;
+    size_t header_end = std::string::npos;
+    size_t content_length = std::string::npos;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+    for (;;) {
+        char buf[4096];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            response.outcome = timed_out() ? OUT_TIMEOUT : OUT_RESET;
+            break;
+        }
+        if (n == 0) {
+            if (header_end == std::string::npos ||
+                (content_length != std::string::npos && in.size() < header_end + 4 + content_length)) {
+                response.outcome = OUT_RESET;
+            }
+            break;
+        }
+        in.append(buf, n);
+        if (header_end == std::string::npos) {
+            header_end = in.find("\r\n\r\n");
+            if (header_end != std::string::npos) {
+                std::string headers = in.substr(0, header_end);
+                std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+                size_t pos = headers.find("\r\ncontent-length:");
+                if (pos != std::string::npos) content_length = strtoul(headers.c_str() + pos + 17, nullptr, 10);
+            }
+        }
+        if (content_length != std::string::npos && in.size() >= header_end + 4 + content_length) break;
+        if (std::chrono::steady_clock::now() > deadline) {
+            response.outcome = OUT_TIMEOUT;
+            break;
+        }
+    }
+    close(fd);
+    if (response.outcome != OUT_OK) return response;
+
+    if (sscanf(in.c_str(), "HTTP/%*s %d", &response.code) != 1) {
+        response.outcome = OUT_RESET;
+        return response;
+    }
+    response.body = in.substr(header_end + 4);
+    if (response.code == 503) response.outcome = OUT_REJECTED;
+    else if (response.code >= 400) response.outcome = OUT_HTTP;
+    return response;
+}
+
+static Response request_endpoint(Endpoint endpoint) {
+    switch (endpoint) {
+        case EP_STATUS: return request("GET", "/api/status", "");
+        case EP_LOGS: return request("GET", "/api/logs", "");
+        case EP_SETTINGS: return request("POST", "/api/schedule", settings_body);
+        default: break;
+    }
+    return Response{OUT_HTTP, 0, std::string()};
+}
+
+static void worker(int index, EndpointStats *stats, std::chrono::steady_clock::time_point end) {
+    std::mt19937 rng(options.seed * 7919 + index);
+    int total_weight = 0;
+    for (int e = 0; e < EP_COUNT; e++) total_weight += options.weights[e];
+
+    while (!stopping) {
+        if (options.max_requests ? requests_started++ >= options.max_requests
+                                 : std::chrono::steady_clock::now() >= end) {
+            break;
+        }
+        int pick = (int)(rng() % total_weight);
+        int endpoint = 0;
+        while (pick >= options.weights[endpoint]) pick -= options.weights[endpoint++];
+
+        auto start = std::chrono::steady_clock::now();
+        Response response = request_endpoint((Endpoint)endpoint);
+        uint32_t us = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        EndpointStats &s = stats[endpoint];
+        s.outcomes[response.outcome]++;
+        if (response.code) s.codes[response.code]++;
+        if (response.outcome == OUT_OK) s.latency_us.push_back(us);
+    }
+}
+
+// Value of a Prometheus sample line "name value"
+static long metric_value(const std::string &text, const char *name) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        if (text.compare(pos, len, name) == 0 && pos + len < end && text[pos + len] == ' ') {
+            return strtol(text.c_str() + pos + len + 1, nullptr, 10);
+        }
+        pos = end + 1;
+    }
+    return -1;
+}
+
+static void sample_heap(HeapStats &heap) {
+    Response response = request("GET", options.metrics_path, "");
+    long free_bytes = response.outcome == OUT_OK ? metric_value(response.body, "irrigation_heap_free_bytes") : -1;
+    if (free_bytes < 0) {
+        heap.errors++;
+        return;
+    }
+    long largest = metric_value(response.body, "irrigation_heap_largest_free_block_bytes");
+    heap.samples++;
+    if (heap.start < 0) heap.start = free_bytes;
+    heap.end = free_bytes;
+    if (heap.min_free < 0 || free_bytes < heap.min_free) heap.min_free = free_bytes;
+    if (largest >= 0 && (heap.min_largest_block < 0 || largest < heap.min_largest_block)) {
+        heap.min_largest_block = largest;
+    }
+}
+
+static void heap_poller(HeapStats *heap) {
+    while (!stopping) {
+        auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.metrics_interval_ms);
+        sample_heap(*heap);
+        while (!stopping && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+// Settings POSTs write back the current catch-up window, so a load test leaves the device as it was
+static bool read_schedule() {
+    Response response = request("GET", "/api/schedule", "");
+    unsigned long catchup_s;
+    const char *c = strstr(response.body.c_str(), "\"catchup_s\":");
+    if (response.outcome != OUT_OK || !c || sscanf(c + 12, "%lu", &catchup_s) != 1) {
+        return false;
+    }
+    settings_body = "catchup_s=" + std::to_string(catchup_s);
+    return true;
+}
+
+static double percentile_ms(const std::vector<uint32_t> &sorted, int pct) {
+    if (sorted.empty()) return 0;
+    size_t index = sorted.size() * pct / 100;
+    if (index >= sorted.size()) index = sorted.size() - 1;
+    return sorted[index] / 1000.0;
+}
+
+static bool parse_mix(const char *text) {
+    for (int e = 0; e < EP_COUNT; e++) options.weights[e] = 0;
+    std::string mix = text;
+    size_t pos = 0;
+    while (pos < mix.size()) {
+        size_t end = mix.find(',', pos);
+        if (end == std::string::npos) end = mix.size();
+        std::string item = mix.substr(pos, end - pos);
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) return false;
+        std::string name = item.substr(0, colon);
+        int e = 0;
+        while (e < EP_COUNT && name != endpoint_names[e]) e++;
+        if (e == EP_COUNT) return false;
+        options.weights[e] = atoi(item.c_str() + colon + 1);
+        if (options.weights[e] < 0) return false;
+        pos = end + 1;
+    }
+    int total = 0;
+    for (int e = 0; e < EP_COUNT; e++) total += options.weights[e];
+    return total > 0;
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [--host H] [--port N] [--concurrency N] [--duration S | --requests N]\n"
+            "          [--mix status:70,logs:20,settings:10] [--timeout-ms N] [--metrics PATH]\n"
+            "          [--metrics-interval-ms N] [--seed N]\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            print_usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--host") == 0) options.host = value;
+        else if (strcmp(arg, "--port") == 0) options.port = atoi(value);
+        else if (strcmp(arg, "--concurrency") == 0) options.concurrency = atoi(value);
+        else if (strcmp(arg, "--duration") == 0) options.duration_s = atof(value);
+        else if (strcmp(arg, "--requests") == 0) options.max_requests = atol(value);
+        else if (strcmp(arg, "--timeout-ms") == 0) options.timeout_ms = atoi(value);
+        else if (strcmp(arg, "--metrics") == 0) options.metrics_path = value;
+        else if (strcmp(arg, "--metrics-interval-ms") == 0) options.metrics_interval_ms = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (unsigned)atol(value);
+        else if (strcmp(arg, "--mix") == 0) {
+            if (!parse_mix(value)) {
+                fprintf(stderr, "bad --mix '%s': expected name:weight,... with names status, logs, settings\n", value);
+                return 2;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.concurrency < 1 || options.timeout_ms < 1 || options.metrics_interval_ms < 1) {
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (!resolve(options.host, options.port)) {
+        fprintf(stderr, "cannot resolve %s\n", options.host.c_str());
+        return 1;
+    }
+    if (options.weights[EP_SETTINGS] > 0 && !read_schedule()) {
+        fprintf(stderr, "cannot read /api/schedule from %s:%d\n", options.host.c_str(), options.port);
+        return 1;
+    }
+
+    HeapStats heap;
+    std::vector<EndpointStats> per_worker((size_t)options.concurrency * EP_COUNT);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::microseconds((int64_t)(options.duration_s * 1e6));
+    std::thread poller(heap_poller, &heap);
+    for (int i = 0; i < options.concurrency; i++) {
+        threads.emplace_back(worker, i, &per_worker[(size_t)i * EP_COUNT], end);
+    }
+    for (std::thread &thread : threads) thread.join();
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stopping = true;
+    poller.join();
+    sample_heap(heap); // After the load
+
+    EndpointStats totals[EP_COUNT];
+    for (int i = 0; i < options.concurrency; i++) {
+        for (int e = 0; e < EP_COUNT; e++) {
+            const EndpointStats &s = per_worker[(size_t)i * EP_COUNT + e];
+            EndpointStats &t = totals[e];
+            t.latency_us.insert(t.latency_us.end(), s.latency_us.begin(), s.latency_us.end());
+            for (int o = 0; o < OUT_COUNT; o++) t.outcomes[o] += s.outcomes[o];
+            for (const auto &code : s.codes) t.codes[code.first] += code.second;
+        }
+    }
+
+    unsigned long all_requests = 0, all_errors = 0, all_outcomes[OUT_COUNT] = {};
+    std::string endpoints;
+    for (int e = 0; e < EP_COUNT; e++) {
+        EndpointStats &t = totals[e];
+        unsigned long requests = 0;
+        for (int o = 0; o < OUT_COUNT; o++) {
+            requests += t.outcomes[o];
+            all_outcomes[o] += t.outcomes[o];
+        }
+        if (requests == 0) continue;
+        unsigned long errors = requests - t.outcomes[OUT_OK];
+        all_requests += requests;
+        all_errors += errors;
+        std::sort(t.latency_us.begin(), t.latency_us.end());
+        double mean_ms = 0;
+        for (uint32_t us : t.latency_us) mean_ms += us;
+        if (!t.latency_us.empty()) mean_ms /= t.latency_us.size() * 1000.0;
+
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"requests\":%lu,\"ok\":%lu,\"errors\":%lu,\"error_rate\":%.4f,\"mean_ms\":%.2f,"
+                 "\"p50_ms\":%.2f,\"p95_ms\":%.2f,\"p99_ms\":%.2f,\"max_ms\":%.2f,\"codes\":{",
+                 endpoints.empty() ? "" : ",", endpoint_names[e], requests, t.outcomes[OUT_OK], errors,
+                 (double)errors / requests, mean_ms, percentile_ms(t.latency_us, 50), percentile_ms(t.latency_us, 95),
+                 percentile_ms(t.latency_us, 99), t.latency_us.empty() ? 0.0 : t.latency_us.back() / 1000.0);
+        endpoints += buf;
+        bool first = true;
+        for (const auto &code : t.codes) {
+            snprintf(buf, sizeof(buf), "%s\"%d\":%lu", first ? "" : ",", code.first, code.second);
+            endpoints += buf;
+            first = false;
+        }
+        endpoints += "}}";
+    }
+
+    printf("{\"tool\":\"loadgen\",\"target\":\"%s:%d\",\"config\":{\"concurrency\":%d,\"duration_s\":%.1f,"
+           "\"requests\":%ld,\"timeout_ms\":%d,\"mix\":{\"status\":%d,\"logs\":%d,\"settings\":%d}},\n",
+           options.host.c_str(), options.port, options.concurrency, options.duration_s, options.max_requests,
+           options.timeout_ms, options.weights[EP_STATUS], options.weights[EP_LOGS], options.weights[EP_SETTINGS]);
+    printf(" \"elapsed_s\":%.2f,\"requests\":%lu,\"requests_per_s\":%.1f,\"error_rate\":%.4f,\"errors\":{",
+           elapsed_s, all_requests, all_requests / elapsed_s, all_requests ? (double)all_errors / all_requests : 0.0);
+    for (int o = OUT_CONNECT; o < OUT_COUNT; o++) {
+        printf("%s\"%s\":%lu", o == OUT_CONNECT ? "" : ",", outcome_names[o], all_outcomes[o]);
+    }
+    printf("},\n \"endpoints\":{%s},\n", endpoints.c_str());
+    if (heap.samples) {
+        printf(" \"heap\":{\"samples\":%lu,\"errors\":%lu,\"start\":%ld,\"end\":%ld,\"min_free_heap\":%ld,"
+               "\"min_largest_block\":%ld}}\n",
+               heap.samples, heap.errors, heap.start, heap.end, heap.min_free, heap.min_largest_block);
+    } else {
+        printf(" \"heap\":null}\n");
+    }
+    return all_requests > all_errors ? 0 : 1;
+}
@@ -0,0 +1,590 @@
+// Stand-in for the device web server, so loadtest/loadgen.cpp can run without
+// hardware. Serves the read-mostly REST endpoints over real TCP on the host with
+// the control modules on the native HAL, the same response cache and body
+// builders as main.cpp, and settings POSTs through a command queue executed by a
+// control loop pass every 50 ms:
+//   GET  /api/status, /api/logs, /api/logs/info, /api/metrics, /api/loop_profile and
+//        the settings GETs
+//   POST /api/schedule (hour, minute) -> 202 with a job ID, 503 when the queue is full
+//
+// Like AsyncTCP it runs every handler on one thread and closes the connection
+// after each response. Connections beyond --max-clients are reset, as lwIP does
+// once its TCP PCBs are used up. The virtual clock follows real time, and the
+// free heap in /api/metrics is a device-sized budget minus what the process
+// allocated after startup (hal/native/heap.cpp). /api/metrics and
+// /api/loop_profile time the stand-in's own loop passes and handlers.
+//
+//   pio run -e api_standin && .pio/build/api_standin/program [--port 8080] [--max-clients 16]
+//       [--heap-kb 200] [--log-lines 200]
+// Stop with Ctrl-C; it prints what it served as JSON.
+
+#include "modules/motor_shield_control.h"
+#include "modules/pump_control.h"
+#include "modules/valve_control.h"
+#include "modules/scheduler.h"
+#include "modules/sensors.h"
+#include "modules/logger.h"
+#include "modules/fill_model.h"
+#include "modules/flow_meter.h"
+#include "modules/settings_store.h"
+#include "modules/response_cache.h"
+#include "modules/api_json.h"
+#include "modules/command_queue.h"
+#include "modules/control_commands.h"
+#include "modules/state_snapshot.h"
+#include "modules/watering_sequence.h"
+#include "modules/web_json.h"
+#include "modules/time_sync.h"
+#include "modules/metrics.h"
+#include "modules/loop_profiler.h"
+#include "hal/native/native.h"
+#include "hal/clock.h"
+#include "config/config.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#define LOOP_MS 50
+#define MAX_REQUEST_BYTES 8192
+
+extern bool humidifier_pump_active;
+extern bool watering_pump_active;
+extern unsigned long watering_duration_ms;
+
+void trigger_dosing() {
+    start_watering_sequence();
+}
+
+struct Client {
+    int fd;
+    std::string in;
+};
+
+struct ServerStats {
+    unsigned long connections;
+    unsigned long reset;         // Over --max-clients
+    unsigned long requests;
+    unsigned long not_found;
+    unsigned long bad_request;
+    unsigned long not_modified;
+    unsigned long accepted;      // Settings POSTs queued
+    unsigned long queue_full;
+    unsigned long commands_run;
+    unsigned long loop_passes;
+};
+
+static ServerStats stats;
+static volatile sig_atomic_t stop_requested = 0;
+
+// Commands waiting for the next loop pass, as command_queue does on the device
+static Command pending[COMMAND_QUEUE_LENGTH];
+static int pending_count = 0;
+static uint32_t next_job_id = 1;
+static uint32_t state_version = 0;
+
+static std::chrono::steady_clock::time_point started;
+
+static void on_signal(int) {
+    stop_requested = 1;
+}
+
+// Virtual clock follows real time
+static void sync_clock() {
+    uint64_t real_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    uint64_t now_us = hal_native_now_us();
+    if (real_us > now_us) hal_native_advance_us(real_us - now_us);
+}
+
+// Real time since start; the virtual clock only moves between handlers
+static uint32_t elapsed_us(std::chrono::steady_clock::time_point start) {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// The subset of capture_state() in main.cpp that changes on an idle controller
+static void publish_state() {
+    StateSnapshot snap;
+    memset(&snap, 0, sizeof(snap));
+    snap.watering_state = watering_sequence_get_state();
+    snap.dosing_stage = pump_control_get_dosing_stage();
+    snap.tank_full = sensors_get_liquid_level();
+    snap.filling = watering_sequence_is_filling();
+    snap.valve_open = valve_control_is_open();
+    snap.ntp_synced = true;
+    snap.time_state = TIME_SYNCED;
+    snap.next_run_epoch = (uint32_t)scheduler_get_next_run();
+    snap.humidifier_pump = humidifier_pump_active;
+    snap.watering_pump = watering_pump_active;
+    snap.watering_duration_ms = watering_duration_ms;
+    snap.watering_volume_ml = pump_control_get_watering_volume_ml();
+    snap.sensor_edges = sensors_get_raw_edge_count();
+    snap.sensor_glitches = sensors_get_glitch_count();
+    snap.valve_close_latency_us = sensors_get_valve_close_latency_us();
+    if (state_snapshot_publish(snap)) {
+        state_snapshot_read(snap);
+        state_version = snap.version;
+    }
+}
+
+static void loop_pass() {
+    loop_profiler_begin();
+    bool logs_queued = logger_get_queue_count() > 0;
+    logger_process_queue();
+    uint32_t drain_us = loop_profiler_mark(LOOP_STAGE_LOG_DRAIN);
+    if (logs_queued) metrics_observe(METRICS_LOG_DRAIN, drain_us);
+    static unsigned long last_flush = 0;
+    if (hal_millis() - last_flush > 5000) {
+        logger_flush();
+        last_flush = hal_millis();
+    }
+    loop_profiler_mark(LOOP_STAGE_LOG_FLUSH);
+    settings_process();
+    loop_profiler_mark(LOOP_STAGE_SETTINGS);
+    for (int i = 0; i < pending_count; i++) {
+        char message[JOB_MESSAGE_LEN] = "";
+        control_execute_command(pending[i], message, sizeof(message));
+        stats.commands_run++;
+    }
+    pending_count = 0;
+    loop_profiler_mark(LOOP_STAGE_COMMANDS);
+    sensors_read();
+    loop_profiler_mark(LOOP_STAGE_SENSORS);
+    watering_sequence_run();
+    loop_profiler_mark(LOOP_STAGE_SEQUENCE);
+    publish_state();
+    loop_profiler_mark(LOOP_STAGE_PUBLISH);
+    metrics_observe(METRICS_LOOP, loop_profiler_end());
+    stats.loop_passes++;
+}
+
+static const char *status_text(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+    }
+    return "Unknown";
+}
+
+static void send_response(int fd, int code, const char *type, const char *body, size_t length,
+                          const char *extra_headers = "") {
+    char header[512];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\n%sConnection: close\r\n\r\n",
+                     code, status_text(code), type, (unsigned long)length, extra_headers);
+    std::string out(header, n);
+    out.append(body, length);
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t w = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;
+        sent += w;
+    }
+}
+
+static void send_text(int fd, int code, const char *text) {
+    send_response(fd, code, "text/plain", text, strlen(text));
+}
+
+// send_cached_json() of main.cpp
+static void send_cached(int fd, const std::string &if_none_match, ResponseCacheSlot slot, uint64_t version,
+                        ResponseBuilder builder) {
+    CachedResponse cached;
+    if (!response_cache_get(slot, version, builder, cached)) {
+        send_text(fd, 500, "Out of memory");
+        return;
+    }
+    std::string headers = std::string("ETag: ") + cached.etag + "\r\nCache-Control: no-cache\r\n";
+    if (!if_none_match.empty() && response_cache_etag_matches(if_none_match.c_str(), cached.etag)) {
+        stats.not_modified++;
+        send_response(fd, 304, "application/json", "", 0, headers.c_str());
+    } else {
+        send_response(fd, 200, "application/json", cached.body, cached.length, headers.c_str());
+    }
+}
+
+static uint64_t status_cache_version() {
+    return ((uint64_t)(state_version + settings_get_version()) << 32) | (uint32_t)hal_time();
+}
+
+// Value of name in an application/x-www-form-urlencoded body
+static bool form_value(const std::string &body, const char *name, std::string &value) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos <= body.size()) {
+        size_t end = body.find('&', pos);
+        if (end == std::string::npos) end = body.size();
+        if (end - pos > len && body.compare(pos, len, name) == 0 && body[pos + len] == '=') {
+            value.clear();
+            for (size_t i = pos + len + 1; i < end; i++) {
+                char c = body[i];
+                if (c == '+') c = ' ';
+                else if (c == '%' && i + 2 < end) {
+                    c = (char)strtol(body.substr(i + 1, 2).c_str(), nullptr, 16);
+                    i += 2;
+                }
+                value += c;
+            }
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+// int_param() of main.cpp
+static bool int_value(const std::string &text, long min, long max, long &out) {
+    char *end;
+    out = strtol(text.c_str(), &end, 10);
+    return !text.empty() && *end == '\0' && out >= min && out <= max;
+}
+
+static void handle_schedule_post(int fd, const std::string &body) {
+    SettingsPatch patch;
+    settings_patch_init(patch);
+    std::string value;
+    if (form_value(body, "slots", value)) {
+        if (!scheduler_parse_slots(value.c_str(), patch.values.schedule_slots)) {
+            send_text(fd, 400, "slots must be HH:MM or HH:MM/0111110 (Sunday first), comma separated");
+            return;
+        }
+        settings_patch_mark(patch, patch.values.schedule_slots, sizeof(patch.values.schedule_slots), SETTING_SCHEDULE);
+    }
+    long number;
+    if (form_value(body, "hour", value)) {
+        if (!int_value(value, 0, 23, number)) {
+            send_text(fd, 400, "hour must be 0-23");
+            return;
+        }
+        settings_patch_slot_time(patch, 0, number, -1);
+    }
+    if (form_value(body, "minute", value)) {
+        if (!int_value(value, 0, 59, number)) {
+            send_text(fd, 400, "minute must be 0-59");
+            return;
+        }
+        settings_patch_slot_time(patch, 0, -1, number);
+    }
+    if (form_value(body, "catchup_s", value)) {
+        if (!int_value(value, 0, SCHEDULE_MAX_CATCHUP_S, number)) {
+            send_text(fd, 400, "catchup_s out of range");
+            return;
+        }
+        settings_patch_set(patch, patch.values.schedule_catchup_s, number, SETTING_SCHEDULE);
+    }
+
+    if (pending_count >= COMMAND_QUEUE_LENGTH) {
+        stats.queue_full++;
+        send_text(fd, 503, "Command queue full, try again");
+        return;
+    }
+    Command &cmd = pending[pending_count++];
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.job_id = next_job_id++;
+    cmd.type = CMD_APPLY_SETTINGS;
+    cmd.payload = new SettingsPatch(patch);
+    stats.accepted++;
+
+    char json[32], headers[64];
+    snprintf(json, sizeof(json), "{\"job_id\":%lu}", (unsigned long)cmd.job_id);
+    snprintf(headers, sizeof(headers), "Location: /api/jobs/%lu\r\n", (unsigned long)cmd.job_id);
+    send_response(fd, 202, "application/json", json, strlen(json), headers);
+}
+
+static void route(int fd, const std::string &method, const std::string &path, const std::string &if_none_match,
+                  const std::string &body) {
+    struct SettingsRoute {
+        const char *path;
+        ResponseCacheSlot slot;
+        ResponseBuilder builder;
+    };
+    static const SettingsRoute settings_routes[] = {
+        {"/api/weekly_dosing", RC_WEEKLY_DOSING, api_json_weekly_dosing},
+        {"/api/weekly_watering_enabled", RC_WEEKLY_WATERING, api_json_weekly_watering_enabled},
+        {"/api/schedule", RC_SCHEDULE, api_json_schedule},
+        {"/api/calibration", RC_CALIBRATION, api_json_calibration},
+        {"/api/fertilizer_motor_speed", RC_MOTOR_SPEED, api_json_motor_speed},
+        {"/api/watering_duration", RC_WATERING_DURATION, api_json_watering_duration},
+    };
+
+    if (method == "GET") {
+        if (path == "/api/status") {
+            send_cached(fd, if_none_match, RC_STATUS, status_cache_version(), web_json_status);
+            return;
+        }
+        if (path == "/api/logs") {
+            String logs = web_json_logs(100);
+            send_response(fd, 200, "application/json", logs.c_str(), logs.length());
+            return;
+        }
+        if (path == "/api/logs/info") {
+            char json[192];
+            int n = snprintf(json, sizeof(json),
+                             "{\"current_file_size\":%lu,\"queue_count\":%d,\"logs_written\":%lu,\"logs_dropped\":%lu}",
+                             (unsigned long)logger_get_file_size(), logger_get_queue_count(),
+                             logger_get_written_count(), logger_get_dropped_count());
+            send_response(fd, 200, "application/json", json, n);
+            return;
+        }
+        if (path == "/api/loop_profile") {
+            String json = loop_profiler_get_json();
+            send_response(fd, 200, "application/json", json.c_str(), json.length());
+            return;
+        }
+        if (path == "/api/metrics") {
+            size_t needed = metrics_build(nullptr, 0);
+            std::vector<char> buf(needed + 1);
+            metrics_build(buf.data(), buf.size());
+            send_response(fd, 200, "text/plain; version=0.0.4", buf.data(), needed);
+            return;
+        }
+        for (const SettingsRoute &route : settings_routes) {
+            if (path == route.path) {
+                send_cached(fd, if_none_match, route.slot, settings_get_version(), route.builder);
+                return;
+            }
+        }
+    } else if (method == "POST" && path == "/api/schedule") {
+        handle_schedule_post(fd, body);
+        return;
+    }
+    stats.not_found++;
+    send_text(fd, 404, "Not found");
+}
+
+// Every served route, for the handler time histograms on /api/metrics
+static const char *const served_routes[][2] = {
+    {"GET", "/api/status"}, {"GET", "/api/logs"}, {"GET", "/api/logs/info"}, {"GET", "/api/metrics"},
+    {"GET", "/api/loop_profile"}, {"GET", "/api/weekly_dosing"}, {"GET", "/api/weekly_watering_enabled"},
+    {"GET", "/api/schedule"}, {"GET", "/api/calibration"}, {"GET", "/api/fertilizer_motor_speed"},
+    {"GET", "/api/watering_duration"}, {"POST", "/api/schedule"},
+};
+
+static void handle(int fd, const std::string &method, const std::string &path, const std::string &if_none_match,
+                   const std::string &body) {
+    stats.requests++;
+    sync_clock();
+    int metrics_route = -1;
+    for (const auto &served : served_routes) {
+        if (method == served[0] && path == served[1]) metrics_route = metrics_http_route(served[0], served[1]);
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    route(fd, method, path, if_none_match, body);
+    metrics_http_observe(metrics_route, elapsed_us(start));
+}
+
+static std::string header_value(const std::string &headers, const char *name) {
+    size_t len = strlen(name);
+    size_t pos = 0;
+    while ((pos = headers.find("\r\n", pos)) != std::string::npos) {
+        pos += 2;
+        if (strncasecmp(headers.c_str() + pos, name, len) == 0 && headers[pos + len] == ':') {
+            size_t start = headers.find_first_not_of(' ', pos + len + 1);
+            size_t end = headers.find("\r\n", pos);
+            if (start == std::string::npos || start > end) return "";
+            return headers.substr(start, end - start);
+        }
+    }
+    return "";
+}
+
+// True once the client's request was complete and answered (or rejected)
+static bool process_client(Client &client) {
+    size_t header_end = client.in.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+        if (client.in.size() > MAX_REQUEST_BYTES) {
+            stats.bad_request++;
+            send_text(client.fd, 400, "Request too large");
+            return true;
+        }
+        return false;
+    }
+    std::string headers = client.in.substr(0, header_end + 2);
+    size_t content_length = strtoul(header_value(headers, "Content-Length").c_str(), nullptr, 10);
+    if (content_length > MAX_REQUEST_BYTES) {
+        stats.bad_request++;
+        send_text(client.fd, 400, "Request too large");
+        return true;
+    }
+    if (client.in.size() < header_end + 4 + content_length) return false;
+
+    char method[8], path[256];
+    if (sscanf(headers.c_str(), "%7s %255s", method, path) != 2) {
+        stats.bad_request++;
+        send_text(client.fd, 400, "Bad request");
+        return true;
+    }
+    char *query = strchr(path, '?');
+    if (query) *query = '\0';
+    handle(client.fd, method, path, header_value(headers, "If-None-Match"),
+           client.in.substr(header_end + 4, content_length));
+    return true;
+}
+
+static int open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_reset(int fd) {
+    struct linger lin = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+    close(fd);
+}
+
+static void seed_logs(int lines) {
+    char message[96];
+    for (int i = 0; i < lines; i++) {
+        snprintf(message, sizeof(message), "Pump %d dosed %.2f ml in %d ms (cal 1.042 ml/s)", i % NUM_FERTILIZERS,
+                 5.0 + i % 10, 4000 + i * 7 % 1000);
+        logger_log(message);
+        if (logger_get_queue_count() >= LOG_QUEUE_SIZE - 1) logger_flush();
+    }
+    logger_flush();
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "usage: %s [--port N] [--max-clients N] [--heap-kb N] [--log-lines N]\n", program);
+}
+
+int main(int argc, char **argv) {
+    int port = 8080;
+    int max_clients = 16; // CONFIG_LWIP_MAX_ACTIVE_TCP on the ESP32 Arduino core
+    int heap_kb = 200;
+    int log_lines = 200;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 2;
+        }
+        if (strcmp(argv[i], "--port") == 0) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-clients") == 0) max_clients = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--heap-kb") == 0) heap_kb = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--log-lines") == 0) log_lines = atoi(argv[++i]);
+        else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    setenv("TZ", "CET-1CEST,M3.5.0/2,M10.5.0/3", 1);
+    tzset();
+    hal_native_set_epoch(time(nullptr));
+    started = std::chrono::steady_clock::now();
+
+    // Same order as setup()
+    motor_shield_init();
+    pump_control_init();
+    flow_meter_init();
+    valve_control_init();
+    scheduler_init();
+    sensors_init();
+    logger_init();
+    settings_load();
+    response_cache_init((uint32_t)time(nullptr) ^ ((uint32_t)getpid() << 16));
+    fill_model_init();
+    seed_logs(log_lines);
+    loop_pass();
+
+    int listener = open_listener(port);
+    if (listener < 0) {
+        fprintf(stderr, "cannot listen on 127.0.0.1:%d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    hal_native_heap_set_size((size_t)heap_kb * 1024);
+    fprintf(stderr, "stand-in listening on http://127.0.0.1:%d (max %d clients)\n", port, max_clients);
+
+    std::vector<Client> clients;
+    auto next_loop = std::chrono::steady_clock::now();
+    while (!stop_requested) {
+        std::vector<struct pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (const Client &client : clients) fds.push_back({client.fd, POLLIN, 0});
+
+        int wait_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            next_loop - std::chrono::steady_clock::now()).count();
+        if (poll(fds.data(), fds.size(), wait_ms > 0 ? wait_ms : 0) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                stats.connections++;
+                if ((int)clients.size() >= max_clients) {
+                    stats.reset++;
+                    close_reset(fd);
+                } else {
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    clients.push_back({fd, std::string()});
+                }
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Client &client = clients[i - 1];
+            char buf[2048];
+            ssize_t n = recv(client.fd, buf, sizeof(buf), 0);
+            bool done = n <= 0;
+            if (n > 0) {
+                client.in.append(buf, n);
+                done = process_client(client);
+            }
+            if (done) {
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+        for (size_t i = 0; i < clients.size();) {
+            if (clients[i].fd < 0) clients.erase(clients.begin() + i);
+            else i++;
+        }
+
+        if (std::chrono::steady_clock::now() >= next_loop) {
+            sync_clock();
+            loop_pass();
+            next_loop += std::chrono::milliseconds(LOOP_MS);
+            if (next_loop < std::chrono::steady_clock::now()) next_loop = std::chrono::steady_clock::now();
+        }
+    }
+
+    for (const Client &client : clients) close(client.fd);
+    close(listener);
+    logger_flush();
+    printf("{\"connections\":%lu,\"reset\":%lu,\"requests\":%lu,\"not_modified\":%lu,\"not_found\":%lu,"
+           "\"bad_request\":%lu,\"settings_accepted\":%lu,\"queue_full\":%lu,\"commands_run\":%lu,\"loop_passes\":%lu}\n",
+           stats.connections, stats.reset, stats.requests, stats.not_modified, stats.not_found, stats.bad_request,
+           stats.accepted, stats.queue_full, stats.commands_run, stats.loop_passes);
+    return 0;
+}
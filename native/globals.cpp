@@ -0,0 +1,17 @@
+// Settings globals for the host programs; main.cpp defines these on the device
+#include "config/config.h"
+#include "modules/settings_store.h"
+
+float weekly_dosing_ml[7][NUM_FERTILIZERS];
+bool weekly_watering_enabled[7];
+ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS] = {{8, 0, SCHEDULE_EVERY_DAY}};
+unsigned long schedule_catchup_s = SCHEDULE_MAX_LATE_S;
+
+float pump_calibration[NUM_FERTILIZERS] = {1, 1, 1, 1, 1};
+float pump_curve[NUM_FERTILIZERS][CAL_CURVE_POINTS];
+unsigned long pump_spinup_ms[NUM_FERTILIZERS];
+int fertilizer_motor_speed = 200;
+unsigned long watering_duration_ms = MAX_WATERING_TIME_MS;
+float watering_target_ml = 0;
+bool sequence_pipelined = false;
+unsigned long fill_offset_ms = 0;
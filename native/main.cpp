@@ -0,0 +1,109 @@
+// Host harness: boots the control modules on the fake hardware, lets the
+// scheduler start one watering sequence and runs it to the end on the virtual
+// clock, printing every actuator change.
+//
+//   pio run -e native && .pio/build/native/program [--verbose]
+//   pio run -e native_asan && .pio/build/native_asan/program
+#include "modules/motor_shield_control.h"
+#include "modules/pump_control.h"
+#include "modules/pump_calibration.h"
+#include "modules/valve_control.h"
+#include "modules/scheduler.h"
+#include "modules/sensors.h"
+#include "modules/logger.h"
+#include "modules/fill_model.h"
+#include "modules/flow_meter.h"
+#include "modules/settings_store.h"
+#include "modules/watering_sequence.h"
+#include "hal/native/native.h"
+#include "hal/clock.h"
+#include "hal/motor.h"
+#include "config/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOP_MS 50
+#define TANK_FILL_MS 40000     // Valve open time until the sensor trips
+#define TANK_DRAIN_MS 20000    // Watering pump time until the level drops below the sensor
+#define RUN_LIMIT_MS (2UL * 3600 * 1000)
+
+static const char *pump_names[HAL_MOTOR_COUNT] = {"fert0", "fert1", "fert2", "fert3", "fert4", "watering", "humidifier"};
+
+void trigger_dosing() {
+    start_watering_sequence();
+}
+
+static void print_time() {
+    unsigned long ms = hal_millis();
+    printf("%7lu.%03lu  ", ms / 1000, ms % 1000);
+}
+
+static void on_motor(int index, bool running, uint8_t speed) {
+    print_time();
+    if (running) printf("motor %d (%s) on, speed %u\n", index + 1, pump_names[index], speed);
+    else printf("motor %d (%s) off\n", index + 1, pump_names[index]);
+}
+
+static void on_pin(int pin, bool high) {
+    if (pin != VALVE_PIN) return;
+    print_time();
+    printf("valve %s\n", high ? "open" : "closed");
+}
+
+// Tank level driven by the valve (filling) and the watering pump (draining)
+static void model_tank(long &level_ms) {
+    if (hal_native_get_output(VALVE_PIN)) level_ms += LOOP_MS;
+    if (hal_native_motor_running(WATERING_PUMP_CHANNEL - 1)) level_ms -= LOOP_MS * TANK_FILL_MS / TANK_DRAIN_MS;
+    if (level_ms < 0) level_ms = 0;
+    hal_native_set_input(LIQUID_SENSOR_PIN, level_ms >= TANK_FILL_MS);
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 1 && strcmp(argv[1], "--verbose") == 0;
+    hal_native_serial_enable(verbose);
+    setenv("TZ", "CET-1CEST,M3.5.0/2,M10.5.0/3", 1);
+    tzset();
+    hal_native_set_epoch(1717394370); // Monday 2024-06-03 07:59:30 CEST, 30 s before the default schedule
+    hal_native_on_motor_change(on_motor);
+    hal_native_on_pin_write(on_pin);
+
+    // Same order as setup()
+    motor_shield_init();
+    pump_control_init();
+    flow_meter_init();
+    valve_control_init();
+    scheduler_init();
+    sensors_init();
+    logger_init();
+    settings_load();
+    fill_model_init();
+
+    long level_ms = 0;
+    bool started = false;
+    while (hal_millis() < RUN_LIMIT_MS) {
+        logger_process_queue();
+        settings_process();
+        scheduler_run();
+        pump_control_run();
+        pump_calibration_run();
+        sensors_read();
+        watering_sequence_run();
+
+        bool idle = watering_sequence_get_state() == IDLE;
+        if (!idle) started = true;
+        if (started && idle) break;
+        hal_delay(LOOP_MS);
+        model_tank(level_ms);
+    }
+    logger_flush();
+
+    print_time();
+    if (!started || watering_sequence_get_state() != IDLE) {
+        printf("sequence did not complete\n");
+        return 1;
+    }
+    printf("sequence complete - %lu I2C transfers, %lu log lines written, %lu dropped\n",
+           hal_native_motor_transfers(), logger_get_written_count(), logger_get_dropped_count());
+    return 0;
+}
@@ -0,0 +1,351 @@
+// Replays a trace recorded by the device (GET /api/trace/download) or by the
+// simulator (--record) through the control modules on the native HAL.
+//
+// The trace's first record restores the settings, fill model, motor shields,
+// sensor level and wall clock it was recorded with. Every recorded input is then
+// applied at its recorded time: sensor edges (to the microsecond), flow pulses,
+// queued API commands, scheduler triggers and time syncs. The control loop runs
+// at the loop() period in between and jumps ahead while nothing is running.
+// The motor and valve commands that the modules issue are recorded again and
+// compared with the ones in the trace. The sequence must match exactly; timing
+// differences are reported as skew.
+//
+//   pio run -e replay && .pio/build/replay/program trace.bin [--verbose]
+//
+// Prints a JSON summary. Exit status: 0 = same actuator commands, 1 = mismatch,
+// 2 = unreadable trace. Manual control (WebSocket) commands and ring overflows
+// are counted but make the trace not replayable. Each trace needs its own
+// process (the modules keep their state in statics), so a corpus is replayed
+// file by file.
+#include "modules/motor_shield_control.h"
+#include "modules/pump_control.h"
+#include "modules/pump_calibration.h"
+#include "modules/valve_control.h"
+#include "modules/sensors.h"
+#include "modules/logger.h"
+#include "modules/fill_model.h"
+#include "modules/flow_meter.h"
+#include "modules/settings_store.h"
+#include "modules/batch_runner.h"
+#include "modules/control_commands.h"
+#include "modules/trace_recorder.h"
+#include "modules/watering_sequence.h"
+#include "hal/native/native.h"
+#include "hal/clock.h"
+#include "hal/prefs.h"
+#include "config/config.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LOOP_MS 50
+
+extern bool humidifier_pump_active;
+extern bool watering_pump_active;
+
+struct Record {
+    TraceHeader header;
+    const uint8_t *payload;
+};
+
+struct Output {
+    uint64_t ms;        // Recorded ms, unwrapped past the 32-bit millis() rollover
+    uint8_t type;
+    uint8_t data[4];    // TraceMotor or TraceValve
+};
+
+static std::vector<Output> replayed;
+static bool verbose = false;
+
+// Same as main.cpp; the trigger itself comes from the trace, not the scheduler
+void trigger_dosing() {
+    if (batch_runner_is_running()) {
+        batch_runner_abort("Scheduled watering");
+    }
+    start_watering_sequence();
+}
+
+static bool load(const char *path, std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return true;
+}
+
+// Split into records; false if the data ends inside a record
+static bool parse(const uint8_t *data, size_t len, std::vector<Record> &records) {
+    size_t pos = 0;
+    while (pos + sizeof(TraceHeader) <= len) {
+        Record r;
+        memcpy(&r.header, data + pos, sizeof(r.header));
+        pos += sizeof(r.header);
+        if (pos + r.header.len > len) return false;
+        r.payload = data + pos;
+        pos += r.header.len;
+        records.push_back(r);
+    }
+    return pos == len;
+}
+
+static bool is_output(uint8_t type) {
+    return type == TRACE_MOTOR || type == TRACE_VALVE;
+}
+
+static Output to_output(const Record &r, uint64_t ms) {
+    Output out = {ms, r.header.type, {0, 0, 0, 0}};
+    memcpy(out.data, r.payload, r.header.len < sizeof(out.data) ? r.header.len : sizeof(out.data));
+    return out;
+}
+
+static bool same_output(const Output &a, const Output &b) {
+    if (a.type != b.type) return false;
+    if (a.type == TRACE_VALVE) return a.data[0] == b.data[0];
+    // Motor: index, op, and the speed for speed commands
+    return a.data[0] == b.data[0] && a.data[1] == b.data[1] &&
+           (a.data[1] != TRACE_MOTOR_SPEED || a.data[2] == b.data[2]);
+}
+
+static void describe(const Output &o, char *buf, size_t size) {
+    static const char *ops[] = {"speed", "forward", "release"};
+    if (o.type == TRACE_VALVE) {
+        snprintf(buf, size, "%llu ms valve %s", (unsigned long long)o.ms, o.data[0] ? "open" : "closed");
+    } else if (o.data[1] == TRACE_MOTOR_SPEED) {
+        snprintf(buf, size, "%llu ms motor %u speed %u", (unsigned long long)o.ms, o.data[0] + 1, o.data[2]);
+    } else {
+        snprintf(buf, size, "%llu ms motor %u %s", (unsigned long long)o.ms, o.data[0] + 1, o.data[1] < 3 ? ops[o.data[1]] : "?");
+    }
+}
+
+// Collect what the modules commanded since the last call
+static void capture() {
+    static uint8_t buf[TRACE_BUFFER_SIZE];
+    size_t len = trace_take(buf, sizeof(buf));
+    std::vector<Record> records;
+    parse(buf, len, records);
+    uint64_t now_ms = hal_native_now_us() / 1000;
+    for (const Record &r : records) {
+        if (is_output(r.header.type)) replayed.push_back(to_output(r, now_ms - (uint32_t)((uint32_t)now_ms - r.header.ms)));
+    }
+}
+
+static void advance_to_us(uint64_t us) {
+    uint64_t now = hal_native_now_us();
+    if (us > now) hal_native_advance_us(us - now);
+    capture();
+}
+
+// loop() after the command queue: scheduler trigger (from the trace), then the control modules
+static void loop_tail() {
+    pump_control_run();
+    pump_calibration_run();
+    batch_runner_run();
+    sensors_read();
+    watering_sequence_run();
+    capture();
+}
+
+static bool control_is_idle() {
+    return watering_sequence_get_state() == IDLE && !watering_sequence_is_filling() &&
+           !valve_control_is_open() && !pump_control_is_dosing() && !pump_calibration_is_running() &&
+           !batch_runner_is_running() && !watering_pump_active && !humidifier_pump_active;
+}
+
+static void restore_state(const TraceState &state, uint32_t ms) {
+    setenv("TZ", TIME_ZONE, 1); // The device zone, so day-of-week dosing picks the same days
+    tzset();
+    hal_native_motor_set_shields(state.motor_shields);
+    hal_native_set_input(LIQUID_SENSOR_PIN, state.sensor_level);
+    if (state.fill_model_len) {
+        hal_prefs_begin("fill_model", false);
+        hal_prefs_put_bytes("state", state.fill_model, state.fill_model_len);
+        hal_prefs_end();
+    }
+    hal_native_advance_us((uint64_t)ms * 1000);
+    hal_native_set_epoch(state.epoch);
+
+    // Same order as setup()
+    motor_shield_init();
+    pump_control_init();
+    flow_meter_init();
+    valve_control_init();
+    sensors_init();
+    logger_init();
+    settings_load();
+    settings_apply(state.settings);
+    fill_model_init();
+
+    // Record the replayed actuator commands through the same hooks as on the device
+    trace_set_enabled(true);
+    trace_process(true);
+    capture();
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0) verbose = true;
+        else if (!path) path = argv[i];
+        else path = nullptr, i = argc;
+    }
+    if (!path) {
+        fprintf(stderr, "usage: replay TRACE_FILE [--verbose]\n");
+        return 2;
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<Record> records;
+    if (!load(path, data)) {
+        perror(path);
+        return 2;
+    }
+    if (!parse(data.data(), data.size(), records)) {
+        fprintf(stderr, "%s: truncated record at the end, ignored\n", path);
+    }
+    if (records.empty() || records[0].header.type != TRACE_STATE || records[0].header.len != sizeof(TraceState)) {
+        fprintf(stderr, "%s: not a trace file (format %d expected)\n", path, TRACE_FORMAT);
+        return 2;
+    }
+    TraceState state;
+    memcpy(&state, records[0].payload, sizeof(state));
+    if (state.magic != TRACE_MAGIC || state.format != TRACE_FORMAT) {
+        fprintf(stderr, "%s: not a trace file (format %d expected)\n", path, TRACE_FORMAT);
+        return 2;
+    }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    restore_state(state, records[0].header.ms);
+
+    std::vector<Output> expected;
+    unsigned long sensor_edges = 0, flow_records = 0, commands = 0, schedules = 0, time_syncs = 0;
+    unsigned long manual = 0, gaps = 0;
+    uint64_t next_loop_us = hal_native_now_us() + LOOP_MS * 1000;
+    uint64_t at_ms = records[0].header.ms;
+
+    for (size_t i = 1; i < records.size(); i++) {
+        const Record &r = records[i];
+        // Signed step: records from interrupts can be a millisecond out of order
+        at_ms += (int32_t)(r.header.ms - records[i - 1].header.ms);
+        uint64_t at_us = at_ms * 1000;
+        if (r.header.type == TRACE_SENSOR) at_us += ((const TraceSensor *)r.payload)->us;
+
+        // Loop passes up to this record; nothing happens while idle, so skip ahead
+        while (next_loop_us <= at_us && !control_is_idle()) {
+            advance_to_us(next_loop_us);
+            loop_tail();
+            next_loop_us = hal_native_now_us() + LOOP_MS * 1000;
+        }
+        if (is_output(r.header.type)) {
+            expected.push_back(to_output(r, at_ms));
+            continue;
+        }
+        advance_to_us(at_us);
+
+        switch (r.header.type) {
+            case TRACE_SENSOR:
+                hal_native_set_input(LIQUID_SENSOR_PIN, ((const TraceSensor *)r.payload)->level);
+                sensor_edges++;
+                break;
+            case TRACE_FLOW:
+                hal_native_pulse_add(((const TraceFlow *)r.payload)->pulses);
+                flow_records++;
+                break;
+            case TRACE_COMMAND: {
+                TraceCommand tc;
+                memcpy(&tc, r.payload, sizeof(tc));
+                const uint8_t *extra = r.payload + sizeof(tc);
+                size_t extra_len = r.header.len - sizeof(tc);
+                Command cmd = {tc.job_id, (CommandType)tc.type, {tc.args[0], tc.args[1], tc.args[2]}, tc.value, nullptr};
+                // The executor frees the payload, as with commands from the queue
+                if (tc.type == CMD_APPLY_SETTINGS && extra_len == sizeof(SettingsPatch)) {
+                    SettingsPatch *patch = new SettingsPatch;
+                    memcpy(patch, extra, sizeof(*patch));
+                    cmd.payload = patch;
+                } else if (tc.type == CMD_RUN_BATCH && extra_len == sizeof(BatchProgram)) {
+                    BatchProgram *program = new BatchProgram;
+                    memcpy(program, extra, sizeof(*program));
+                    cmd.payload = program;
+                }
+                char message[JOB_MESSAGE_LEN] = "";
+                control_execute_command(cmd, message, sizeof(message));
+                commands++;
+                loop_tail();
+                next_loop_us = hal_native_now_us() + LOOP_MS * 1000;
+                break;
+            }
+            case TRACE_SCHEDULE:
+                trigger_dosing();
+                schedules++;
+                loop_tail();
+                next_loop_us = hal_native_now_us() + LOOP_MS * 1000;
+                break;
+            case TRACE_TIME_SYNC:
+                hal_native_set_epoch(((const TraceTimeSync *)r.payload)->epoch);
+                time_syncs++;
+                break;
+            case TRACE_MANUAL:
+                manual++;
+                break;
+            case TRACE_GAP:
+                gaps += ((const TraceGap *)r.payload)->dropped;
+                break;
+        }
+        if (next_loop_us < hal_native_now_us()) next_loop_us = hal_native_now_us();
+    }
+    // Commands issued after the last record were not recorded
+    while (!replayed.empty() && replayed.back().ms > at_ms) replayed.pop_back();
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count();
+
+    size_t compared = expected.size() < replayed.size() ? expected.size() : replayed.size();
+    size_t mismatch = compared;
+    uint64_t max_skew = 0;
+    uint64_t total_skew = 0;
+    for (size_t i = 0; i < compared; i++) {
+        if (!same_output(expected[i], replayed[i])) {
+            mismatch = i;
+            break;
+        }
+        uint64_t skew = expected[i].ms > replayed[i].ms ? expected[i].ms - replayed[i].ms : replayed[i].ms - expected[i].ms;
+        if (skew > max_skew) max_skew = skew;
+        total_skew += skew;
+    }
+    bool match = mismatch == compared && expected.size() == replayed.size();
+
+    if (verbose) {
+        for (size_t i = 0; i < expected.size() || i < replayed.size(); i++) {
+            char a[64] = "-", b[64] = "-";
+            if (i < expected.size()) describe(expected[i], a, sizeof(a));
+            if (i < replayed.size()) describe(replayed[i], b, sizeof(b));
+            fprintf(stderr, "%5zu  %-32s %-32s%s\n", i, a, b,
+                    i < expected.size() && i < replayed.size() && !same_output(expected[i], replayed[i]) ? "  <--" : "");
+        }
+    }
+
+    printf("{\n");
+    printf("  \"trace\": \"%s\",\n", path);
+    printf("  \"records\": %zu,\n", records.size());
+    printf("  \"duration_ms\": %llu,\n", (unsigned long long)(at_ms - records[0].header.ms));
+    printf("  \"inputs\": {\"sensor_edges\": %lu, \"flow\": %lu, \"commands\": %lu, \"schedule\": %lu, \"time_sync\": %lu},\n",
+           sensor_edges, flow_records, commands, schedules, time_syncs);
+    printf("  \"replayable\": %s,\n", manual == 0 && gaps == 0 ? "true" : "false");
+    printf("  \"manual_commands\": %lu,\n", manual);
+    printf("  \"dropped_records\": %lu,\n", gaps);
+    printf("  \"outputs\": {\"expected\": %zu, \"replayed\": %zu, \"matched\": %zu},\n", expected.size(), replayed.size(),
+           mismatch);
+    if (!match) {
+        char a[64] = "end of trace", b[64] = "end of replay";
+        if (mismatch < expected.size()) describe(expected[mismatch], a, sizeof(a));
+        if (mismatch < replayed.size()) describe(replayed[mismatch], b, sizeof(b));
+        printf("  \"first_mismatch\": {\"index\": %zu, \"expected\": \"%s\", \"replayed\": \"%s\"},\n", mismatch, a, b);
+    }
+    printf("  \"max_skew_ms\": %llu,\n", (unsigned long long)max_skew);
+    printf("  \"mean_skew_ms\": %.1f,\n", mismatch ? (double)total_skew / mismatch : 0.0);
+    printf("  \"replay_ms\": %.1f,\n", wall_ms);
+    printf("  \"match\": %s\n", match ? "true" : "false");
+    printf("}\n");
+    return match ? 0 : 1;
+}
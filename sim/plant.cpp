@@ -0,0 +1,220 @@
+#include "plant.h"
+#include "hal/native/native.h"
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/motor.h"
+#include "hal/timer.h"
+#include "modules/pump_calibration.h"
+
+#define WATERING_MOTOR (WATERING_PUMP_CHANNEL - 1)
+#define BOUNCE_SPACING_US 80 // Sensor chatter well inside the debounce window
+
+static PlantConfig cfg;
+static PlantStats stats;
+static uint32_t faults = 0;
+static uint32_t rng_state = 1;
+
+static float level = 0;
+static uint64_t level_us = 0;
+static float rate = 0;               // ml/s, current net flow into the tank
+static float fill_inflow = 0;        // Inflow of the current fill, jittered once per fill
+static bool valve_open = false;
+static uint64_t valve_open_us = 0;
+static bool draining = false;
+static uint64_t drain_start_us = 0;
+static bool overflowing = false;
+
+static uint64_t fert_start_us[NUM_FERTILIZERS];
+static uint8_t fert_speed[NUM_FERTILIZERS];
+
+static hal_timer_t crossing_timer = nullptr;
+static hal_timer_t bounce_timer = nullptr;
+static int bounce_left = 0;
+
+static const char *fault_names[FAULT_COUNT] = {
+    "sensor_stuck_low", "sensor_stuck_high", "valve_stuck_closed", "low_pressure",
+    "shield_main_missing", "shield_extra_missing"
+};
+
+const char *sim_fault_name(int fault) {
+    return fault >= 0 && fault < FAULT_COUNT ? fault_names[fault] : "unknown";
+}
+
+static bool has_fault(SimFault fault) {
+    return faults & (1u << fault);
+}
+
+// xorshift32: deterministic for a given seed
+static float random_unit() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (rng_state & 0xFFFFFF) / (float)0x1000000;
+}
+
+static bool sensor_forced() {
+    return has_fault(FAULT_SENSOR_STUCK_LOW) || has_fault(FAULT_SENSOR_STUCK_HIGH);
+}
+
+static void drive_sensor(bool full) {
+    if (has_fault(FAULT_SENSOR_STUCK_LOW)) full = false;
+    if (has_fault(FAULT_SENSOR_STUCK_HIGH)) full = true;
+    hal_native_set_input(LIQUID_SENSOR_PIN, full);
+}
+
+void plant_update() {
+    uint64_t now = hal_native_now_us();
+    float dt = (now - level_us) / 1e6f;
+    level_us = now;
+    if (dt <= 0) return;
+
+    float next = level + rate * dt;
+    if (draining) {
+        // The pump can only draw what is in the tank
+        float drawn = cfg.drain_ml_per_s * dt;
+        if (next < 0) drawn += next;
+        stats.water_ml += drawn;
+    }
+    if (next < 0) next = 0;
+    if (next > cfg.capacity_ml) {
+        next = cfg.capacity_ml;
+        if (!overflowing) {
+            overflowing = true;
+            stats.overflows++;
+            sim_timeline("tank OVERFLOW");
+        }
+    } else if (next < cfg.capacity_ml) {
+        overflowing = false;
+    }
+    level = next;
+    if (level > stats.max_level_ml) stats.max_level_ml = level;
+}
+
+float plant_level_ml() {
+    plant_update();
+    return level;
+}
+
+const PlantStats &plant_stats() {
+    return stats;
+}
+
+static void bounce_callback(void *arg) {
+    bool high = hal_gpio_read(LIQUID_SENSOR_PIN);
+    hal_native_set_input(LIQUID_SENSOR_PIN, !high);
+    if (--bounce_left > 0) hal_timer_start_once(bounce_timer, BOUNCE_SPACING_US);
+}
+
+// Recompute the net flow and schedule the next sensor crossing
+static void reschedule() {
+    plant_update();
+    float inflow = valve_open && !has_fault(FAULT_VALVE_STUCK_CLOSED) ? fill_inflow : 0;
+    if (has_fault(FAULT_LOW_PRESSURE)) inflow *= 0.25f;
+    rate = inflow - (draining ? cfg.drain_ml_per_s : 0);
+
+    hal_timer_stop(crossing_timer);
+    bool above = level >= cfg.sensor_level_ml;
+    if (!above && rate > 0) {
+        float seconds = (cfg.sensor_level_ml - level) / rate;
+        hal_timer_start_once(crossing_timer, (uint64_t)(seconds * 1e6f) + 1);
+    } else if (above && rate < 0) {
+        float seconds = (level - cfg.sensor_level_ml) / -rate;
+        hal_timer_start_once(crossing_timer, (uint64_t)(seconds * 1e6f) + 1);
+    }
+}
+
+static void crossing_callback(void *arg) {
+    plant_update();
+    bool full = rate > 0;
+    level = cfg.sensor_level_ml + (full ? 0.001f : -0.001f);
+    if (sensor_forced()) return;
+
+    if (cfg.bounce_edges > 0) {
+        // Chatter: the level settles after bounce_edges extra toggles
+        bool settled = full == (cfg.bounce_edges % 2 == 0);
+        hal_native_set_input(LIQUID_SENSOR_PIN, settled);
+        bounce_left = cfg.bounce_edges;
+        hal_timer_start_once(bounce_timer, BOUNCE_SPACING_US);
+    } else {
+        drive_sensor(full);
+    }
+}
+
+static void finish_fill() {
+    unsigned long ms = (hal_native_now_us() - valve_open_us) / 1000;
+    bool sensor_full = hal_gpio_read(LIQUID_SENSOR_PIN);
+    bool reached = level >= cfg.sensor_level_ml;
+    stats.fills++;
+    stats.fill_ms_total += ms;
+    if (stats.fills == 1 || ms < stats.fill_ms_min) stats.fill_ms_min = ms;
+    if (ms > stats.fill_ms_max) stats.fill_ms_max = ms;
+    if (!sensor_full) stats.fill_timeouts++;     // Only the timeout closes the valve without a full sensor
+    else if (!reached) stats.short_fills++;
+    sim_timeline("valve closed after %lu ms, level %.0f ml%s", ms, level,
+                 !sensor_full ? " (TIMEOUT)" : !reached ? " (SHORT FILL)" : "");
+}
+
+static void on_pin(int pin, bool high) {
+    if (pin != VALVE_PIN || high == valve_open) return;
+    plant_update();
+    valve_open = high;
+    if (high) {
+        valve_open_us = hal_native_now_us();
+        fill_inflow = cfg.inflow_ml_per_s * (1 + cfg.inflow_jitter * (2 * random_unit() - 1));
+        sim_timeline("valve open, level %.0f ml", level);
+    } else {
+        finish_fill();
+    }
+    reschedule();
+}
+
+static void on_motor(int index, bool running, uint8_t speed) {
+    if (index < NUM_FERTILIZERS) {
+        if (running) {
+            fert_start_us[index] = hal_native_now_us();
+            fert_speed[index] = speed;
+            sim_timeline("fertilizer pump %d on, speed %u", index, speed);
+        } else {
+            float seconds = (hal_native_now_us() - fert_start_us[index]) / 1e6f;
+            float ml = seconds * pump_calibration_rate(index, fert_speed[index]) * (1 + cfg.pump_error);
+            stats.delivered_ml[index] += ml;
+            stats.doses[index]++;
+            sim_timeline("fertilizer pump %d off after %.0f ms, %.2f ml", index, seconds * 1000, ml);
+        }
+    } else if (index == WATERING_MOTOR && running != draining) {
+        plant_update();
+        draining = running;
+        if (running) {
+            drain_start_us = hal_native_now_us();
+            sim_timeline("watering pump on, level %.0f ml", level);
+        } else {
+            unsigned long ms = (hal_native_now_us() - drain_start_us) / 1000;
+            stats.watering_runs++;
+            stats.watering_ms_total += ms;
+            sim_timeline("watering pump off after %lu ms, level %.0f ml", ms, level);
+        }
+        reschedule();
+    }
+}
+
+void plant_init(const PlantConfig &config) {
+    cfg = config;
+    rng_state = config.seed ? config.seed : 1;
+    stats = PlantStats();
+    crossing_timer = hal_timer_create(crossing_callback, nullptr, "sim_crossing");
+    bounce_timer = hal_timer_create(bounce_callback, nullptr, "sim_bounce");
+    level_us = hal_native_now_us();
+    hal_native_on_pin_write(on_pin);
+    hal_native_on_motor_change(on_motor);
+}
+
+void plant_set_faults(uint32_t mask) {
+    plant_update();
+    faults = mask;
+    uint8_t shields = HAL_MOTOR_SHIELD_MAIN | HAL_MOTOR_SHIELD_EXTRA;
+    if (has_fault(FAULT_SHIELD_MAIN_MISSING)) shields &= ~HAL_MOTOR_SHIELD_MAIN;
+    if (has_fault(FAULT_SHIELD_EXTRA_MISSING)) shields &= ~HAL_MOTOR_SHIELD_EXTRA;
+    hal_native_motor_set_shields(shields);
+    drive_sensor(level >= cfg.sensor_level_ml);
+    reschedule();
+}
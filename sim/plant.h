@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include "config/config.h"
+
+// Physical side of the simulator: main tank, liquid sensor and pumps, driven by
+// the actuator observers of the native HAL. The tank level is piecewise linear
+// between actuator changes; sensor crossings are scheduled as virtual timers, so
+// they land at the exact microsecond even while the control code is inside a
+// motor settle delay.
+
+enum SimFault {
+    FAULT_SENSOR_STUCK_LOW,     // Sensor never reports full
+    FAULT_SENSOR_STUCK_HIGH,    // Sensor always reports full
+    FAULT_VALVE_STUCK_CLOSED,   // Valve output switches but no water flows
+    FAULT_LOW_PRESSURE,         // Inflow at a quarter of the normal rate
+    FAULT_SHIELD_MAIN_MISSING,  // Motors 1-4 stop answering on I2C
+    FAULT_SHIELD_EXTRA_MISSING, // Motors 5-7 stop answering on I2C
+    FAULT_COUNT
+};
+
+struct PlantConfig {
+    float inflow_ml_per_s;      // Mains inflow with the valve open
+    float inflow_jitter;        // Random per-fill variation of the inflow (fraction)
+    float drain_ml_per_s;       // Watering pump draw from the tank
+    float sensor_level_ml;      // Level at which the liquid sensor trips
+    float capacity_ml;          // Level at which the tank overflows
+    float pump_error;           // True fertilizer flow relative to the calibration (0.05 = 5 % more)
+    int bounce_edges;           // Extra sensor toggles around each crossing
+    uint32_t seed;
+};
+
+struct PlantStats {
+    float delivered_ml[NUM_FERTILIZERS];
+    unsigned long doses[NUM_FERTILIZERS];
+    unsigned long fills;
+    unsigned long fill_timeouts;     // Valve closed by the controller's fill timeout
+    unsigned long short_fills;       // Valve closed on a full sensor below the real sensor level
+    unsigned long fill_ms_total;
+    unsigned long fill_ms_min;
+    unsigned long fill_ms_max;
+    unsigned long overflows;
+    float max_level_ml;
+    unsigned long watering_runs;
+    unsigned long watering_ms_total;
+    float water_ml;
+};
+
+const char *sim_fault_name(int fault);
+void plant_init(const PlantConfig &config);
+void plant_set_faults(uint32_t mask);
+void plant_update();                 // Integrate the level up to the current virtual time
+float plant_level_ml();
+const PlantStats &plant_stats();
+
+// Timeline output, implemented by the simulator
+void sim_timeline(const char *fmt, ...);
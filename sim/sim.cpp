@@ -0,0 +1,367 @@
+// Accelerated-time simulator for the watering sequence.
+//
+// Runs the real control modules (scheduler_run, pump_control_run, the
+// watering_sequence state machine, fill model, logger, settings) against the
+// plant model in plant.cpp on the native HAL's virtual clock. While the system
+// is idle the clock jumps from one wall-clock minute to the next (the
+// scheduler's resolution); while anything is active it steps at the loop()
+// period. A simulated year takes a few seconds and every run with the same
+// options produces the same output.
+//
+//   pio run -e sim
+//   .pio/build/sim/program --days 365 --timeline timeline.txt
+//       --fault sensor_stuck_low@100-102 --fault shield_main_missing@200
+//
+// Totals go to stdout as JSON. --record saves what the device's trace recorder
+// would have written (the current trace file), which replay/ can check.
+#include "plant.h"
+#include "modules/motor_shield_control.h"
+#include "modules/pump_control.h"
+#include "modules/pump_calibration.h"
+#include "modules/valve_control.h"
+#include "modules/scheduler.h"
+#include "modules/sensors.h"
+#include "modules/logger.h"
+#include "modules/fill_model.h"
+#include "modules/flow_meter.h"
+#include "modules/settings_store.h"
+#include "modules/watering_sequence.h"
+#include "modules/trace_recorder.h"
+#include "hal/native/native.h"
+#include "hal/clock.h"
+#include "hal/fs.h"
+#include "config/config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#define LOOP_MS 50
+#define MS_PER_DAY 86400000ULL
+#define MAX_FAULTS 16
+
+extern float weekly_dosing_ml[7][NUM_FERTILIZERS];
+extern ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS];
+extern bool sequence_pipelined;
+extern bool humidifier_pump_active;
+extern bool watering_pump_active;
+
+struct FaultWindow {
+    int fault;
+    int first_day;
+    int last_day;   // Inclusive
+};
+
+static FILE *timeline_out = nullptr;
+static time_t start_epoch = 1704063600; // Monday 2024-01-01 00:00 CET
+
+static FaultWindow fault_windows[MAX_FAULTS];
+static int fault_window_count = 0;
+
+// Sequence accounting
+static unsigned long sequences_started = 0;
+static unsigned long sequences_completed = 0;
+static unsigned long sequences_aborted = 0;
+static float commanded_ml[NUM_FERTILIZERS];
+static bool reached_watering = false;
+
+void trigger_dosing() {
+    start_watering_sequence();
+}
+
+void sim_timeline(const char *fmt, ...) {
+    if (!timeline_out) return;
+    uint64_t wall_ms = (uint64_t)start_epoch * 1000 + hal_native_now_us() / 1000;
+    time_t seconds = wall_ms / 1000;
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(timeline_out, "%s.%03u  ", stamp, (unsigned)(wall_ms % 1000));
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(timeline_out, fmt, args);
+    va_end(args);
+    fputc('\n', timeline_out);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: sim [options]\n"
+            "  --days N              simulated days (365)\n"
+            "  --seed N              random seed for inflow variation (1)\n"
+            "  --schedule SLOTS      run times, HH:MM[/0111110],... (08:00 every day)\n"
+            "  --dose ML             dose per fertilizer per day (1.0)\n"
+            "  --pipelined           start the tank fill during dosing\n"
+            "  --inflow ML_PER_S     mains inflow (250)\n"
+            "  --pump-error FRACTION true fertilizer flow vs calibration (0)\n"
+            "  --i2c-latency-us N    virtual time per motor shield transfer (300)\n"
+            "  --bounce N            sensor chatter edges per crossing (0)\n"
+            "  --fault NAME@A[-B]    fault active on days A..B (B omitted: to the end; A-: from A)\n"
+            "  --timeline FILE       write the event timeline ('-' for stdout)\n"
+            "  --record FILE         save the trace of the last trace file period, for replay/\n"
+            "faults:");
+    for (int i = 0; i < FAULT_COUNT; i++) fprintf(stderr, " %s", sim_fault_name(i));
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+static bool parse_fault(const char *spec, FaultWindow &window) {
+    const char *at = strchr(spec, '@');
+    if (!at) return false;
+    window.fault = -1;
+    for (int i = 0; i < FAULT_COUNT; i++) {
+        if (strlen(sim_fault_name(i)) == (size_t)(at - spec) && strncmp(spec, sim_fault_name(i), at - spec) == 0) {
+            window.fault = i;
+        }
+    }
+    if (window.fault < 0) return false;
+    char *end;
+    window.first_day = strtol(at + 1, &end, 10);
+    if (end == at + 1) return false;
+    if (*end == '\0') {
+        window.last_day = window.first_day;
+    } else if (*end == '-' && end[1] == '\0') {
+        window.last_day = 1 << 30;
+    } else if (*end == '-') {
+        window.last_day = strtol(end + 1, &end, 10);
+        if (*end != '\0') return false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static uint32_t faults_for_day(int day) {
+    uint32_t mask = 0;
+    for (int i = 0; i < fault_window_count; i++) {
+        if (day >= fault_windows[i].first_day && day <= fault_windows[i].last_day) {
+            mask |= 1u << fault_windows[i].fault;
+        }
+    }
+    return mask;
+}
+
+static void log_fault_change(uint32_t before, uint32_t after) {
+    for (int i = 0; i < FAULT_COUNT; i++) {
+        uint32_t bit = 1u << i;
+        if ((before ^ after) & bit) {
+            sim_timeline("fault %s %s", sim_fault_name(i), (after & bit) ? "injected" : "cleared");
+        }
+    }
+}
+
+static bool control_is_idle() {
+    return watering_sequence_get_state() == IDLE && !watering_sequence_is_filling() && !valve_control_is_open() &&
+           !pump_control_is_dosing() && !pump_calibration_is_running() && !watering_pump_active &&
+           !humidifier_pump_active;
+}
+
+// Same order as loop(), minus networking
+static void control_iteration() {
+    logger_process_queue();
+    trace_process(control_is_idle());
+    settings_process();
+    scheduler_run();
+    pump_control_run();
+    pump_calibration_run();
+    sensors_read();
+    watering_sequence_run();
+}
+
+// Copy the current trace file out of the RAM filesystem
+static bool save_trace(const char *path) {
+    hal_file_t in = hal_fs_open(TRACE_FILE_PATH, "r");
+    if (!in) return false;
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        hal_file_close(in);
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = hal_file_read(in, buf, sizeof(buf))) > 0) fwrite(buf, 1, n, out);
+    hal_file_close(in);
+    return fclose(out) == 0;
+}
+
+static bool system_busy() {
+    return watering_sequence_get_state() != IDLE || pump_control_is_dosing() || valve_control_is_open() ||
+           humidifier_pump_active || watering_pump_active || pump_calibration_is_running() ||
+           logger_get_queue_count() > 0 || settings_is_dirty();
+}
+
+static void track_sequence(WateringState previous, WateringState state) {
+    if (state == previous) return;
+    sim_timeline("state %s -> %s", watering_state_name(previous), watering_state_name(state));
+    if (previous == IDLE) {
+        sequences_started++;
+        reached_watering = false;
+        for (int i = 0; i < NUM_FERTILIZERS; i++) {
+            commanded_ml[i] += get_current_dosing_ml(i);
+        }
+    }
+    if (state == WATERING) reached_watering = true;
+    if (state == IDLE) {
+        if (reached_watering) sequences_completed++;
+        else sequences_aborted++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int days = 365;
+    uint32_t seed = 1;
+    ScheduleSlot slots[SCHEDULE_MAX_SLOTS] = {{8, 0, SCHEDULE_EVERY_DAY}};
+    float dose_ml = -1;
+    bool pipelined = false;
+    uint32_t i2c_latency_us = 300;
+    const char *timeline_path = nullptr;
+    const char *record_path = nullptr;
+    PlantConfig plant = {};
+    plant.inflow_ml_per_s = 250;
+    plant.inflow_jitter = 0.05f;
+    plant.drain_ml_per_s = 50;
+    plant.sensor_level_ml = MAIN_TANK_FILL_VOLUME_ML;
+    plant.capacity_ml = MAIN_TANK_FILL_VOLUME_ML * 1.2f;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--pipelined") == 0) { pipelined = true; continue; }
+        if (!value) usage();
+        i++;
+        if (strcmp(arg, "--days") == 0) days = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) seed = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--schedule") == 0) {
+            if (!scheduler_parse_slots(value, slots)) usage();
+        }
+        else if (strcmp(arg, "--dose") == 0) dose_ml = atof(value);
+        else if (strcmp(arg, "--inflow") == 0) plant.inflow_ml_per_s = atof(value);
+        else if (strcmp(arg, "--pump-error") == 0) plant.pump_error = atof(value);
+        else if (strcmp(arg, "--i2c-latency-us") == 0) i2c_latency_us = strtoul(value, nullptr, 10);
+        else if (strcmp(arg, "--bounce") == 0) plant.bounce_edges = atoi(value);
+        else if (strcmp(arg, "--timeline") == 0) timeline_path = value;
+        else if (strcmp(arg, "--record") == 0) record_path = value;
+        else if (strcmp(arg, "--fault") == 0) {
+            if (fault_window_count == MAX_FAULTS || !parse_fault(value, fault_windows[fault_window_count])) usage();
+            fault_window_count++;
+        }
+        else usage();
+    }
+    plant.seed = seed;
+    if (timeline_path) {
+        timeline_out = strcmp(timeline_path, "-") == 0 ? stdout : fopen(timeline_path, "w");
+        if (!timeline_out) {
+            perror(timeline_path);
+            return 1;
+        }
+    }
+
+    setenv("TZ", "CET-1CEST,M3.5.0/2,M10.5.0/3", 1);
+    tzset();
+    hal_native_set_epoch(start_epoch);
+    hal_native_motor_set_latency_us(i2c_latency_us);
+    plant_init(plant);
+    uint32_t active_faults = faults_for_day(0);
+    log_fault_change(0, active_faults);
+    plant_set_faults(active_faults); // Before motor_shield_init so a missing shield is seen at boot
+
+    motor_shield_init();
+    pump_control_init();
+    flow_meter_init();
+    valve_control_init();
+    scheduler_init();
+    sensors_init();
+    logger_init();
+    settings_load();
+    fill_model_init();
+    trace_init();
+    if (record_path) trace_set_enabled(true);
+
+    memcpy(schedule_slots, slots, sizeof(slots));
+    scheduler_reschedule();
+    sequence_pipelined = pipelined;
+    if (dose_ml >= 0) {
+        for (int day = 0; day < 7; day++) {
+            for (int i = 0; i < NUM_FERTILIZERS; i++) weekly_dosing_ml[day][i] = dose_ml;
+        }
+    }
+
+    auto wall_start = std::chrono::steady_clock::now();
+    uint64_t end_ms = (uint64_t)days * MS_PER_DAY;
+    uint64_t start_wall_ms = (uint64_t)start_epoch * 1000;
+    unsigned long iterations = 0;
+    int day = 0;
+    WateringState state = watering_sequence_get_state();
+
+    while (hal_native_now_us() / 1000 < end_ms) {
+        int today = hal_native_now_us() / 1000 / MS_PER_DAY;
+        if (today != day) {
+            day = today;
+            uint32_t faults = faults_for_day(day);
+            if (faults != active_faults) {
+                log_fault_change(active_faults, faults);
+                plant_set_faults(faults);
+                active_faults = faults;
+            }
+        }
+
+        control_iteration();
+        iterations++;
+        WateringState now_state = watering_sequence_get_state();
+        track_sequence(state, now_state);
+        state = now_state;
+
+        if (system_busy()) {
+            hal_delay(LOOP_MS);
+        } else {
+            // Nothing can happen before the scheduler's next minute
+            uint64_t wall_ms = start_wall_ms + hal_native_now_us() / 1000;
+            hal_native_advance_ms(60000 - wall_ms % 60000);
+        }
+        plant_update();
+    }
+    logger_flush();
+    if (record_path) {
+        trace_process(control_is_idle());
+        trace_flush();
+        if (!save_trace(record_path)) perror(record_path);
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    const PlantStats &s = plant_stats();
+    printf("{\n");
+    printf("  \"days\": %d,\n", days);
+    printf("  \"seed\": %u,\n", seed);
+    printf("  \"wall_time_s\": %.3f,\n", wall_s);
+    printf("  \"speedup\": %.0f,\n", wall_s > 0 ? days * 86400.0 / wall_s : 0);
+    printf("  \"iterations\": %lu,\n", iterations);
+    printf("  \"faults\": [");
+    for (int i = 0; i < fault_window_count; i++) {
+        printf("%s{\"fault\": \"%s\", \"first_day\": %d, \"last_day\": %d}", i ? ", " : "",
+               sim_fault_name(fault_windows[i].fault), fault_windows[i].first_day,
+               fault_windows[i].last_day > days ? days - 1 : fault_windows[i].last_day);
+    }
+    printf("],\n");
+    printf("  \"sequences\": {\"started\": %lu, \"completed\": %lu, \"aborted\": %lu},\n",
+           sequences_started, sequences_completed, sequences_aborted);
+    printf("  \"fertilizers\": [\n");
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        printf("    {\"pump\": %d, \"doses\": %lu, \"commanded_ml\": %.2f, \"delivered_ml\": %.2f}%s\n", i, s.doses[i],
+               commanded_ml[i], s.delivered_ml[i], i + 1 < NUM_FERTILIZERS ? "," : "");
+    }
+    printf("  ],\n");
+    printf("  \"fills\": {\"count\": %lu, \"timeouts\": %lu, \"short_fills\": %lu, \"mean_ms\": %lu, \"min_ms\": %lu, "
+           "\"max_ms\": %lu, \"overflows\": %lu, \"max_level_ml\": %.0f, \"learned_timeout_ms\": %lu},\n",
+           s.fills, s.fill_timeouts, s.short_fills, s.fills ? s.fill_ms_total / s.fills : 0, s.fill_ms_min, s.fill_ms_max,
+           s.overflows, s.max_level_ml, fill_model_get_timeout_ms());
+    printf("  \"watering\": {\"runs\": %lu, \"total_ms\": %lu, \"water_ml\": %.0f},\n", s.watering_runs,
+           s.watering_ms_total, s.water_ml);
+    printf("  \"i2c_transfers\": %lu,\n", hal_native_motor_transfers());
+    printf("  \"log\": {\"written\": %lu, \"dropped\": %lu}\n", logger_get_written_count(), logger_get_dropped_count());
+    printf("}\n");
+
+    if (timeline_out && timeline_out != stdout) fclose(timeline_out);
+    return 0;
+}
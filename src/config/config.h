@@ -6,5 +6,58 @@
 #define VALVE_PIN 13 // GPIO pin for solenoid valve
 #define HUMIDIFIER_PUMP_CHANNEL 7 // Peristaltic pump for humidifier tank
 #define LIQUID_SENSOR_PIN 32 // Capacitive liquid sensor pin
+#define LIQUID_SENSOR_DEBOUNCE_US 500 // Level must be stable this long before it is accepted (0 = act on raw edges)
 #define MAIN_TANK_FILL_TIMEOUT_MS 120000 // Default: 2 minutes, can be changed
-#define MAX_WATERING_TIME_MS 200000 // Maximum watering time in milliseconds (5 minutes default)
\ No newline at end of file
+#define MAX_WATERING_TIME_MS 200000 // Maximum watering time in milliseconds (5 minutes default)
+#define MAIN_TANK_FILL_VOLUME_ML 10000 // Volume between empty and the sensor level, used to estimate inflow
+#define FILL_MODEL_MIN_SAMPLES 5 // Successful fills needed before the learned timeout is used
+#define FILL_MODEL_MIN_TIMEOUT_MS 15000 // Learned timeout never drops below this
+#define FILL_ANOMALY_ABORTS_SEQUENCE true // Abort watering when the tank does not fill in time
+#define MAX_FILL_OFFSET_MS 600000 // Upper bound for the pipelined fill start offset (10 minutes)
+#define FLOW_METER_ENABLED 0 // Set to 1 when a flow meter is fitted on the watering line
+#define FLOW_METER_PIN 34 // Hall-effect flow meter on the watering line (PCNT input)
+#define FLOW_METER_PULSES_PER_LITER 450.0f // Sensor K-factor (YF-S201 style meters: ~450)
+#define FLOW_STALL_GRACE_MS 5000 // Ignore low flow while the watering pump primes
+#define FLOW_STALL_WINDOW_MS 3000 // Window used to measure flow for stall detection
+#define FLOW_STALL_MIN_ML_PER_S 2.0f // Below this rate the watering line counts as stalled
+#define MAX_WATERING_VOLUME_ML 100000 // Upper bound for volume-based watering (100 l)
+#define WATERING_RUN_HISTORY 10 // Number of watering runs kept for /api/watering_runs
+#define CAL_CURVE_POINTS 4 // PWM duty points per fertilizer pump calibration curve
+#define CAL_CURVE_DUTIES {64, 128, 192, 255} // Duty of each calibration point
+#define CAL_RUN_MS 10000 // Pump runtime for each calibration measurement
+#define CAL_SHORT_RUN_MS 3000 // Extra short run at full duty used to measure spin-up
+#define CAL_MAX_SPINUP_MS 2000 // Upper bound for the spin-up correction
+#define CAL_MIN_FLOW_GAIN 0.5f // Fastest accurate speed: each segment must gain this share of the first point's ml/s per duty
+#define SETTINGS_COMMIT_DELAY_MS 2000 // Settings are written once edits have been quiet this long
+#define SETTINGS_MAX_DEFER_MS 10000 // ... or at the latest this long after the first pending edit
+#define MAX_DOSE_ML 1000.0f // Upper bound for a single fertilizer dose
+#define MAX_CALIBRATION_ML_PER_S 100.0f // Upper bound for pump calibration values
+#define SSE_HEARTBEAT_MS 10000 // Full status push interval on /api/events
+#define SSE_RECONNECT_MS 3000 // Browser reconnect delay after the event stream drops
+#define MANUAL_QUEUE_LENGTH 16 // Pending WebSocket manual control commands
+#define MANUAL_RUN_MAX_MS 60000 // Run time for a manual start of the watering/humidifier pump
+#define COMMAND_QUEUE_LENGTH 8 // Pending commands from the web server to the control loop
+#define COMMAND_JOB_HISTORY 16 // Jobs kept for /api/jobs (must exceed COMMAND_QUEUE_LENGTH)
+#define BATCH_MAX_STEPS 32 // Steps in one /api/batch program
+#define BATCH_MAX_STEP_MS 600000 // Longest single batch step (10 minutes)
+#define BATCH_MAX_TOTAL_MS 3600000 // Longest batch program (1 hour)
+#define SEQLOCK_READ_ATTEMPTS 8 // Tries, a tick apart, to copy seqlock data the control loop is updating
+#define TRACE_BUFFER_SIZE 4096 // RAM ring for trace records between loop passes
+#define TRACE_FILE_SIZE 32768 // Trace file size that starts a new file at the next idle moment
+#define TRACE_WRITE_INTERVAL_MS 5000 // Longest a trace record waits in RAM while the control loop is busy
+#define METRICS_HTTP_ROUTES 64 // Web routes with their own handler time histogram on /api/metrics
+#define FAST_START 1 // 1: setup() only brings up the control side; WiFi, NTP, OTA and the web server start from loop()
+#define WIFI_CONNECT_TIMEOUT_MS 15000 // Setup portal (AP mode) when the stored network is not joined in time
+#define NTP_SYNC_TIMEOUT_MS 15000 // "NTP sync failed" after this long; with FAST_START it keeps waiting in the background
+#define NTP_SERVER_1 "pool.ntp.org"
+#define NTP_SERVER_2 "time.nist.gov"
+#define TIME_ZONE "CET-1CEST,M3.5.0/2,M10.5.0/3" // Amsterdam (CET/CEST), POSIX TZ format
+#define TIME_SYNC_INTERVAL_MS 3600000 // SNTP resync period
+#define TIME_SYNC_STALE_S 21600 // Without a sync for this long the clock counts as holdover instead of synced
+#define SCHEDULE_MAX_SLOTS 6 // Run times in the schedule, each with its own weekdays
+#define SCHEDULE_MAX_LATE_S 3600 // Default catch-up window: a run missed by a reboot, outage or clock step still starts if at most this late
+#define SCHEDULE_MAX_CATCHUP_S 86400 // Largest catch-up window accepted in the settings
+#define BOOT_TIMELINE_ENTRIES 32 // Boot stages kept for /api/boot
+#define LOOP_PROFILE_PASSES 128 // Control loop passes kept stage by stage for /api/loop_profile
+#define LOOP_SLOW_THRESHOLD_US 20000 // Default for a pass to count as slow and be captured
+#define LOOP_SLOW_CAPTURES 8 // Slow passes kept for /api/loop_profile
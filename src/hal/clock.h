@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+// Monotonic and wall clock. On the ESP32 these are the Arduino core and newlib
+// clocks; the native build runs on a virtual clock that only moves when the host
+// program advances it (see hal/native/native.h).
+
+unsigned long hal_millis();
+unsigned long hal_micros();
+void hal_delay(unsigned long ms);
+void hal_yield();
+
+// Free-running cycle counter for timing short sections; it wraps, so only
+// differences are meaningful. On the ESP32 this is the CPU cycle count of the
+// calling core; the native build counts real nanoseconds, so profiling a host
+// program measures actual work while the virtual clock stands still.
+uint32_t hal_cycles();
+uint32_t hal_cycles_per_us();
+
+// Wall clock in epoch seconds; stays near zero until SNTP has synced
+time_t hal_time();
+
+// Start background SNTP sync against the given servers (server2 may be null),
+// repeated every interval_ms. Does not wait for the network. Corrections under
+// about half an hour are slewed, so the clock never jumps; larger ones (the
+// first sync after power-on) are stepped. on_sync runs on the network task for
+// every response, with the server time, how far the local clock was off (server
+// minus local, saturated to the int32 range) before the correction and whether
+// the clock was stepped rather than slewed. Servers are kept, not copied.
+typedef void (*HalSntpCallback)(time_t epoch, int32_t offset_ms, bool stepped);
+void hal_sntp_start(const char *server1, const char *server2, uint32_t interval_ms, HalSntpCallback on_sync);
+
+// Ask for a sync now instead of at the next retry, e.g. once WiFi is up
+void hal_sntp_resync();
+
+// Variables that survive a software reset, like the ESP32 clock itself (RTC
+// memory), but not a power cycle. Undefined after power-on: check a magic value.
+#ifdef HAL_NATIVE
+#define HAL_RETAINED_ATTR
+#else
+#include <esp_attr.h>
+#define HAL_RETAINED_ATTR RTC_NOINIT_ATTR
+#endif
@@ -0,0 +1,73 @@
+#include "hal/clock.h"
+#include <Arduino.h>
+#include <esp_netif.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+
+// millis() and micros() are also called from the liquid sensor interrupt
+unsigned long IRAM_ATTR hal_millis() {
+    return millis();
+}
+
+unsigned long IRAM_ATTR hal_micros() {
+    return micros();
+}
+
+uint32_t hal_cycles() {
+    return ESP.getCycleCount();
+}
+
+uint32_t hal_cycles_per_us() {
+    return ESP.getCpuFreqMHz();
+}
+
+void hal_delay(unsigned long ms) {
+    delay(ms);
+}
+
+void hal_yield() {
+    yield();
+}
+
+time_t hal_time() {
+    return time(nullptr);
+}
+
+static HalSntpCallback sntp_callback = nullptr;
+
+// Replaces the SNTP client's weak default, which steps large corrections with
+// settimeofday() before any notification runs. Here the offset is taken from the
+// clock before it is touched, for slews and steps alike.
+void sntp_sync_time(struct timeval *tv) {
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+    int64_t offset_us = ((int64_t)tv->tv_sec - now.tv_sec) * 1000000 + (tv->tv_usec - now.tv_usec);
+    bool stepped = true;
+    if (sntp_get_sync_mode() == SNTP_SYNC_MODE_SMOOTH) {
+        struct timeval delta = {(time_t)(offset_us / 1000000), (suseconds_t)(offset_us % 1000000)};
+        stepped = adjtime(&delta, nullptr) == -1; // Refused when too large to slew
+    }
+    if (stepped) settimeofday(tv, nullptr);
+    sntp_set_sync_status(stepped ? SNTP_SYNC_STATUS_COMPLETED : SNTP_SYNC_STATUS_IN_PROGRESS);
+
+    int64_t offset_ms = offset_us / 1000;
+    if (offset_ms > INT32_MAX) offset_ms = INT32_MAX;
+    if (offset_ms < INT32_MIN) offset_ms = INT32_MIN;
+    if (sntp_callback) sntp_callback(tv->tv_sec, (int32_t)offset_ms, stepped);
+}
+
+void hal_sntp_start(const char *server1, const char *server2, uint32_t interval_ms, HalSntpCallback on_sync) {
+    sntp_callback = on_sync;
+    esp_netif_init(); // The SNTP client needs the TCP/IP stack, which WiFi may not have started yet
+    if (sntp_enabled()) sntp_stop();
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, (char *)server1);
+    if (server2) sntp_setservername(1, (char *)server2);
+    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
+    sntp_set_sync_interval(interval_ms);
+    sntp_init();
+}
+
+void hal_sntp_resync() {
+    if (sntp_enabled()) sntp_restart();
+}
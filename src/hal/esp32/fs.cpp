@@ -0,0 +1,52 @@
+#include "hal/fs.h"
+#include <LittleFS.h>
+
+struct HalFile {
+    File file;
+};
+
+bool hal_fs_begin() {
+    return LittleFS.begin();
+}
+
+bool hal_fs_exists(const char *path) {
+    return LittleFS.exists(path);
+}
+
+bool hal_fs_remove(const char *path) {
+    return LittleFS.remove(path);
+}
+
+bool hal_fs_rename(const char *from, const char *to) {
+    return LittleFS.rename(from, to);
+}
+
+hal_file_t hal_fs_open(const char *path, const char *mode) {
+    File file = LittleFS.open(path, mode);
+    if (!file) {
+        return nullptr;
+    }
+    return new HalFile{file};
+}
+
+size_t hal_file_size(hal_file_t file) {
+    return file->file.size();
+}
+
+size_t hal_file_write(hal_file_t file, const char *data, size_t len) {
+    return file->file.write((const uint8_t *)data, len);
+}
+
+size_t hal_file_read(hal_file_t file, char *buf, size_t len) {
+    return file->file.read((uint8_t *)buf, len);
+}
+
+bool hal_file_seek(hal_file_t file, size_t pos) {
+    return file->file.seek(pos);
+}
+
+void hal_file_close(hal_file_t file) {
+    file->file.flush();
+    file->file.close();
+    delete file;
+}
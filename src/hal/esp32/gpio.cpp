@@ -0,0 +1,24 @@
+#include "hal/gpio.h"
+#include <Arduino.h>
+
+void hal_gpio_input(int pin) {
+    pinMode(pin, INPUT);
+}
+
+void hal_gpio_output(int pin) {
+    pinMode(pin, OUTPUT);
+}
+
+// Called from the liquid sensor interrupt
+bool IRAM_ATTR hal_gpio_read(int pin) {
+    return digitalRead(pin) == HIGH;
+}
+
+// Called from the liquid sensor interrupt to close the valve
+void IRAM_ATTR hal_gpio_write(int pin, bool high) {
+    digitalWrite(pin, high ? HIGH : LOW);
+}
+
+void hal_gpio_attach_change(int pin, void (*handler)()) {
+    attachInterrupt(digitalPinToInterrupt(pin), handler, CHANGE);
+}
@@ -0,0 +1,14 @@
+#include "hal/heap.h"
+#include <Arduino.h>
+
+size_t hal_heap_free() {
+    return ESP.getFreeHeap();
+}
+
+size_t hal_heap_min_free() {
+    return ESP.getMinFreeHeap();
+}
+
+size_t hal_heap_largest_block() {
+    return ESP.getMaxAllocHeap();
+}
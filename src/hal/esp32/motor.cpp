@@ -0,0 +1,41 @@
+#include "hal/motor.h"
+#include <Wire.h>
+#include <Adafruit_MotorShield.h>
+
+static Adafruit_MotorShield motor_shield1 = Adafruit_MotorShield(0x60); // Main shield
+static Adafruit_MotorShield motor_shield2 = Adafruit_MotorShield(0x61); // Extra shield
+
+// Motors 0-3 on shield1, 4-6 on shield2; nullptr when the shield is missing
+static Adafruit_DCMotor *motors[HAL_MOTOR_COUNT] = {nullptr};
+
+uint8_t hal_motor_begin() {
+    Wire.begin();
+
+    uint8_t found = 0;
+    if (motor_shield1.begin()) found |= HAL_MOTOR_SHIELD_MAIN;
+    if (motor_shield2.begin()) found |= HAL_MOTOR_SHIELD_EXTRA;
+
+    for (int i = 0; i < 4; i++) {
+        motors[i] = (found & HAL_MOTOR_SHIELD_MAIN) ? motor_shield1.getMotor(i + 1) : nullptr;
+    }
+    for (int i = 0; i < 3; i++) {
+        motors[4 + i] = (found & HAL_MOTOR_SHIELD_EXTRA) ? motor_shield2.getMotor(i + 1) : nullptr;
+    }
+    return found;
+}
+
+bool hal_motor_present(int index) {
+    return index >= 0 && index < HAL_MOTOR_COUNT && motors[index] != nullptr;
+}
+
+void hal_motor_set_speed(int index, uint8_t speed) {
+    if (hal_motor_present(index)) motors[index]->setSpeed(speed);
+}
+
+void hal_motor_forward(int index) {
+    if (hal_motor_present(index)) motors[index]->run(FORWARD);
+}
+
+void hal_motor_release(int index) {
+    if (hal_motor_present(index)) motors[index]->run(RELEASE);
+}
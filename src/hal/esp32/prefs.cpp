@@ -0,0 +1,48 @@
+#include "hal/prefs.h"
+#include <Preferences.h>
+
+static Preferences preferences;
+
+bool hal_prefs_begin(const char *ns, bool read_only) {
+    return preferences.begin(ns, read_only);
+}
+
+void hal_prefs_end() {
+    preferences.end();
+}
+
+bool hal_prefs_is_key(const char *key) {
+    return preferences.isKey(key);
+}
+
+bool hal_prefs_remove(const char *key) {
+    return preferences.remove(key);
+}
+
+size_t hal_prefs_get_bytes_length(const char *key) {
+    return preferences.getBytesLength(key);
+}
+
+size_t hal_prefs_get_bytes(const char *key, void *buf, size_t len) {
+    return preferences.getBytes(key, buf, len);
+}
+
+size_t hal_prefs_put_bytes(const char *key, const void *data, size_t len) {
+    return preferences.putBytes(key, data, len);
+}
+
+float hal_prefs_get_float(const char *key, float default_value) {
+    return preferences.getFloat(key, default_value);
+}
+
+bool hal_prefs_get_bool(const char *key, bool default_value) {
+    return preferences.getBool(key, default_value);
+}
+
+int32_t hal_prefs_get_int(const char *key, int32_t default_value) {
+    return preferences.getInt(key, default_value);
+}
+
+uint32_t hal_prefs_get_ulong(const char *key, uint32_t default_value) {
+    return preferences.getULong(key, default_value);
+}
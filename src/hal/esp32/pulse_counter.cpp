@@ -0,0 +1,65 @@
+#include "hal/pulse_counter.h"
+#include <Arduino.h>
+#include <driver/pcnt.h>
+
+#define FLOW_PCNT_UNIT PCNT_UNIT_0
+#define FLOW_PCNT_H_LIM 30000   // Counter wraps here (hardware counter is 16-bit signed)
+#define FLOW_PCNT_FILTER 1000   // Ignore pulses shorter than ~12.5 us (APB cycles)
+
+static volatile unsigned long overflow_pulses = 0;
+
+static void IRAM_ATTR pulse_counter_overflow_isr(void *arg) {
+    uint32_t status = 0;
+    pcnt_get_event_status(FLOW_PCNT_UNIT, &status);
+    if (status & PCNT_EVT_H_LIM) {
+        // The hardware counter has reset to zero
+        overflow_pulses += FLOW_PCNT_H_LIM;
+    }
+}
+
+bool hal_pulse_counter_begin(int pin) {
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = FLOW_PCNT_UNIT;
+    config.pos_mode = PCNT_COUNT_INC;   // Count rising edges
+    config.neg_mode = PCNT_COUNT_DIS;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = FLOW_PCNT_H_LIM;
+    config.counter_l_lim = 0;
+
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        return false;
+    }
+    pcnt_set_filter_value(FLOW_PCNT_UNIT, FLOW_PCNT_FILTER);
+    pcnt_filter_enable(FLOW_PCNT_UNIT);
+    pcnt_event_enable(FLOW_PCNT_UNIT, PCNT_EVT_H_LIM);
+    pcnt_isr_service_install(0);
+    pcnt_isr_handler_add(FLOW_PCNT_UNIT, pulse_counter_overflow_isr, nullptr);
+
+    pcnt_counter_pause(FLOW_PCNT_UNIT);
+    pcnt_counter_clear(FLOW_PCNT_UNIT);
+    pcnt_counter_resume(FLOW_PCNT_UNIT);
+    overflow_pulses = 0;
+    return true;
+}
+
+void hal_pulse_counter_clear() {
+    pcnt_counter_pause(FLOW_PCNT_UNIT);
+    pcnt_counter_clear(FLOW_PCNT_UNIT);
+    overflow_pulses = 0;
+    pcnt_counter_resume(FLOW_PCNT_UNIT);
+}
+
+unsigned long hal_pulse_counter_read() {
+    // Re-read if an overflow interrupt landed between the two reads
+    unsigned long base;
+    int16_t count;
+    do {
+        base = overflow_pulses;
+        pcnt_get_counter_value(FLOW_PCNT_UNIT, &count);
+    } while (base != overflow_pulses);
+    return base + (unsigned long)count;
+}
@@ -0,0 +1,24 @@
+#include "hal/timer.h"
+#include <esp_timer.h>
+
+// The HAL handle is the esp_timer handle itself
+hal_timer_t hal_timer_create(void (*callback)(void *arg), void *arg, const char *name) {
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = callback;
+    timer_args.arg = arg;
+    timer_args.dispatch_method = ESP_TIMER_TASK;
+    timer_args.name = name;
+    esp_timer_handle_t handle = nullptr;
+    if (esp_timer_create(&timer_args, &handle) != ESP_OK) {
+        return nullptr;
+    }
+    return (hal_timer_t)handle;
+}
+
+void IRAM_ATTR hal_timer_start_once(hal_timer_t timer, uint64_t timeout_us) {
+    esp_timer_start_once((esp_timer_handle_t)timer, timeout_us);
+}
+
+void IRAM_ATTR hal_timer_stop(hal_timer_t timer) {
+    esp_timer_stop((esp_timer_handle_t)timer);
+}
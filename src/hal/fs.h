@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+
+// Flash filesystem (LittleFS on the ESP32, an in-memory store in the native build)
+
+typedef struct HalFile *hal_file_t;
+
+bool hal_fs_begin();
+bool hal_fs_exists(const char *path);
+bool hal_fs_remove(const char *path);
+bool hal_fs_rename(const char *from, const char *to);
+
+// mode is "r", "w" or "a"; returns nullptr if the file cannot be opened
+hal_file_t hal_fs_open(const char *path, const char *mode);
+size_t hal_file_size(hal_file_t file);
+size_t hal_file_write(hal_file_t file, const char *data, size_t len);
+size_t hal_file_read(hal_file_t file, char *buf, size_t len);
+bool hal_file_seek(hal_file_t file, size_t pos);
+// Flushes pending writes and releases the handle
+void hal_file_close(hal_file_t file);
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdbool.h>
+
+// Digital pins. hal_gpio_attach_change() calls the handler from interrupt
+// context on every edge, so handlers must be HAL_ISR_ATTR (see hal/isr.h).
+
+void hal_gpio_input(int pin);
+void hal_gpio_output(int pin);
+bool hal_gpio_read(int pin);
+void hal_gpio_write(int pin, bool high);
+void hal_gpio_attach_change(int pin, void (*handler)());
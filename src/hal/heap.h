@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+
+// Heap statistics for diagnostics. The native build has no fixed heap; it
+// reports a device-sized budget minus what the process allocated since start
+// (see hal_native_heap_set_size()).
+
+size_t hal_heap_free();
+size_t hal_heap_min_free();       // Low-water mark since boot
+size_t hal_heap_largest_block();  // Largest single allocation that would succeed
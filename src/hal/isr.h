@@ -0,0 +1,37 @@
+#pragma once
+
+// Interrupt-context support: placement of handlers and the spinlocks that guard
+// data shared between handlers, timer callbacks and tasks.
+//
+// The native build delivers "interrupts" synchronously on the host thread that
+// changes a fake input, so the locks compile to nothing there.
+
+#ifdef HAL_NATIVE
+
+#define HAL_ISR_ATTR
+typedef struct { int unused; } hal_lock_t;
+#define HAL_LOCK_INITIALIZER {0}
+#define hal_lock_enter(lock) ((void)(lock))
+#define hal_lock_exit(lock) ((void)(lock))
+#define hal_lock_enter_isr(lock) ((void)(lock))
+#define hal_lock_exit_isr(lock) ((void)(lock))
+#define hal_lock_enter_any(lock) ((void)(lock))
+#define hal_lock_exit_any(lock) ((void)(lock))
+
+#else
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#define HAL_ISR_ATTR IRAM_ATTR
+typedef portMUX_TYPE hal_lock_t;
+#define HAL_LOCK_INITIALIZER portMUX_INITIALIZER_UNLOCKED
+#define hal_lock_enter(lock) portENTER_CRITICAL(lock)
+#define hal_lock_exit(lock) portEXIT_CRITICAL(lock)
+#define hal_lock_enter_isr(lock) portENTER_CRITICAL_ISR(lock)
+#define hal_lock_exit_isr(lock) portEXIT_CRITICAL_ISR(lock)
+// For code reached from both task and interrupt context
+#define hal_lock_enter_any(lock) portENTER_CRITICAL_SAFE(lock)
+#define hal_lock_exit_any(lock) portEXIT_CRITICAL_SAFE(lock)
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// DC motor outputs on the I2C motor shields: motors 0-3 on the main shield
+// (0x60), 4-6 on the extra shield (0x61). Each call is one I2C transfer and
+// returns once it has completed.
+
+#define HAL_MOTOR_COUNT 7
+#define HAL_MOTOR_SHIELD_MAIN  (1 << 0)
+#define HAL_MOTOR_SHIELD_EXTRA (1 << 1)
+
+// Probe both shields; returns the HAL_MOTOR_SHIELD_* bits of those that answered
+uint8_t hal_motor_begin();
+bool hal_motor_present(int index);
+void hal_motor_set_speed(int index, uint8_t speed);
+void hal_motor_forward(int index);
+void hal_motor_release(int index);
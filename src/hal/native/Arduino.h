@@ -0,0 +1,28 @@
+#pragma once
+// Minimal stand-in for the Arduino core used by the native build: String and
+// Serial only. Timing, pins and peripherals go through the HAL (hal/*.h).
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "WString.h"
+
+// newlib has strlcpy; glibc only since 2.38
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+#define HAL_NATIVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) {}
+    size_t print(const char *s);
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t println(const char *s);
+    size_t println(const String &s) { return println(s.c_str()); }
+    size_t println() { return println(""); }
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,79 @@
+#pragma once
+// Subset of the Arduino String class backed by std::string, sufficient for the
+// control modules and for ArduinoJson (ARDUINOJSON_ENABLE_ARDUINO_STRING).
+#include <string>
+#include <stddef.h>
+
+#define DEC 10
+#define HEX 16
+
+class String {
+public:
+    String() {}
+    String(const char *s) : str(s ? s : "") {}
+    String(const std::string &s) : str(s) {}
+    explicit String(char c) : str(1, c) {}
+    String(int value, unsigned char base = DEC) : str(format_signed(value, base)) {}
+    String(unsigned int value, unsigned char base = DEC) : str(format_unsigned(value, base)) {}
+    String(long value, unsigned char base = DEC) : str(format_signed(value, base)) {}
+    String(unsigned long value, unsigned char base = DEC) : str(format_unsigned(value, base)) {}
+    String(long long value, unsigned char base = DEC) : str(format_signed(value, base)) {}
+    String(unsigned long long value, unsigned char base = DEC) : str(format_unsigned(value, base)) {}
+    String(float value, unsigned char decimals = 2) : str(format_float(value, decimals)) {}
+    String(double value, unsigned char decimals = 2) : str(format_float(value, decimals)) {}
+
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.size(); }
+    bool isEmpty() const { return str.empty(); }
+    void reserve(unsigned int size) { str.reserve(size); }
+    char charAt(unsigned int index) const { return index < str.size() ? str[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    unsigned char concat(const String &s) { str += s.str; return 1; }
+    unsigned char concat(const char *s) { if (!s) return 0; str += s; return 1; }
+    unsigned char concat(const char *s, unsigned int len) { if (!s) return 0; str.append(s, len); return 1; }
+    unsigned char concat(char c) { str += c; return 1; }
+
+    String &operator+=(const String &s) { str += s.str; return *this; }
+    String &operator+=(const char *s) { if (s) str += s; return *this; }
+    String &operator+=(char c) { str += c; return *this; }
+
+    bool operator==(const String &s) const { return str == s.str; }
+    bool operator==(const char *s) const { return str == (s ? s : ""); }
+    bool operator!=(const String &s) const { return str != s.str; }
+    bool operator!=(const char *s) const { return !(*this == s); }
+    bool operator<(const String &s) const { return str < s.str; }
+
+    int indexOf(char c, unsigned int from = 0) const { return to_index(str.find(c, from)); }
+    int indexOf(const String &s, unsigned int from = 0) const { return to_index(str.find(s.str, from)); }
+    bool startsWith(const String &s) const { return str.compare(0, s.str.size(), s.str) == 0; }
+    bool endsWith(const String &s) const {
+        return str.size() >= s.str.size() && str.compare(str.size() - s.str.size(), s.str.size(), s.str) == 0;
+    }
+    String substring(unsigned int from) const { return from < str.size() ? String(str.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        return from < to && from < str.size() ? String(str.substr(from, to - from)) : String();
+    }
+    void trim();
+    long toInt() const { return strtol(str.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(str.c_str(), nullptr); }
+
+private:
+    static int to_index(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    static std::string format_signed(long long value, unsigned char base);
+    static std::string format_unsigned(unsigned long long value, unsigned char base);
+    static std::string format_float(double value, unsigned char decimals);
+
+    std::string str;
+};
+
+// Result type of concatenation in the Arduino core; ArduinoJson refers to it by name
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String &s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+inline StringSumHelper operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+inline StringSumHelper operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+inline StringSumHelper operator+(const String &a, char b) { String r(a); r += b; return r; }
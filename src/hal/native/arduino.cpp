@@ -0,0 +1,74 @@
+#include "Arduino.h"
+#include "native.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+
+HardwareSerial Serial;
+static bool serial_enabled = false;
+
+void hal_native_serial_enable(bool enabled) {
+    serial_enabled = enabled;
+}
+
+size_t HardwareSerial::print(const char *s) {
+    if (!serial_enabled) return 0;
+    return fputs(s, stdout) < 0 ? 0 : strlen(s);
+}
+
+size_t HardwareSerial::println(const char *s) {
+    if (!serial_enabled) return 0;
+    size_t n = print(s);
+    fputc('\n', stdout);
+    return n + 1;
+}
+
+#ifdef HAL_NATIVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+std::string String::format_unsigned(unsigned long long value, unsigned char base) {
+    if (base < 2 || base > 36) base = DEC;
+    char buf[72];
+    char *p = buf + sizeof(buf) - 1;
+    *p = '\0';
+    do {
+        int digit = value % base;
+        *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value);
+    return p;
+}
+
+std::string String::format_signed(long long value, unsigned char base) {
+    if (base != DEC) {
+        // Like the 32-bit Arduino core: other bases print the two's complement bit pattern
+        return format_unsigned((uint32_t)value, base);
+    }
+    if (value < 0) {
+        return "-" + format_unsigned(0ULL - (unsigned long long)value, base);
+    }
+    return format_unsigned(value, base);
+}
+
+std::string String::format_float(double value, unsigned char decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+    return buf;
+}
+
+void String::trim() {
+    size_t begin = 0;
+    while (begin < str.size() && isspace((unsigned char)str[begin])) begin++;
+    size_t end = str.size();
+    while (end > begin && isspace((unsigned char)str[end - 1])) end--;
+    str = str.substr(begin, end - begin);
+}
@@ -0,0 +1,115 @@
+#include "hal/clock.h"
+#include "hal/timer.h"
+#include "native.h"
+#include <chrono>
+#include <vector>
+
+struct HalTimer {
+    void (*callback)(void *arg);
+    void *arg;
+    bool armed;
+    uint64_t deadline_us;
+};
+
+static uint64_t now_us = 0;
+static int64_t epoch_offset_us = 0;  // Wall clock = now_us + epoch_offset_us
+static bool sntp_started = false;
+#define SNTP_SLEW_LIMIT_US ((int64_t)1 << 31) // adjtime() on the ESP32 steps larger corrections
+static HalSntpCallback sntp_callback = nullptr;
+static std::vector<HalTimer *> timers;
+
+unsigned long hal_millis() {
+    return (unsigned long)(now_us / 1000);
+}
+
+unsigned long hal_micros() {
+    return (unsigned long)now_us;
+}
+
+uint32_t hal_cycles() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t hal_cycles_per_us() {
+    return 1000;
+}
+
+void hal_delay(unsigned long ms) {
+    hal_native_advance_us((uint64_t)ms * 1000);
+}
+
+void hal_yield() {
+}
+
+time_t hal_time() {
+    return (time_t)(((int64_t)now_us + epoch_offset_us) / 1000000);
+}
+
+void hal_sntp_start(const char *server1, const char *server2, uint32_t interval_ms, HalSntpCallback on_sync) {
+    sntp_started = true;
+    sntp_callback = on_sync;
+}
+
+void hal_sntp_resync() {
+}
+
+hal_timer_t hal_timer_create(void (*callback)(void *arg), void *arg, const char *name) {
+    HalTimer *timer = new HalTimer{callback, arg, false, 0};
+    timers.push_back(timer);
+    return timer;
+}
+
+void hal_timer_start_once(hal_timer_t timer, uint64_t timeout_us) {
+    timer->armed = true;
+    timer->deadline_us = now_us + timeout_us;
+}
+
+void hal_timer_stop(hal_timer_t timer) {
+    timer->armed = false;
+}
+
+void hal_native_advance_us(uint64_t us) {
+    uint64_t target = now_us + us;
+    for (;;) {
+        HalTimer *next = nullptr;
+        for (HalTimer *timer : timers) {
+            if (timer->armed && timer->deadline_us <= target && (!next || timer->deadline_us < next->deadline_us)) {
+                next = timer;
+            }
+        }
+        if (!next) break;
+        if (next->deadline_us > now_us) now_us = next->deadline_us;
+        next->armed = false;
+        next->callback(next->arg);
+    }
+    now_us = target;
+}
+
+void hal_native_advance_ms(unsigned long ms) {
+    hal_native_advance_us((uint64_t)ms * 1000);
+}
+
+uint64_t hal_native_now_us() {
+    return now_us;
+}
+
+void hal_native_set_epoch(time_t epoch) {
+    epoch_offset_us = (int64_t)epoch * 1000000 - (int64_t)now_us;
+}
+
+bool hal_native_sntp_started() {
+    return sntp_started;
+}
+
+void hal_native_sntp_sync(time_t epoch) {
+    int64_t local_us = (int64_t)now_us + epoch_offset_us;
+    int64_t offset_us = (int64_t)epoch * 1000000 - local_us;
+    int64_t offset_ms = offset_us / 1000;
+    if (offset_ms > INT32_MAX) offset_ms = INT32_MAX;
+    if (offset_ms < INT32_MIN) offset_ms = INT32_MIN;
+    hal_native_set_epoch(epoch);
+    // The virtual clock always jumps; report what the ESP32 would have done
+    bool stepped = offset_us >= SNTP_SLEW_LIMIT_US || offset_us <= -SNTP_SLEW_LIMIT_US;
+    if (sntp_callback) sntp_callback(epoch, (int32_t)offset_ms, stepped);
+}
@@ -0,0 +1,79 @@
+#include "hal/fs.h"
+#include "native.h"
+#include <map>
+#include <string>
+#include <string.h>
+
+// RAM-backed filesystem: path -> contents
+static std::map<std::string, std::string> files;
+
+struct HalFile {
+    std::string *data;
+    size_t pos;
+    bool writable;
+};
+
+bool hal_fs_begin() {
+    return true;
+}
+
+bool hal_fs_exists(const char *path) {
+    return files.count(path) > 0;
+}
+
+bool hal_fs_remove(const char *path) {
+    return files.erase(path) > 0;
+}
+
+bool hal_fs_rename(const char *from, const char *to) {
+    auto it = files.find(from);
+    if (it == files.end()) return false;
+    std::string data = std::move(it->second);
+    files.erase(it);
+    files[to] = std::move(data);
+    return true;
+}
+
+hal_file_t hal_fs_open(const char *path, const char *mode) {
+    if (strcmp(mode, "r") == 0) {
+        auto it = files.find(path);
+        if (it == files.end()) return nullptr;
+        return new HalFile{&it->second, 0, false};
+    }
+    std::string &data = files[path];
+    if (strcmp(mode, "w") == 0) data.clear();
+    return new HalFile{&data, data.size(), true};
+}
+
+size_t hal_file_size(hal_file_t file) {
+    return file->data->size();
+}
+
+size_t hal_file_write(hal_file_t file, const char *data, size_t len) {
+    if (!file->writable) return 0;
+    file->data->append(data, len);
+    file->pos = file->data->size();
+    return len;
+}
+
+size_t hal_file_read(hal_file_t file, char *buf, size_t len) {
+    size_t available = file->pos < file->data->size() ? file->data->size() - file->pos : 0;
+    if (len > available) len = available;
+    memcpy(buf, file->data->data() + file->pos, len);
+    file->pos += len;
+    return len;
+}
+
+bool hal_file_seek(hal_file_t file, size_t pos) {
+    if (pos > file->data->size()) return false;
+    file->pos = pos;
+    return true;
+}
+
+void hal_file_close(hal_file_t file) {
+    delete file;
+}
+
+void hal_native_fs_clear() {
+    files.clear();
+}
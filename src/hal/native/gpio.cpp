@@ -0,0 +1,49 @@
+#include "hal/gpio.h"
+#include "native.h"
+
+#define NATIVE_PIN_COUNT 40
+
+static bool level[NATIVE_PIN_COUNT];
+static bool is_output[NATIVE_PIN_COUNT];
+static void (*change_handler[NATIVE_PIN_COUNT])();
+static HalNativePinObserver pin_observer = nullptr;
+
+static bool valid(int pin) {
+    return pin >= 0 && pin < NATIVE_PIN_COUNT;
+}
+
+void hal_gpio_input(int pin) {
+    if (valid(pin)) is_output[pin] = false;
+}
+
+void hal_gpio_output(int pin) {
+    if (valid(pin)) is_output[pin] = true;
+}
+
+bool hal_gpio_read(int pin) {
+    return valid(pin) && level[pin];
+}
+
+void hal_gpio_write(int pin, bool high) {
+    if (!valid(pin) || !is_output[pin]) return;
+    level[pin] = high;
+    if (pin_observer) pin_observer(pin, high);
+}
+
+void hal_gpio_attach_change(int pin, void (*handler)()) {
+    if (valid(pin)) change_handler[pin] = handler;
+}
+
+void hal_native_set_input(int pin, bool high) {
+    if (!valid(pin) || is_output[pin] || level[pin] == high) return;
+    level[pin] = high;
+    if (change_handler[pin]) change_handler[pin]();
+}
+
+bool hal_native_get_output(int pin) {
+    return valid(pin) && is_output[pin] && level[pin];
+}
+
+void hal_native_on_pin_write(HalNativePinObserver observer) {
+    pin_observer = observer;
+}
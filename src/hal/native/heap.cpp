@@ -0,0 +1,41 @@
+#include "hal/heap.h"
+#include "native.h"
+#include <malloc.h>
+
+// Roughly what an ESP32 has free once WiFi and the web server are up
+static size_t heap_size = 200 * 1024;
+static size_t baseline = 0;
+static bool baseline_set = false;
+static size_t min_free = (size_t)-1;
+
+static size_t allocated() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+void hal_native_heap_set_size(size_t bytes) {
+    heap_size = bytes;
+    baseline = allocated();
+    baseline_set = true;
+    min_free = (size_t)-1;
+}
+
+size_t hal_heap_free() {
+    if (!baseline_set) hal_native_heap_set_size(heap_size);
+    size_t used = allocated();
+    used = used > baseline ? used - baseline : 0;
+    size_t free_bytes = used < heap_size ? heap_size - used : 0;
+    if (free_bytes < min_free) min_free = free_bytes;
+    return free_bytes;
+}
+
+// Only sampled when the free heap is read
+size_t hal_heap_min_free() {
+    hal_heap_free();
+    return min_free;
+}
+
+// No fragmentation model
+size_t hal_heap_largest_block() {
+    return hal_heap_free();
+}
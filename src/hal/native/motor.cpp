@@ -0,0 +1,78 @@
+#include "hal/motor.h"
+#include "native.h"
+
+static uint8_t shields_fitted = HAL_MOTOR_SHIELD_MAIN | HAL_MOTOR_SHIELD_EXTRA;
+static uint8_t shields_found = 0;
+static uint32_t transfer_latency_us = 0;
+static unsigned long transfers = 0;
+static uint8_t speed[HAL_MOTOR_COUNT];
+static bool running[HAL_MOTOR_COUNT];
+static HalNativeMotorObserver motor_observer = nullptr;
+
+static uint8_t shield_of(int index) {
+    return index < 4 ? HAL_MOTOR_SHIELD_MAIN : HAL_MOTOR_SHIELD_EXTRA;
+}
+
+// Every command costs one I2C transfer; a shield removed after hal_motor_begin()
+// no longer answers, so the command has no effect
+static bool transfer(int index) {
+    transfers++;
+    if (transfer_latency_us) hal_native_advance_us(transfer_latency_us);
+    return shields_fitted & shield_of(index);
+}
+
+uint8_t hal_motor_begin() {
+    shields_found = shields_fitted;
+    for (int i = 0; i < HAL_MOTOR_COUNT; i++) {
+        speed[i] = 0;
+        running[i] = false;
+    }
+    return shields_found;
+}
+
+bool hal_motor_present(int index) {
+    return index >= 0 && index < HAL_MOTOR_COUNT && (shields_found & shield_of(index));
+}
+
+void hal_motor_set_speed(int index, uint8_t value) {
+    if (!hal_motor_present(index) || !transfer(index)) return;
+    speed[index] = value;
+    if (running[index] && motor_observer) motor_observer(index, true, value);
+}
+
+void hal_motor_forward(int index) {
+    if (!hal_motor_present(index) || !transfer(index)) return;
+    running[index] = true;
+    if (motor_observer) motor_observer(index, true, speed[index]);
+}
+
+void hal_motor_release(int index) {
+    if (!hal_motor_present(index) || !transfer(index)) return;
+    bool was_running = running[index];
+    running[index] = false;
+    if (was_running && motor_observer) motor_observer(index, false, speed[index]);
+}
+
+void hal_native_motor_set_shields(uint8_t present) {
+    shields_fitted = present;
+}
+
+void hal_native_motor_set_latency_us(uint32_t us) {
+    transfer_latency_us = us;
+}
+
+uint8_t hal_native_motor_speed(int index) {
+    return index >= 0 && index < HAL_MOTOR_COUNT ? speed[index] : 0;
+}
+
+bool hal_native_motor_running(int index) {
+    return index >= 0 && index < HAL_MOTOR_COUNT && running[index];
+}
+
+unsigned long hal_native_motor_transfers() {
+    return transfers;
+}
+
+void hal_native_on_motor_change(HalNativeMotorObserver observer) {
+    motor_observer = observer;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Controls for the fake hardware behind the native HAL. Host programs (the native
+// harness, simulator, benchmarks) drive time and inputs through these and watch
+// the actuators; the control modules only ever see the hal/*.h interfaces.
+//
+// Everything runs on one host thread. Time stands still until the host advances
+// it (hal_delay() advances it too), and due timers fire in deadline order from
+// inside the advance call.
+
+// Clock
+void hal_native_advance_us(uint64_t us);
+void hal_native_advance_ms(unsigned long ms);
+uint64_t hal_native_now_us();
+void hal_native_set_epoch(time_t epoch);   // Wall clock at the current virtual time
+bool hal_native_sntp_started();
+void hal_native_sntp_sync(time_t epoch);   // SNTP response: steps the clock and calls the sync callback
+
+// GPIO: inputs fire their change handler when the level changes
+void hal_native_set_input(int pin, bool high);
+bool hal_native_get_output(int pin);
+typedef void (*HalNativePinObserver)(int pin, bool high);
+void hal_native_on_pin_write(HalNativePinObserver observer);
+
+// Motor shields
+void hal_native_motor_set_shields(uint8_t present);     // HAL_MOTOR_SHIELD_* bits; later changes drop shields off the bus
+void hal_native_motor_set_latency_us(uint32_t us);       // Virtual time each I2C transfer takes
+uint8_t hal_native_motor_speed(int index);
+bool hal_native_motor_running(int index);
+unsigned long hal_native_motor_transfers();
+typedef void (*HalNativeMotorObserver)(int index, bool running, uint8_t speed);
+void hal_native_on_motor_change(HalNativeMotorObserver observer);
+
+// Flow meter pulses
+void hal_native_pulse_add(unsigned long pulses);
+
+// Storage
+void hal_native_fs_clear();
+void hal_native_prefs_clear();
+
+// Heap: hal_heap_*() report bytes minus what the process allocated since this call
+// (or since the first heap query)
+void hal_native_heap_set_size(size_t bytes);
+
+// Serial output (off by default)
+void hal_native_serial_enable(bool enabled);
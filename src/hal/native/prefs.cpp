@@ -0,0 +1,86 @@
+#include "hal/prefs.h"
+#include "native.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <string.h>
+
+// In-memory NVS: namespace -> key -> raw value
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> store;
+static std::map<std::string, std::vector<uint8_t>> *current = nullptr;
+static bool current_read_only = false;
+
+bool hal_prefs_begin(const char *ns, bool read_only) {
+    current = &store[ns];
+    current_read_only = read_only;
+    return true;
+}
+
+void hal_prefs_end() {
+    current = nullptr;
+}
+
+static const std::vector<uint8_t> *find(const char *key) {
+    if (!current) return nullptr;
+    auto it = current->find(key);
+    return it == current->end() ? nullptr : &it->second;
+}
+
+bool hal_prefs_is_key(const char *key) {
+    return find(key) != nullptr;
+}
+
+bool hal_prefs_remove(const char *key) {
+    if (!current || current_read_only) return false;
+    return current->erase(key) > 0;
+}
+
+size_t hal_prefs_get_bytes_length(const char *key) {
+    const std::vector<uint8_t> *value = find(key);
+    return value ? value->size() : 0;
+}
+
+size_t hal_prefs_get_bytes(const char *key, void *buf, size_t len) {
+    const std::vector<uint8_t> *value = find(key);
+    // Like NVS: fails unless the buffer holds the whole value
+    if (!value || value->size() > len) return 0;
+    memcpy(buf, value->data(), value->size());
+    return value->size();
+}
+
+size_t hal_prefs_put_bytes(const char *key, const void *data, size_t len) {
+    if (!current || current_read_only) return 0;
+    const uint8_t *bytes = (const uint8_t *)data;
+    (*current)[key].assign(bytes, bytes + len);
+    return len;
+}
+
+template <typename T>
+static T get_scalar(const char *key, T default_value) {
+    const std::vector<uint8_t> *value = find(key);
+    if (!value || value->size() != sizeof(T)) return default_value;
+    T result;
+    memcpy(&result, value->data(), sizeof(T));
+    return result;
+}
+
+float hal_prefs_get_float(const char *key, float default_value) {
+    return get_scalar(key, default_value);
+}
+
+bool hal_prefs_get_bool(const char *key, bool default_value) {
+    return get_scalar<uint8_t>(key, default_value ? 1 : 0) != 0;
+}
+
+int32_t hal_prefs_get_int(const char *key, int32_t default_value) {
+    return get_scalar(key, default_value);
+}
+
+uint32_t hal_prefs_get_ulong(const char *key, uint32_t default_value) {
+    return get_scalar(key, default_value);
+}
+
+void hal_native_prefs_clear() {
+    store.clear();
+    current = nullptr;
+}
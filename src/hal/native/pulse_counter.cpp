@@ -0,0 +1,23 @@
+#include "hal/pulse_counter.h"
+#include "native.h"
+
+static bool started = false;
+static unsigned long pulses = 0;
+
+bool hal_pulse_counter_begin(int pin) {
+    started = true;
+    pulses = 0;
+    return true;
+}
+
+void hal_pulse_counter_clear() {
+    pulses = 0;
+}
+
+unsigned long hal_pulse_counter_read() {
+    return pulses;
+}
+
+void hal_native_pulse_add(unsigned long count) {
+    if (started) pulses += count;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Namespaced key/value store (NVS Preferences on the ESP32). One namespace is
+// open at a time, between hal_prefs_begin() and hal_prefs_end().
+
+bool hal_prefs_begin(const char *ns, bool read_only);
+void hal_prefs_end();
+bool hal_prefs_is_key(const char *key);
+bool hal_prefs_remove(const char *key);
+
+size_t hal_prefs_get_bytes_length(const char *key);
+size_t hal_prefs_get_bytes(const char *key, void *buf, size_t len);
+size_t hal_prefs_put_bytes(const char *key, const void *data, size_t len);
+
+// Scalars of the old per-key settings layout
+float hal_prefs_get_float(const char *key, float default_value);
+bool hal_prefs_get_bool(const char *key, bool default_value);
+int32_t hal_prefs_get_int(const char *key, int32_t default_value);
+uint32_t hal_prefs_get_ulong(const char *key, uint32_t default_value);
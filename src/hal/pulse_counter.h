@@ -0,0 +1,9 @@
+#pragma once
+#include <stdbool.h>
+
+// Hardware rising-edge counter (PCNT on the ESP32) for the flow meter. The count
+// is extended past the 16-bit hardware counter and only wraps at ULONG_MAX.
+
+bool hal_pulse_counter_begin(int pin);
+void hal_pulse_counter_clear();
+unsigned long hal_pulse_counter_read();
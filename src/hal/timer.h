@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+// One-shot timers with microsecond resolution (esp_timer on the ESP32). The
+// callback runs in the high-priority timer task; start and stop may be called
+// from interrupt handlers.
+
+typedef struct HalTimer *hal_timer_t;
+
+// Returns nullptr if no timer could be created
+hal_timer_t hal_timer_create(void (*callback)(void *arg), void *arg, const char *name);
+void hal_timer_start_once(hal_timer_t timer, uint64_t timeout_us);
+void hal_timer_stop(hal_timer_t timer);
@@ -4,114 +4,63 @@
 #include "modules/scheduler.h"
 #include "modules/sensors.h"
 #include "modules/logger.h"
+#include "modules/fill_model.h"
+#include "modules/flow_meter.h"
+#include "modules/pump_calibration.h"
+#include "modules/settings_store.h"
+#include "modules/config_json.h"
+#include "modules/response_cache.h"
+#include "modules/api_json.h"
+#include "modules/manual_control.h"
+#include "modules/command_queue.h"
+#include "modules/state_snapshot.h"
+#include "modules/batch_runner.h"
+#include "modules/watering_sequence.h"
+#include "modules/control_commands.h"
+#include "modules/trace_recorder.h"
+#include "modules/web_json.h"
+#include "modules/metrics.h"
+#include "modules/loop_profiler.h"
+#include "modules/boot_timeline.h"
+#include "modules/time_sync.h"
 #include <WiFi.h>
 #include <esp_wifi.h>  // For power saving control
 #include <ESPmDNS.h>
 #include <ArduinoOTA.h>
-#include <Preferences.h>
 
 #include <LittleFS.h>
 fs::FS &filesystem = LittleFS;
 #include <ESPAsyncWebServer.h>
+#include <AsyncJson.h>
 #include <ArduinoJson.h>
 #include "config/config.h"
 #include <time.h>
 
-Preferences preferences;
-
 // Function declarations
 void setup_routes();
-void start_watering_sequence();
-void save_settings();
 
 // Dosing settings (ml per fertilizer) - now per day of week
 float weekly_dosing_ml[7][NUM_FERTILIZERS]; // [day_of_week][fertilizer_index]
 bool weekly_watering_enabled[7]; // [day_of_week] - true if watering is enabled for that day
-// Schedule: hour and minute for daily run
-int schedule_hour = 8;
-int schedule_minute = 0;
+// Schedule: run times, each on its own weekdays, and how late a missed run may still start
+ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS];
+unsigned long schedule_catchup_s = SCHEDULE_MAX_LATE_S;
 
 float pump_calibration[NUM_FERTILIZERS] = {1, 1, 1, 1, 1}; // ml/sec for fertilizer pumps only
+float pump_curve[NUM_FERTILIZERS][CAL_CURVE_POINTS]; // ml/sec at each calibration duty (0 = not calibrated)
+unsigned long pump_spinup_ms[NUM_FERTILIZERS]; // Spin-up correction added to each dose
 int fertilizer_motor_speed = 200; // Default motor speed for fertilizer pumps
 unsigned long watering_duration_ms = MAX_WATERING_TIME_MS; // Configurable watering duration
+float watering_target_ml = 0; // Volume-based watering target (0 = time-based)
+// Sequence mode: pipelined starts the tank fill while dosing is still running
+bool sequence_pipelined = false;
+unsigned long fill_offset_ms = 0; // Delay from dosing start to fill start in pipelined mode
 
 AsyncWebServer server(80);
+AsyncEventSource events("/api/events"); // Pushes status changes to the web UI
 String wifi_ssid = "";
 String wifi_password = "";
 
-static unsigned long fill_start_time = 0;
-
-void init_weekly_dosing() {
-    // Initialize with default values (10ml for each fertilizer, every day enabled)
-    for (int day = 0; day < 7; day++) {
-        weekly_watering_enabled[day] = true; // Enable watering for all days by default
-        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
-            weekly_dosing_ml[day][fert] = 1.0;
-        }
-    }
-}
-
-void load_settings() {
-    preferences.begin("irrigation", false); // Open in read-write mode
-    
-    // Initialize with defaults first
-    init_weekly_dosing();
-    
-    // Load weekly dosing schedule
-    for (int day = 0; day < 7; day++) {
-        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
-            String key = "dose_" + String(day) + "_" + String(fert);
-            weekly_dosing_ml[day][fert] = preferences.getFloat(key.c_str(), 1.0);
-        }
-        String enabled_key = "water_" + String(day);
-        weekly_watering_enabled[day] = preferences.getBool(enabled_key.c_str(), true);
-    }
-    
-    // Load other settings
-    schedule_hour = preferences.getInt("sched_hour", 8);
-    schedule_minute = preferences.getInt("sched_min", 0);
-    
-    for (int i = 0; i < NUM_FERTILIZERS; i++) {
-        String cal_key = "cal_" + String(i);
-        pump_calibration[i] = preferences.getFloat(cal_key.c_str(), 1.0);
-    }
-    
-    fertilizer_motor_speed = preferences.getInt("fert_speed", 200);
-    watering_duration_ms = preferences.getULong("water_dur", MAX_WATERING_TIME_MS);
-    
-    preferences.end();
-    logger_log("Settings loaded from NVS");
-}
-
-void save_settings() {
-    preferences.begin("irrigation", false); // Open in read-write mode
-    
-    // Save weekly dosing schedule
-    for (int day = 0; day < 7; day++) {
-        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
-            String key = "dose_" + String(day) + "_" + String(fert);
-            preferences.putFloat(key.c_str(), weekly_dosing_ml[day][fert]);
-        }
-        String enabled_key = "water_" + String(day);
-        preferences.putBool(enabled_key.c_str(), weekly_watering_enabled[day]);
-    }
-    
-    // Save other settings
-    preferences.putInt("sched_hour", schedule_hour);
-    preferences.putInt("sched_min", schedule_minute);
-    
-    for (int i = 0; i < NUM_FERTILIZERS; i++) {
-        String cal_key = "cal_" + String(i);
-        preferences.putFloat(cal_key.c_str(), pump_calibration[i]);
-    }
-    
-    preferences.putInt("fert_speed", fertilizer_motor_speed);
-    preferences.putULong("water_dur", watering_duration_ms);
-    
-    preferences.end();
-    logger_log("Settings saved to NVS");
-}
-
 bool load_wifi_credentials() {
     File f = filesystem.open("/wifi.json", "r");
     if (!f) return false;
@@ -129,6 +78,10 @@ void trigger_dosing();
 
 // This is the function that scheduler should call
 void trigger_dosing() {
+    if (batch_runner_is_running()) {
+        // The schedule takes precedence over maintenance programs
+        batch_runner_abort("Scheduled watering");
+    }
     start_watering_sequence();
 }
 
@@ -152,6 +105,7 @@ void start_ap_mode() {
             serializeJson(doc, f);
             f.close();
             request->send(200, "text/html", "Saved. Rebooting...");
+            settings_flush();
             delay(1000);
             ESP.restart();
         } else {
@@ -162,218 +116,545 @@ void start_ap_mode() {
 }
 
 // Status variables
-static bool filling = false;
 extern bool humidifier_pump_active;
 extern bool watering_pump_active;
-static bool ntp_synced = false;
-
-// Watering sequence state machine
-enum WateringState {
-    IDLE,
-    DOSING,
-    FILLING,
-    FILLED,
-    WATERING
-};
-static WateringState watering_state = IDLE;
-
-void start_watering_sequence() {
-    if (watering_state == IDLE) {
-        if (start_fertilizer_dosing()) {
-            watering_state = DOSING;
-            logger_log("State: IDLE -> DOSING");
-            logger_flush(); // Ensure sequence start is written
-        } else {
-            logger_log("Watering sequence aborted - not enabled for today");
-            logger_flush(); // Ensure abort message is written
-            // State remains IDLE
+
+// No actuator running or pending, so a new trace file can start here
+static bool control_is_idle() {
+    return watering_sequence_get_state() == IDLE && !watering_sequence_is_filling() &&
+           !valve_control_is_open() && !pump_control_is_dosing() && !pump_calibration_is_running() &&
+           !batch_runner_is_running() && !watering_pump_active && !humidifier_pump_active;
+}
+
+// Version of the published state snapshot; keys the /api/status cache
+static volatile uint32_t state_version = 0;
+static StateSnapshot last_pushed_state; // Last state sent to event stream clients
+static unsigned long last_heartbeat_ms = 0;
+
+// Serve a GET endpoint from the response cache; answers 304 when the client's copy is current
+static void send_cached_json(AsyncWebServerRequest *request, ResponseCacheSlot slot, uint64_t version, ResponseBuilder builder) {
+    CachedResponse cached;
+    if (!response_cache_get(slot, version, builder, cached)) {
+        request->send(500, "text/plain", "Out of memory");
+        return;
+    }
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") &&
+        response_cache_etag_matches(request->header("If-None-Match").c_str(), cached.etag)) {
+        response = request->beginResponse(304);
+    } else {
+        response = request->beginResponse(200, "application/json", String(cached.body));
+    }
+    response->addHeader("ETag", cached.etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+static size_t build_config_json(char *buf, size_t size) {
+    SettingsBlob blob;
+    settings_capture(blob);
+    DynamicJsonDocument doc(CONFIG_JSON_SIZE);
+    JsonObject root = doc.to<JsonObject>();
+    config_to_json(blob, root);
+    root["flow_meter"] = flow_meter_is_available(); // Read-only, ignored on POST
+    serializeJson(doc, buf, size);
+    return measureJson(doc);
+}
+
+static void capture_state(StateSnapshot &snap) {
+    memset(&snap, 0, sizeof(snap)); // Padding takes part in change detection
+    snap.watering_state = watering_sequence_get_state();
+    snap.dosing_stage = pump_control_get_dosing_stage();
+    snap.tank_full = sensors_get_liquid_level();
+    snap.filling = watering_sequence_is_filling();
+    snap.valve_open = valve_control_is_open();
+    snap.ntp_synced = time_sync_get_state() == TIME_SYNCED;
+    snap.time_state = time_sync_get_state();
+    snap.time_synced_epoch = time_sync_get_last_sync();
+    snap.clock_drift_ppm = time_sync_get_drift_ppm();
+    snap.next_run_epoch = (uint32_t)scheduler_get_next_run();
+    snap.humidifier_pump = humidifier_pump_active;
+    snap.watering_pump = watering_pump_active;
+    for (int ch = 0; ch < SNAPSHOT_CHANNELS; ch++) {
+        snap.pump_speed[ch] = get_motor_speed(ch + 1);
+    }
+    snap.dosing_end_ms = pump_control_get_dosing_end_ms();
+    snap.humidifier_end_ms = pump_control_get_humidifier_end_ms();
+    snap.watering_end_ms = pump_control_get_watering_end_ms();
+    if (snap.filling) {
+        snap.fill_start_ms = watering_sequence_get_fill_start_ms();
+        snap.fill_timeout_ms = watering_sequence_get_fill_timeout_ms();
+    }
+    snap.watering_duration_ms = watering_duration_ms;
+    snap.watering_volume_ml = pump_control_get_watering_volume_ml();
+    snap.sensor_edges = sensors_get_raw_edge_count();
+    snap.sensor_glitches = sensors_get_glitch_count();
+    snap.valve_close_latency_us = sensors_get_valve_close_latency_us();
+}
+
+// Publish the state snapshot; when it changed, bump the state version and send
+// the changed fields to event stream clients. A full status goes out every
+// SSE_HEARTBEAT_MS so the clock and counters stay fresh.
+static void publish_status_changes() {
+    StateSnapshot snap;
+    capture_state(snap);
+
+    if (state_snapshot_publish(snap)) {
+        state_snapshot_read(snap); // Picks up the assigned version
+        StaticJsonDocument<512> delta;
+        JsonObject fields = delta.to<JsonObject>();
+        const StateSnapshot &prev = last_pushed_state;
+        if (snap.tank_full != prev.tank_full) delta["tank_full"] = snap.tank_full;
+        if (snap.filling != prev.filling) delta["filling"] = snap.filling;
+        if (snap.valve_open != prev.valve_open) delta["valve_open"] = snap.valve_open;
+        if (snap.humidifier_pump != prev.humidifier_pump) delta["humidifier_pump"] = snap.humidifier_pump;
+        if (snap.watering_pump != prev.watering_pump) delta["watering_pump"] = snap.watering_pump;
+        if (snap.ntp_synced != prev.ntp_synced) delta["ntp_synced"] = snap.ntp_synced;
+        if (snap.time_state != prev.time_state) delta["time_state"] = time_sync_state_name((TimeSyncState)snap.time_state);
+        if (snap.clock_drift_ppm != prev.clock_drift_ppm) delta["clock_drift_ppm"] = snap.clock_drift_ppm;
+        if (snap.time_synced_epoch != prev.time_synced_epoch || snap.next_run_epoch != prev.next_run_epoch) {
+            web_json_time_fields(snap, time(nullptr), fields);
+        }
+        if (snap.watering_state != prev.watering_state) {
+            delta["watering_state"] = watering_state_name((WateringState)snap.watering_state);
+        }
+        if (snap.dosing_stage != prev.dosing_stage) delta["dosing_stage"] = snap.dosing_stage;
+        if (memcmp(snap.pump_speed, prev.pump_speed, sizeof(snap.pump_speed)) != 0) {
+            JsonArray pump_speed = delta.createNestedArray("pump_speed");
+            for (int ch = 0; ch < SNAPSHOT_CHANNELS; ch++) {
+                pump_speed.add(snap.pump_speed[ch]);
+            }
+        }
+        if (snap.watering_duration_ms != prev.watering_duration_ms) delta["watering_duration_ms"] = snap.watering_duration_ms;
+        last_pushed_state = snap;
+        state_version = snap.version;
+
+        if (events.count() > 0 && delta.size() > 0) {
+            char buf[512];
+            serializeJson(delta, buf, sizeof(buf));
+            events.send(buf, "delta", state_version);
         }
     }
+
+    unsigned long now = millis();
+    if (now - last_heartbeat_ms >= SSE_HEARTBEAT_MS) {
+        last_heartbeat_ms = now;
+        if (events.count() > 0) {
+            char buf[1024];
+            web_json_status(buf, sizeof(buf));
+            events.send(buf, "status", state_version);
+        }
+    }
+}
+
+// Cache key for settings endpoints
+static uint64_t settings_cache_version() {
+    return settings_get_version();
+}
+
+// Status changes with state and with the clock (one-second resolution)
+static uint64_t status_cache_version() {
+    return ((uint64_t)(state_version + settings_get_version()) << 32) | (uint32_t)time(nullptr);
+}
+
+static void send_job_accepted(AsyncWebServerRequest *request, uint32_t job_id) {
+    if (job_id == 0) {
+        request->send(503, "text/plain", "Command queue full, try again");
+        return;
+    }
+    AsyncWebServerResponse *response = request->beginResponse(202, "application/json",
+        "{\"job_id\":" + String(job_id) + "}");
+    response->addHeader("Location", "/api/jobs/" + String(job_id));
+    request->send(response);
+}
+
+// Queue a command for the control loop and answer 202 with its job ID
+static void submit_command(AsyncWebServerRequest *request, CommandType type,
+                           int32_t a0 = 0, int32_t a1 = 0, int32_t a2 = 0, float value = 0) {
+    send_job_accepted(request, command_queue_submit(type, a0, a1, a2, value));
+}
+
+// Queue a settings change. Handlers only fill in the submitted values; the
+// live settings are read and merged by the control loop.
+static void submit_settings(AsyncWebServerRequest *request, const SettingsPatch &patch) {
+    SettingsPatch *payload = new SettingsPatch(patch);
+    uint32_t job_id = command_queue_submit(CMD_APPLY_SETTINGS, 0, 0, 0, 0, payload);
+    if (job_id == 0) delete payload;
+    send_job_accepted(request, job_id);
+}
+
+// Whole number POST parameter within min..max; false for anything else, "abc" or "8.5" included
+static bool int_param(AsyncWebServerRequest *request, const char *name, long min, long max, long &out) {
+    const String &text = request->getParam(name, true)->value();
+    char *end;
+    out = strtol(text.c_str(), &end, 10);
+    return text.length() > 0 && *end == '\0' && out >= min && out <= max;
+}
+
+static const char *method_name(WebRequestMethodComposite method) {
+    switch (method) {
+        case HTTP_GET: return "GET";
+        case HTTP_POST: return "POST";
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_PUT: return "PUT";
+        case HTTP_PATCH: return "PATCH";
+        default: return "ANY";
+    }
+}
+
+// Register a route; its handler time goes into the route's histogram on /api/metrics
+static void on_route(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction handler) {
+    int route = metrics_http_route(method_name(method), uri);
+    server.on(uri, method, [route, handler](AsyncWebServerRequest *request) {
+        unsigned long start = micros();
+        handler(request);
+        metrics_http_observe(route, micros() - start);
+    });
+}
+
+// Same for a route with a JSON body (the time starts once the body is parsed)
+static void on_json_route(const char *uri, WebRequestMethodComposite method, ArJsonRequestHandlerFunction handler,
+                          size_t json_size) {
+    int route = metrics_http_route(method_name(method), uri);
+    AsyncCallbackJsonWebHandler *json_handler = new AsyncCallbackJsonWebHandler(uri,
+        [route, handler](AsyncWebServerRequest *request, JsonVariant &json) {
+            unsigned long start = micros();
+            handler(request, json);
+            metrics_http_observe(route, micros() - start);
+        }, json_size);
+    json_handler->setMethod(method);
+    server.addHandler(json_handler);
 }
 
 void setup_routes() {
+    // Event stream: a full status on connect, then deltas and heartbeats from loop()
+    events.onConnect([](AsyncEventSourceClient *client){
+        char buf[1024];
+        web_json_status(buf, sizeof(buf));
+        client->send(buf, "status", state_version, SSE_RECONNECT_MS);
+    });
+    server.addHandler(&events);
+
+    // Manual pump control WebSocket (binary protocol, see manual_control.h)
+    manual_control_init(server);
+    on_route("/api/manual_control", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", manual_control_get_stats_json());
+    });
+
     // REST API: Trigger watering sequence
-    server.on("/api/start_watering", HTTP_POST, [](AsyncWebServerRequest *request){
-        if (watering_state != IDLE) {
-            request->send(409, "text/plain", "Sequence already running");
-            return;
-        }
-        start_watering_sequence();
-        request->send(200, "text/plain", "Watering sequence started");
+    on_route("/api/start_watering", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_START_WATERING);
     });
 
-    // REST API: Get weekly dosing
-    server.on("/api/weekly_dosing", HTTP_GET, [](AsyncWebServerRequest *request){
-        String json = "[";
-        for (int day = 0; day < 7; day++) {
-            json += "[";
-            for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
-                json += String(weekly_dosing_ml[day][fert]);
-                if (fert < NUM_FERTILIZERS-1) json += ",";
+    // REST API: Whole configuration as one document (also used for backup)
+    on_route("/api/config", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_CONFIG, settings_cache_version(), build_config_json);
+    });
+    
+    // REST API: Partial or full configuration update (also used for restore).
+    // Everything is validated into a patch first, then applied in one step by
+    // the control loop and persisted with a single commit.
+    on_json_route("/api/config", HTTP_POST,
+        [](AsyncWebServerRequest *request, JsonVariant &json) {
+            if (!json.is<JsonObject>()) {
+                request->send(400, "text/plain", "Expected a JSON object");
+                return;
             }
-            json += "]";
-            if (day < 6) json += ",";
-        }
-        json += "]";
-        request->send(200, "application/json", json);
+            SettingsPatch patch;
+            settings_patch_init(patch);
+            String error;
+            if (!config_from_json(json.as<JsonObjectConst>(), patch, error)) {
+                request->send(400, "text/plain", error);
+                return;
+            }
+            submit_settings(request, patch);
+        }, CONFIG_JSON_SIZE);
+    
+    // REST API: Get weekly dosing
+    on_route("/api/weekly_dosing", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_WEEKLY_DOSING, settings_cache_version(), api_json_weekly_dosing);
     });
     
     // REST API: Set weekly dosing
-    server.on("/api/weekly_dosing", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/weekly_dosing", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
         for (int day = 0; day < 7; day++) {
             for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
                 String param_name = "day" + String(day) + "_fert" + String(fert);
                 if (request->hasParam(param_name, true)) {
-                    weekly_dosing_ml[day][fert] = request->getParam(param_name, true)->value().toFloat();
+                    settings_patch_set(patch, patch.values.weekly_dosing_ml[day][fert],
+                                       request->getParam(param_name, true)->value().toFloat(), SETTING_WEEKLY_DOSING);
                 }
             }
         }
-        save_settings();
-        request->send(200, "text/plain", "Weekly dosing saved");
+        submit_settings(request, patch);
     });
     
     // REST API: Get weekly watering enabled
-    server.on("/api/weekly_watering_enabled", HTTP_GET, [](AsyncWebServerRequest *request){
-        String json = "[";
-        for (int day = 0; day < 7; day++) {
-            json += weekly_watering_enabled[day] ? "true" : "false";
-            if (day < 6) json += ",";
-        }
-        json += "]";
-        request->send(200, "application/json", json);
+    on_route("/api/weekly_watering_enabled", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_WEEKLY_WATERING, settings_cache_version(), api_json_weekly_watering_enabled);
     });
     
     // REST API: Set weekly watering enabled
-    server.on("/api/weekly_watering_enabled", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/weekly_watering_enabled", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
         for (int day = 0; day < 7; day++) {
             String param_name = "day" + String(day) + "_enabled";
             if (request->hasParam(param_name, true)) {
                 String value = request->getParam(param_name, true)->value();
-                weekly_watering_enabled[day] = (value == "true" || value == "1");
+                settings_patch_set(patch, patch.values.weekly_watering_enabled[day], (value == "true" || value == "1") ? 1 : 0,
+                                   SETTING_WATERING_DAYS);
             }
         }
-        save_settings();
-        request->send(200, "text/plain", "Weekly watering schedule saved");
+        submit_settings(request, patch);
     });
     
     // REST API: Get schedule
-    server.on("/api/schedule", HTTP_GET, [](AsyncWebServerRequest *request){
-        String json = "{";
-        json += "\"hour\":" + String(schedule_hour) + ",";
-        json += "\"minute\":" + String(schedule_minute) + "}";
-        request->send(200, "application/json", json);
+    on_route("/api/schedule", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_SCHEDULE, settings_cache_version(), api_json_schedule);
     });
     
-    // REST API: Set schedule
-    server.on("/api/schedule", HTTP_POST, [](AsyncWebServerRequest *request){
-        if (request->hasParam("hour", true)) schedule_hour = request->getParam("hour", true)->value().toInt();
-        if (request->hasParam("minute", true)) schedule_minute = request->getParam("minute", true)->value().toInt();
-        save_settings();
-        request->send(200, "text/plain", "OK");
+    // REST API: Set schedule. slots replaces the slot table (see scheduler_parse_slots);
+    // hour and minute only change the first slot.
+    on_route("/api/schedule", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
+        if (request->hasParam("slots", true)) {
+            if (!scheduler_parse_slots(request->getParam("slots", true)->value().c_str(), patch.values.schedule_slots)) {
+                request->send(400, "text/plain", "slots must be HH:MM or HH:MM/0111110 (Sunday first), comma separated, "
+                                                 "at most " + String(SCHEDULE_MAX_SLOTS));
+                return;
+            }
+            settings_patch_mark(patch, patch.values.schedule_slots, sizeof(patch.values.schedule_slots), SETTING_SCHEDULE);
+        }
+        long value;
+        if (request->hasParam("hour", true)) {
+            if (!int_param(request, "hour", 0, 23, value)) {
+                request->send(400, "text/plain", "hour must be 0-23");
+                return;
+            }
+            settings_patch_slot_time(patch, 0, value, -1);
+        }
+        if (request->hasParam("minute", true)) {
+            if (!int_param(request, "minute", 0, 59, value)) {
+                request->send(400, "text/plain", "minute must be 0-59");
+                return;
+            }
+            settings_patch_slot_time(patch, 0, -1, value);
+        }
+        if (request->hasParam("catchup_s", true)) {
+            if (!int_param(request, "catchup_s", 0, SCHEDULE_MAX_CATCHUP_S, value)) {
+                request->send(400, "text/plain", "catchup_s must be 0-" + String(SCHEDULE_MAX_CATCHUP_S));
+                return;
+            }
+            settings_patch_set(patch, patch.values.schedule_catchup_s, value, SETTING_SCHEDULE);
+        }
+        submit_settings(request, patch);
     });
     
     // REST API: Fill main tank
-    server.on("/api/fill_main_tank", HTTP_POST, [](AsyncWebServerRequest *request){
-        valve_control_fill_main_tank();
-        filling = true;
-        request->send(200, "text/plain", "Filling main tank");
+    on_route("/api/fill_main_tank", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_FILL_MAIN_TANK);
     });
     
     // REST API: Stop main tank
-    server.on("/api/stop_main_tank", HTTP_POST, [](AsyncWebServerRequest *request){
-        valve_control_stop_main_tank();
-        filling = false;
-        request->send(200, "text/plain", "Stopped main tank");
+    on_route("/api/stop_main_tank", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_STOP_MAIN_TANK);
     });
     
     // REST API: Run humidifier pump
-    server.on("/api/run_humidifier_pump", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/run_humidifier_pump", HTTP_POST, [](AsyncWebServerRequest *request){
         unsigned long ms = 5000;
         if (request->hasParam("ms", true)) ms = request->getParam("ms", true)->value().toInt();
-        pump_control_run_humidifier_pump(ms);
-        request->send(200, "text/plain", "Humidifier pump running");
+        submit_command(request, CMD_RUN_HUMIDIFIER, ms);
     });
     
     // REST API: Stop humidifier pump
-    server.on("/api/stop_humidifier_pump", HTTP_POST, [](AsyncWebServerRequest *request){
-        pump_control_stop_humidifier_pump();
-        request->send(200, "text/plain", "Humidifier pump stopped");
+    on_route("/api/stop_humidifier_pump", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_STOP_HUMIDIFIER);
     });
     
     // REST API: Run watering pump
-    server.on("/api/run_watering_pump", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/run_watering_pump", HTTP_POST, [](AsyncWebServerRequest *request){
         unsigned long ms = watering_duration_ms;
         if (request->hasParam("ms", true)) ms = request->getParam("ms", true)->value().toInt();
-        pump_control_run_watering_pump(ms);
-        request->send(200, "text/plain", "Watering pump running");
+        submit_command(request, CMD_RUN_WATERING_PUMP, ms);
     });
     
     // REST API: Stop watering pump
-    server.on("/api/stop_watering_pump", HTTP_POST, [](AsyncWebServerRequest *request){
-        pump_control_stop_watering_pump();
-        request->send(200, "text/plain", "Watering pump stopped");
+    on_route("/api/stop_watering_pump", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_STOP_WATERING_PUMP);
     });
     
     // REST API: Get calibration (fertilizer pumps only)
-    server.on("/api/calibration", HTTP_GET, [](AsyncWebServerRequest *request){
-        String json = "[";
-        for (int i = 0; i < NUM_FERTILIZERS; i++) {
-            json += String(pump_calibration[i]);
-            if (i < NUM_FERTILIZERS-1) json += ",";
-        }
-        json += "]";
-        request->send(200, "application/json", json);
+    on_route("/api/calibration", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_CALIBRATION, settings_cache_version(), api_json_calibration);
     });
     
     // REST API: Set calibration (fertilizer pumps only)
-    server.on("/api/calibration", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/calibration", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
         for (int i = 0; i < NUM_FERTILIZERS; i++) {
             if (request->hasParam(String("cal")+i, true)) {
-                pump_calibration[i] = request->getParam(String("cal")+i, true)->value().toFloat();
+                settings_patch_set(patch, patch.values.pump_calibration[i],
+                                   request->getParam(String("cal")+i, true)->value().toFloat(), SETTING_CALIBRATION);
             }
         }
-        save_settings();
-        request->send(200, "text/plain", "Calibration saved");
+        submit_settings(request, patch);
+    });
+    
+    // REST API: Get speed-dependent calibration curves and the guided calibration session
+    on_route("/api/calibration_curve", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", pump_calibration_get_json());
+    });
+    
+    // REST API: Run one calibration point (pump, point)
+    on_route("/api/calibration_curve/run", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (!request->hasParam("pump", true) || !request->hasParam("point", true)) {
+            request->send(400, "text/plain", "Missing pump or point parameter");
+            return;
+        }
+        int pump = request->getParam("pump", true)->value().toInt();
+        int point = request->getParam("point", true)->value().toInt();
+        submit_command(request, CMD_CAL_RUN, pump, point);
+    });
+    
+    // REST API: Submit the measured volume of a calibration point (pump, point, ml)
+    on_route("/api/calibration_curve/measure", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (!request->hasParam("pump", true) || !request->hasParam("point", true) || !request->hasParam("ml", true)) {
+            request->send(400, "text/plain", "Missing pump, point or ml parameter");
+            return;
+        }
+        int pump = request->getParam("pump", true)->value().toInt();
+        int point = request->getParam("point", true)->value().toInt();
+        float ml = request->getParam("ml", true)->value().toFloat();
+        submit_command(request, CMD_CAL_MEASURE, pump, point, 0, ml);
+    });
+    
+    // REST API: Compute and save the curve once all points are measured (pump)
+    on_route("/api/calibration_curve/finish", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (!request->hasParam("pump", true)) {
+            request->send(400, "text/plain", "Missing pump parameter");
+            return;
+        }
+        int pump = request->getParam("pump", true)->value().toInt();
+        submit_command(request, CMD_CAL_FINISH, pump);
+    });
+    
+    // REST API: Abort the calibration session
+    on_route("/api/calibration_curve/cancel", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_CAL_CANCEL);
     });
     
     // REST API: Get fertilizer motor speed
-    server.on("/api/fertilizer_motor_speed", HTTP_GET, [](AsyncWebServerRequest *request){
-        String json = "{\"fertilizer_motor_speed\":" + String(fertilizer_motor_speed) + "}";
-        request->send(200, "application/json", json);
+    on_route("/api/fertilizer_motor_speed", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_MOTOR_SPEED, settings_cache_version(), api_json_motor_speed);
     });
     
     // REST API: Set fertilizer motor speed
-    server.on("/api/fertilizer_motor_speed", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/fertilizer_motor_speed", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
         if (request->hasParam("fertilizer_motor_speed", true)) {
-            fertilizer_motor_speed = request->getParam("fertilizer_motor_speed", true)->value().toInt();
+            long speed = request->getParam("fertilizer_motor_speed", true)->value().toInt();
             // Clamp the value to a reasonable range
-            if (fertilizer_motor_speed < 1) fertilizer_motor_speed = 1;
-            if (fertilizer_motor_speed > 255) fertilizer_motor_speed = 255;
+            if (speed < 1) speed = 1;
+            if (speed > 255) speed = 255;
+            settings_patch_set(patch, patch.values.fertilizer_motor_speed, speed, SETTING_MOTOR_SPEED);
         }
-        save_settings();
-        request->send(200, "text/plain", "Fertilizer motor speed saved");
+        submit_settings(request, patch);
     });
     
     // REST API: Get watering duration
-    server.on("/api/watering_duration", HTTP_GET, [](AsyncWebServerRequest *request){
-        String json = "{\"watering_duration_ms\":" + String(watering_duration_ms) + "}";
-        request->send(200, "application/json", json);
+    on_route("/api/watering_duration", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_WATERING_DURATION, settings_cache_version(), api_json_watering_duration);
     });
     
     // REST API: Set watering duration
-    server.on("/api/watering_duration", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/watering_duration", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
         if (request->hasParam("watering_duration_ms", true)) {
-            watering_duration_ms = request->getParam("watering_duration_ms", true)->value().toInt();
+            long duration = request->getParam("watering_duration_ms", true)->value().toInt();
             // Clamp the value to a reasonable range (1 second to 30 minutes)
-            if (watering_duration_ms < 1000) watering_duration_ms = 1000;
-            if (watering_duration_ms > 1800000) watering_duration_ms = 1800000;
+            if (duration < 1000) duration = 1000;
+            if (duration > 1800000) duration = 1800000;
+            settings_patch_set(patch, patch.values.watering_duration_ms, duration, SETTING_WATERING_DURATION);
+        }
+        submit_settings(request, patch);
+    });
+    
+    // REST API: Get watering volume target
+    on_route("/api/watering_volume", HTTP_GET, [](AsyncWebServerRequest *request){
+        String json = "{\"watering_target_ml\":" + String(watering_target_ml) +
+                      ",\"flow_meter\":" + String(flow_meter_is_available() ? "true" : "false") + "}";
+        request->send(200, "application/json", json);
+    });
+    
+    // REST API: Set watering volume target (0 = time-based watering)
+    on_route("/api/watering_volume", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
+        if (request->hasParam("watering_target_ml", true)) {
+            float target = request->getParam("watering_target_ml", true)->value().toFloat();
+            // Clamp the value to a reasonable range (0 to 100 litres)
+            if (target < 0) target = 0;
+            if (target > MAX_WATERING_VOLUME_ML) target = MAX_WATERING_VOLUME_ML;
+            settings_patch_set(patch, patch.values.watering_target_ml, target, SETTING_WATERING_VOLUME);
+        }
+        submit_settings(request, patch);
+    });
+    
+    // REST API: Recent watering runs with delivered volume
+    on_route("/api/watering_runs", HTTP_GET, [](AsyncWebServerRequest *request){
+        WateringRun runs[WATERING_RUN_HISTORY];
+        int n = pump_control_get_watering_runs(runs, WATERING_RUN_HISTORY);
+        DynamicJsonDocument doc(256 + n * 160);
+        JsonArray arr = doc.to<JsonArray>();
+        for (int i = 0; i < n; i++) {
+            JsonObject run = arr.createNestedObject();
+            run["start_time"] = (unsigned long)runs[i].start_time;
+            run["duration_ms"] = runs[i].duration_ms;
+            run["volume_ml"] = runs[i].volume_ml;
+            run["target_ml"] = runs[i].target_ml;
+            run["result"] = watering_run_result_name(runs[i].result);
+        }
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    // REST API: Get sequence mode
+    on_route("/api/sequence_mode", HTTP_GET, [](AsyncWebServerRequest *request){
+        String json = "{\"pipelined\":" + String(sequence_pipelined ? "true" : "false") +
+                      ",\"fill_offset_ms\":" + String(fill_offset_ms) + "}";
+        request->send(200, "application/json", json);
+    });
+    
+    // REST API: Set sequence mode
+    on_route("/api/sequence_mode", HTTP_POST, [](AsyncWebServerRequest *request){
+        SettingsPatch patch;
+        settings_patch_init(patch);
+        if (request->hasParam("pipelined", true)) {
+            String value = request->getParam("pipelined", true)->value();
+            settings_patch_set(patch, patch.values.sequence_pipelined, (value == "true" || value == "1") ? 1 : 0,
+                               SETTING_SEQUENCE_MODE);
+        }
+        if (request->hasParam("fill_offset_ms", true)) {
+            long offset = request->getParam("fill_offset_ms", true)->value().toInt();
+            // Clamp the value to a reasonable range (0 to 10 minutes)
+            if (offset < 0) offset = 0;
+            if (offset > MAX_FILL_OFFSET_MS) offset = MAX_FILL_OFFSET_MS;
+            settings_patch_set(patch, patch.values.fill_offset_ms, offset, SETTING_SEQUENCE_MODE);
         }
-        save_settings();
-        request->send(200, "text/plain", "Watering duration saved");
+        submit_settings(request, patch);
     });
     
     // REST API: Debug pump control
-    server.on("/api/debug_pump", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/debug_pump", HTTP_POST, [](AsyncWebServerRequest *request){
         if (!request->hasParam("pump", true) || !request->hasParam("action", true)) {
             request->send(400, "text/plain", "Missing pump or action parameter");
             return;
@@ -381,102 +662,125 @@ void setup_routes() {
         
         int pump = request->getParam("pump", true)->value().toInt();
         String action = request->getParam("action", true)->value();
-        
-        if (action == "on") {
-            int speed = 200; // Default speed
-            if (request->hasParam("speed", true)) {
-                speed = request->getParam("speed", true)->value().toInt();
-            }
-            
-            if (pump >= 0 && pump <= 4) {
-                // Fertilizer pumps (0-4 map to motors 1-5)
-                int motor_num = pump + 1;
-                set_motor_speed(motor_num, speed);
-                run_motor_forward(motor_num);
-                request->send(200, "text/plain", "Fertilizer pump " + String(pump) + " turned on");
-            } else if (pump == 5) {
-                // Watering pump
-                pump_control_run_watering_pump(60000);
-                filling = true;
-                request->send(200, "text/plain", "Watering pump turned on");
-            } else if (pump == 6) {
-                // Humidifier pump
-                pump_control_run_humidifier_pump(60000);
-                request->send(200, "text/plain", "Humidifier pump turned on");
-            } else {
-                request->send(400, "text/plain", "Invalid pump number");
-            }
-        } else if (action == "off") {
-            if (pump >= 0 && pump <= 4) {
-                // Fertilizer pumps (0-4 map to motors 1-5)
-                int motor_num = pump + 1;
-                stop_motor(motor_num);
-                request->send(200, "text/plain", "Fertilizer pump " + String(pump) + " turned off");
-            } else if (pump == 5) {
-                // Watering pump
-                pump_control_stop_watering_pump();
-                filling = false;
-                request->send(200, "text/plain", "Watering pump turned off");
-            } else if (pump == 6) {
-                // Humidifier pump
-                pump_control_stop_humidifier_pump();
-                request->send(200, "text/plain", "Humidifier pump turned off");
-            } else {
-                request->send(400, "text/plain", "Invalid pump number");
-            }
-        } else {
+        if (pump < 0 || pump > 6) {
+            request->send(400, "text/plain", "Invalid pump number");
+            return;
+        }
+        if (action != "on" && action != "off") {
             request->send(400, "text/plain", "Invalid action. Use 'on' or 'off'");
+            return;
+        }
+        int speed = 200; // Default speed
+        if (request->hasParam("speed", true)) {
+            speed = request->getParam("speed", true)->value().toInt();
         }
+        submit_command(request, CMD_DEBUG_PUMP, pump, action == "on" ? 1 : 0, speed);
     });
     
     // REST API: Stop all pumps
-    server.on("/api/stop_all_pumps", HTTP_POST, [](AsyncWebServerRequest *request){
-        // Stop all fertilizer pumps (motors 1-5)
-        for (int i = 1; i <= 5; i++) {
-            stop_motor(i);
+    on_route("/api/stop_all_pumps", HTTP_POST, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_STOP_ALL);
+    });
+    
+    // REST API: Run a timed program of pump and wait steps (see batch_runner.h).
+    // The whole list is validated before the program is queued.
+    on_json_route("/api/batch", HTTP_POST,
+        [](AsyncWebServerRequest *request, JsonVariant &json) {
+            if (!json.is<JsonObject>()) {
+                request->send(400, "text/plain", "Expected a JSON object");
+                return;
+            }
+            BatchProgram *batch = new BatchProgram;
+            String error;
+            if (!batch_parse(json.as<JsonObjectConst>(), *batch, error)) {
+                delete batch;
+                request->send(400, "text/plain", error);
+                return;
+            }
+            uint32_t job_id = command_queue_submit(CMD_RUN_BATCH, 0, 0, 0, 0, batch);
+            if (job_id == 0) delete batch;
+            send_job_accepted(request, job_id);
+        }, BATCH_JSON_SIZE);
+    
+    // REST API: Report of the running or last batch program
+    on_route("/api/batch", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", batch_runner_get_report_json());
+    });
+    
+    // REST API: Abort the running batch program
+    on_route("/api/batch", HTTP_DELETE, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_ABORT_BATCH);
+    });
+    
+    // REST API: Recent commands, or one command by ID (/api/jobs/<id>)
+    on_route("/api/jobs", HTTP_GET, [](AsyncWebServerRequest *request){
+        String url = request->url();
+        if (url == "/api/jobs" || url == "/api/jobs/") {
+            request->send(200, "application/json", command_queue_get_jobs_json());
+            return;
         }
-        // Stop main tank
-        valve_control_stop_main_tank();
-        filling = false;
-        // Stop humidifier pump
-        pump_control_stop_humidifier_pump();
-        // Stop watering pump
-        pump_control_stop_watering_pump();
-        
-        request->send(200, "text/plain", "All pumps stopped");
+        uint32_t job_id = strtoul(url.c_str() + strlen("/api/jobs/"), nullptr, 10);
+        String json;
+        if (!command_queue_get_job_json(job_id, json)) {
+            request->send(404, "text/plain", "Unknown job");
+            return;
+        }
+        request->send(200, "application/json", json);
     });
     
     // REST API: Get status
-    server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
-        StaticJsonDocument<256> doc;
-        doc["tank_full"] = sensors_get_liquid_level();
-        doc["filling"] = filling;
-        doc["humidifier_pump"] = humidifier_pump_active;
-        doc["watering_pump"] = watering_pump_active;
-        doc["watering_duration_ms"] = watering_duration_ms;
-        doc["ota_ready"] = true;
-        
-        // Add watering enabled status for today
-        time_t now = time(nullptr);
-        struct tm timeinfo;
-        int current_day = 0;
-        if (localtime_r(&now, &timeinfo)) {
-            current_day = timeinfo.tm_wday;
-            char buf[64];
-            strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
-            doc["time"] = buf;
-        } else {
-            doc["time"] = "N/A";
+    on_route("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
+        send_cached_json(request, RC_STATUS, status_cache_version(), web_json_status);
+    });
+
+    // REST API: Prometheus metrics (timing histograms, heap, WiFi, NVS, pump runtime)
+    on_route("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (WiFi.status() == WL_CONNECTED) metrics_set_wifi_rssi(WiFi.RSSI());
+        // Counters may gain digits between measuring and rendering
+        size_t size = metrics_build(nullptr, 0) + 256;
+        char *buf = (char *)malloc(size);
+        if (!buf) {
+            request->send(500, "text/plain", "Out of memory");
+            return;
         }
-        doc["watering_today"] = weekly_watering_enabled[current_day];
-        doc["ntp_synced"] = ntp_synced;
-        String response;
-        serializeJson(doc, response);
-        request->send(200, "application/json", response);
+        metrics_build(buf, size);
+        request->send(200, "text/plain; version=0.0.4", buf);
+        free(buf);
+    });
+    
+    // REST API: boot stage timeline
+    on_route("/api/boot", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", boot_timeline_get_json());
+    });
+
+    // REST API: per-stage loop timing over the last passes, and the slow passes
+    on_route("/api/loop_profile", HTTP_GET, [](AsyncWebServerRequest *request){
+        String json = loop_profiler_get_json();
+        if (json.length() == 0) {
+            request->send(503, "text/plain", "Profile unavailable, try again");
+            return;
+        }
+        request->send(200, "application/json", json);
+    });
+
+    // REST API: set the slow pass threshold and/or clear the profile
+    on_route("/api/loop_profile", HTTP_POST, [](AsyncWebServerRequest *request){
+        uint32_t threshold_us = loop_profiler_get_slow_threshold_us();
+        if (request->hasParam("slow_threshold_us", true)) {
+            long value = request->getParam("slow_threshold_us", true)->value().toInt();
+            if (value <= 0) {
+                request->send(400, "text/plain", "slow_threshold_us must be positive");
+                return;
+            }
+            threshold_us = value;
+        }
+        bool reset = request->hasParam("reset", true) && request->getParam("reset", true)->value() == "1";
+        loop_profiler_configure(threshold_us, reset);
+        request->send(200, "text/plain", reset ? "Loop profile cleared" : "Loop profile updated");
     });
     
     // REST API: Get OTA info
-    server.on("/api/ota_info", HTTP_GET, [](AsyncWebServerRequest *request){
+    on_route("/api/ota_info", HTTP_GET, [](AsyncWebServerRequest *request){
         StaticJsonDocument<256> doc;
         doc["hostname"] = "irrigation-system";
         doc["ip"] = WiFi.localIP().toString();
@@ -487,8 +791,50 @@ void setup_routes() {
         request->send(200, "application/json", response);
     });
     
+    // REST API: Learned fill statistics
+    on_route("/api/fill_stats", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", fill_model_get_stats_json());
+    });
+
+    // REST API: Forget learned fill statistics (e.g. after plumbing changes)
+    on_route("/api/fill_stats", HTTP_DELETE, [](AsyncWebServerRequest *request){
+        submit_command(request, CMD_RESET_FILL_MODEL);
+    });
+    
+    // Trace API: download the current (or with ?old=1 the previous) trace file - MUST be before /api/trace
+    on_route("/api/trace/download", HTTP_GET, [](AsyncWebServerRequest *request){
+        const char *path = request->hasParam("old") ? TRACE_FILE_OLD_PATH : TRACE_FILE_PATH;
+        if (!filesystem.exists(path)) {
+            request->send(404, "text/plain", "No trace file");
+            return;
+        }
+        request->send(filesystem, path, "application/octet-stream", true);
+    });
+
+    // Trace API: recording status
+    on_route("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", trace_get_status_json());
+    });
+
+    // Trace API: enable or disable recording (persisted; applied by the control loop)
+    on_route("/api/trace", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (!request->hasParam("enabled", true)) {
+            request->send(400, "text/plain", "Missing parameter: enabled");
+            return;
+        }
+        String value = request->getParam("enabled", true)->value();
+        trace_set_enabled(value == "true" || value == "1");
+        request->send(200, "application/json", trace_get_status_json());
+    });
+
+    // Trace API: delete both trace files
+    on_route("/api/trace", HTTP_DELETE, [](AsyncWebServerRequest *request){
+        trace_clear();
+        request->send(200, "text/plain", "Trace files cleared");
+    });
+
     // Logger API: Test logs (for debugging) - MUST be before /api/logs
-    server.on("/api/logs/test", HTTP_POST, [](AsyncWebServerRequest *request){
+    on_route("/api/logs/test", HTTP_POST, [](AsyncWebServerRequest *request){
         logger_log("Test log entry from API");
         logger_log("System test initiated");
         logger_log("Multiple test entries created");
@@ -496,7 +842,7 @@ void setup_routes() {
     });
     
     // Logger API: Debug file system - MUST be before /api/logs
-    server.on("/api/logs/debug", HTTP_GET, [](AsyncWebServerRequest *request){
+    on_route("/api/logs/debug", HTTP_GET, [](AsyncWebServerRequest *request){
         StaticJsonDocument<512> doc;
         
         // Check if files exist
@@ -530,7 +876,7 @@ void setup_routes() {
     });
     
     // Logger API: Download logs - MUST be before /api/logs
-    server.on("/api/logs/download", HTTP_GET, [](AsyncWebServerRequest *request){
+    on_route("/api/logs/download", HTTP_GET, [](AsyncWebServerRequest *request){
         String logs = logger_get_logs(1000); // Get more logs for download
         if (logs.length() == 0) {
             logs = "No logs available";
@@ -541,7 +887,7 @@ void setup_routes() {
     });
     
     // Logger API: Get log info - MUST be before /api/logs
-    server.on("/api/logs/info", HTTP_GET, [](AsyncWebServerRequest *request){
+    on_route("/api/logs/info", HTTP_GET, [](AsyncWebServerRequest *request){
         StaticJsonDocument<256> doc;
         doc["current_file_size"] = logger_get_file_size();
         doc["queue_count"] = logger_get_queue_count();
@@ -553,69 +899,55 @@ void setup_routes() {
     });
     
     // Logger API: Get logs - MUST be after all specific /api/logs/* routes
-    server.on("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request){
-        String logs = logger_get_logs(100); // Explicitly pass parameter
-        
-        // Parse logs into an array for better readability
-        DynamicJsonDocument doc(logs.length() + 2048); // Extra space for JSON overhead
-        JsonArray logsArray = doc.createNestedArray("logs");
-        
-        if (logs.length() == 0 || logs == "null" || logs == "No log file found" || logs == "Log file is empty") {
-            logsArray.add("No logs available");
-        } else {
-            // Split logs by newline and add each entry to the array
-            int startIdx = 0;
-            int endIdx = 0;
-            while ((endIdx = logs.indexOf('\n', startIdx)) != -1) {
-                String line = logs.substring(startIdx, endIdx);
-                if (line.length() > 0) {
-                    logsArray.add(line);
-                }
-                startIdx = endIdx + 1;
-            }
-            // Add last line if exists
-            if (startIdx < logs.length()) {
-                String line = logs.substring(startIdx);
-                if (line.length() > 0) {
-                    logsArray.add(line);
-                }
-            }
-        }
-        
-        String response;
-        size_t size = serializeJson(doc, response);
-        
-        request->send(200, "application/json", response);
+    on_route("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", web_json_logs(100));
     });
     
     // Logger API: Clear logs
-    server.on("/api/logs", HTTP_DELETE, [](AsyncWebServerRequest *request){
+    on_route("/api/logs", HTTP_DELETE, [](AsyncWebServerRequest *request){
         logger_clear();
         request->send(200, "text/plain", "Logs cleared");
     });
     
     // Serve web page
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(filesystem, "/index.html", "text/html");
+    // Web UI (built by tools/build_web.py): hashed assets never change, so they are
+    // cached for good; the HTML shell is revalidated against its build hash.
+    // The file responses pick up the .gz variants and set Content-Encoding themselves.
+    server.serveStatic("/assets/", filesystem, "/assets/")
+        .setCacheControl("public, max-age=31536000, immutable");
+    static String web_etag;
+    File version_file = filesystem.open("/web_version.txt", "r");
+    if (version_file) {
+        String hash = version_file.readString();
+        hash.trim();
+        web_etag = "\"" + hash + "\"";
+        version_file.close();
+    }
+    on_route("/", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncWebServerResponse *response;
+        if (web_etag.length() && request->hasHeader("If-None-Match") &&
+            response_cache_etag_matches(request->header("If-None-Match").c_str(), web_etag.c_str())) {
+            response = request->beginResponse(304);
+        } else {
+            response = request->beginResponse(filesystem, "/index.html", "text/html");
+        }
+        response->addHeader("Cache-Control", "no-cache");
+        if (web_etag.length()) response->addHeader("ETag", web_etag);
+        request->send(response);
     });
 }
 
+// FAST_START 0: wait for the first sync. SNTP was started by time_sync_init().
 void sync_ntp() {
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
     logger_log("Waiting for NTP sync...");
-    time_t now = 0;
-    int retries = 0;
-    while (now < 8 * 3600 * 2 && retries < 30) {
+    time_sync_network_up();
+    unsigned long start = millis();
+    while (time_sync_get_state() != TIME_SYNCED && millis() - start < NTP_SYNC_TIMEOUT_MS) {
         delay(500);
-        now = time(nullptr);
-        retries++;
+        time_sync_process();
     }
-    if (now < 8 * 3600 * 2) {
-        logger_log("NTP sync failed");
-        ntp_synced = false;
-    } else {
-        logger_log("NTP sync successful");
-        ntp_synced = true;
+    if (time_sync_get_state() != TIME_SYNCED) {
+        logger_log("NTP sync failed - still trying in the background");
     }
 }
 
@@ -634,6 +966,8 @@ void setup_ota() {
             type = "filesystem";
         }
         logger_log(("OTA Start: " + type).c_str());
+        settings_flush(); // Persist pending edits before the flash is rewritten
+        trace_flush();
         
         // Stop all pumps and valves during OTA
         for (int i = 1; i <= 5; i++) {
@@ -678,73 +1012,176 @@ void setup_ota() {
     logger_log("OTA Ready");
 }
 
+// Starts joining the stored network; false when there are no credentials
+static bool wifi_begin() {
+    if (!load_wifi_credentials()) {
+        logger_log("No WiFi credentials found in LittleFS, starting AP mode");
+        return false;
+    }
+    WiFi.begin(wifi_ssid.c_str(), wifi_password.c_str());
+    String log_msg = "Trying to connect to SSID: " + wifi_ssid + " with password: " + wifi_password;
+    logger_log(log_msg.c_str());
+
+    // Disable power saving modes for better connectivity
+    WiFi.setSleep(false);  // Disable WiFi sleep mode
+    esp_wifi_set_ps(WIFI_PS_NONE);  // Disable power saving completely
+    return true;
+}
+
+static void log_wifi_connected() {
+    String log_msg = "WiFi connected - IP: " + WiFi.localIP().toString();
+    logger_log(log_msg.c_str());
+}
+
+#if FAST_START
+// Network bring-up after setup(), one step per loop pass
+enum NetworkState : uint8_t {
+    NET_CONNECTING,  // WiFi.begin() issued, waiting for an IP
+    NET_TIME_SYNC,   // OTA and web server up, waiting for the first SNTP sync
+    NET_READY,
+    NET_AP           // No credentials or not joined in time: setup portal
+};
+
+static NetworkState network_state = NET_CONNECTING;
+static unsigned long network_state_us = 0; // micros() when the current state began
+static bool ntp_timeout_logged = false;
+
+static void network_set_state(NetworkState state) {
+    network_state = state;
+    network_state_us = micros();
+}
+
+static void network_process() {
+    unsigned long elapsed_ms = (micros() - network_state_us) / 1000;
+    switch (network_state) {
+    case NET_CONNECTING:
+        if (WiFi.status() == WL_CONNECTED) {
+            log_wifi_connected();
+            boot_timeline_event("wifi_connect", network_state_us);
+            time_sync_network_up();
+            unsigned long start = micros();
+            setup_ota(); // Also starts mDNS
+            boot_timeline_event("ota_mdns", start);
+            start = micros();
+            setup_routes();
+            server.begin();
+            boot_timeline_event("web_server", start);
+            network_set_state(NET_TIME_SYNC);
+        } else if (elapsed_ms > WIFI_CONNECT_TIMEOUT_MS) {
+            logger_log("WiFi connect failed");
+            boot_timeline_event("wifi_connect_failed", network_state_us);
+            start_ap_mode();
+            network_set_state(NET_AP);
+        }
+        break;
+    case NET_TIME_SYNC:
+        // SNTP keeps retrying on its own; the scheduler runs once the clock is valid
+        if (time_sync_get_state() == TIME_SYNCED) {
+            boot_timeline_event("ntp_sync", network_state_us);
+            network_set_state(NET_READY);
+        } else if (elapsed_ms > NTP_SYNC_TIMEOUT_MS && !ntp_timeout_logged) {
+            logger_log("NTP sync failed - still trying in the background");
+            ntp_timeout_logged = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
 void setup() {
+    boot_timeline_mark("startup"); // Bootloader and runtime start until setup()
     Serial.begin(115200);
+
+    // Local time for the scheduler; SNTP only sets UTC and leaves TZ alone
+    setenv("TZ", TIME_ZONE, 1);
+    tzset();
+    time_sync_init(); // Starts SNTP in the background; the clock may already be kept across a restart
+    boot_timeline_mark("time_sync");
+
     motor_shield_init();
+    boot_timeline_mark("motor_shield");
     pump_control_init();
+    flow_meter_init();
     valve_control_init();
+    boot_timeline_mark("actuators");
     scheduler_init();
     sensors_init();
+    boot_timeline_mark("scheduler_sensors");
 
     if (!LittleFS.begin()) {
         logger_log("LittleFS Mount Failed");
     } else {
         logger_log("LittleFS Mount Success");
     }
+    boot_timeline_mark("filesystem");
     
     // Initialize logger after LittleFS is mounted
     logger_init();
+    boot_timeline_mark("logger");
     
-    init_weekly_dosing(); // Initialize with defaults first
-    load_settings();       // Then load from file if available
+    settings_load(); // One blob read; defaults on first boot or corruption
+    response_cache_init(esp_random());
+    command_queue_init();
     logger_log("Settings loaded successfully");
+    boot_timeline_mark("settings");
+    fill_model_init();
+    trace_init();
+    boot_timeline_mark("fill_model_trace");
 
+#if FAST_START
+    // Everything above is what the control loop needs; the network comes up
+    // from loop() so the pumps and the safety logic never wait for it
+    if (wifi_begin()) {
+        network_set_state(NET_CONNECTING);
+    } else {
+        start_ap_mode();
+        network_set_state(NET_AP);
+    }
+    boot_timeline_mark("wifi_begin");
+#else
     bool wifi_ok = false;
-    if (load_wifi_credentials()) {
-        WiFi.begin(wifi_ssid.c_str(), wifi_password.c_str());
-        String log_msg = "Trying to connect to SSID: " + wifi_ssid + " with password: " + wifi_password;
-        logger_log(log_msg.c_str());
-
-        // Disable power saving modes for better connectivity
-        WiFi.setSleep(false);  // Disable WiFi sleep mode
-        esp_wifi_set_ps(WIFI_PS_NONE);  // Disable power saving completely
-        
+    if (wifi_begin()) {
         unsigned long start = millis();
-        while (WiFi.status() != WL_CONNECTED && millis() - start < 15000) {
+        while (WiFi.status() != WL_CONNECTED && millis() - start < WIFI_CONNECT_TIMEOUT_MS) {
             delay(500);
         }
         if (WiFi.status() == WL_CONNECTED) {
-            String log_msg = "WiFi connected - IP: " + WiFi.localIP().toString();
-            logger_log(log_msg.c_str());
+            log_wifi_connected();
             wifi_ok = true;
         } else {
             logger_log("WiFi connect failed");
         }
-    } else {
-        logger_log("No WiFi credentials found in LittleFS, starting AP mode");
     }
+    boot_timeline_mark("wifi_connect");
     if (!wifi_ok) {
         start_ap_mode();
         return;
     }
 
     sync_ntp();
+    boot_timeline_mark("ntp_sync");
 
-    // Set timezone for Amsterdam (CET/CEST)
-    setenv("TZ", "CET-1CEST,M3.5.0/2,M10.5.0/3", 1);
-    tzset();
-
-    setup_ota();
+    setup_ota(); // Also starts mDNS
+    boot_timeline_mark("ota_mdns");
 
     setup_routes();
     server.begin();
+    boot_timeline_mark("web_server");
+#endif
 }
 
 void loop() {
+    loop_profiler_begin();
     ArduinoOTA.handle();
+    loop_profiler_mark(LOOP_STAGE_OTA);
     
     // Process log queue regularly to write queued logs to file
+    bool logs_queued = logger_get_queue_count() > 0;
     logger_process_queue();
+    uint32_t drain_us = loop_profiler_mark(LOOP_STAGE_LOG_DRAIN);
+    if (logs_queued) metrics_observe(METRICS_LOG_DRAIN, drain_us);
     
     // Periodic forced flush to ensure logs are written even if no state changes
     static unsigned long last_flush = 0;
@@ -752,82 +1189,60 @@ void loop() {
         logger_flush();
         last_flush = millis();
     }
+    loop_profiler_mark(LOOP_STAGE_LOG_FLUSH);
     
+#if FAST_START
+    network_process();
+    bool wifi_joined = network_state != NET_CONNECTING; // Not while the first connect is in progress
+#else
+    bool wifi_joined = true;
+#endif
     // Check WiFi connection periodically and reconnect if needed
     static unsigned long lastWifiCheck = 0;
-    if (millis() - lastWifiCheck > 30000) { // Check every 30 seconds
+    if (wifi_joined && millis() - lastWifiCheck > 30000) { // Check every 30 seconds
         if (WiFi.status() != WL_CONNECTED) {
             logger_log("WiFi disconnected, attempting reconnection");
             WiFi.reconnect();
+            metrics_count_wifi_reconnect();
         }
         lastWifiCheck = millis();
     }
+    loop_profiler_mark(LOOP_STAGE_WIFI);
     
+    trace_process(control_is_idle()); // Before the commands, so a replay sees inputs in the same order
+    loop_profiler_mark(LOOP_STAGE_TRACE);
+    settings_process(); // Write-behind commit of settings edited over the API
+    loop_profiler_mark(LOOP_STAGE_SETTINGS);
+    command_queue_process(control_execute_command); // Commands submitted by the HTTP handlers
+    loop_profiler_mark(LOOP_STAGE_COMMANDS);
+
+    time_sync_process();
     scheduler_run();
+    loop_profiler_mark(LOOP_STAGE_SCHEDULER);
     pump_control_run();
+    loop_profiler_mark(LOOP_STAGE_PUMP_CONTROL);
+    pump_calibration_run();
+    loop_profiler_mark(LOOP_STAGE_CALIBRATION);
+    batch_runner_run();
+    loop_profiler_mark(LOOP_STAGE_BATCH);
     sensors_read();
+    loop_profiler_mark(LOOP_STAGE_SENSORS);
+    manual_control_process();
+    loop_profiler_mark(LOOP_STAGE_MANUAL);
 
-    switch (watering_state) {
-        case IDLE:
-            break;
-        case DOSING:
-            if (!pump_control_is_dosing()) {
-                // Dosing is complete, move to filling
-                logger_log("State: DOSING -> FILLING");
-                logger_flush(); // Ensure state transition is written
-                valve_control_fill_main_tank();
-                filling = true;
-                fill_start_time = millis();
-                watering_state = FILLING;
-            }
-            break;
-        case FILLING:
-            if (filling) {
-                if (sensors_get_liquid_level()) {
-                    valve_control_stop_main_tank();
-                    filling = false;
-                    logger_log("Tank filled - sensor detected full level");
-                    logger_log("State: FILLING -> FILLED");
-                    logger_flush(); // Ensure state transition is written
-                    watering_state = FILLED;
-                } else if (millis() - fill_start_time > MAIN_TANK_FILL_TIMEOUT_MS) {
-                    valve_control_stop_main_tank();
-                    filling = false;
-                    logger_log("[SAFETY] Main tank fill timeout reached, valve closed");
-                    logger_log("State: FILLING -> FILLED (timeout)");
-                    logger_flush(); // Ensure safety event is written
-                    watering_state = FILLED;
-                }
-            } else {
-                logger_log("State: FILLING -> FILLED (no fill needed)");
-                watering_state = FILLED;
-            }
-            break;
-        case FILLED: {
-            // Start watering pump for configured time after tank is filled
-            logger_log("State: FILLED -> WATERING");
-            logger_flush(); // Ensure state transition is written
-            pump_control_run_watering_pump(watering_duration_ms);
-            watering_state = WATERING;
-            break;
-        }
-        case WATERING:
-            // Wait for watering to complete (pump will stop automatically)
-            if (!watering_pump_active) {
-                logger_log("Watering pump stopped - sequence finished");
-                logger_log("State: WATERING -> IDLE");
-                logger_flush(); // Ensure completion is written
-                watering_state = IDLE;
-            }
-            break;
-    }
+    watering_sequence_run();
+    loop_profiler_mark(LOOP_STAGE_SEQUENCE);
 
-    if (filling && sensors_get_liquid_level()) {
-        valve_control_stop_main_tank();
-        filling = false;
-        logger_log("Tank filled - sensor detected full level (safety check)");
+    publish_status_changes();
+    loop_profiler_mark(LOOP_STAGE_PUBLISH);
+    metrics_observe(METRICS_LOOP, loop_profiler_end());
+    static bool first_pass = true;
+    if (first_pass) {
+        boot_timeline_mark("first_loop_pass"); // Control loop live
+        first_pass = false;
     }
-    
-    // Reduced delay for more responsive log processing
-    delay(50);
+
+    // Reduced delay for more responsive log processing; a manual control
+    // command ends the wait early so it is executed right away
+    manual_control_wait(50);
 }
\ No newline at end of file
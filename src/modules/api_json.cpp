@@ -0,0 +1,95 @@
+#include "api_json.h"
+#include "config/config.h"
+#include "settings_store.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+extern float weekly_dosing_ml[7][NUM_FERTILIZERS];
+extern bool weekly_watering_enabled[7];
+extern ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS];
+extern unsigned long schedule_catchup_s;
+extern float pump_calibration[NUM_FERTILIZERS];
+extern int fertilizer_motor_speed;
+extern unsigned long watering_duration_ms;
+
+// Append formatted text, keeping count of the full length even once buf is full
+struct JsonWriter {
+    char *buf;
+    size_t size;
+    size_t length;
+};
+
+static void append(JsonWriter &w, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t remaining = w.length < w.size ? w.size - w.length : 0;
+    int written = vsnprintf(remaining ? w.buf + w.length : nullptr, remaining, format, args);
+    va_end(args);
+    if (written > 0) {
+        w.length += written;
+    }
+}
+
+size_t api_json_weekly_dosing(char *buf, size_t size) {
+    JsonWriter w = {buf, size, 0};
+    append(w, "[");
+    for (int day = 0; day < 7; day++) {
+        append(w, day ? ",[" : "[");
+        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+            append(w, fert ? ",%.2f" : "%.2f", weekly_dosing_ml[day][fert]);
+        }
+        append(w, "]");
+    }
+    append(w, "]");
+    return w.length;
+}
+
+size_t api_json_weekly_watering_enabled(char *buf, size_t size) {
+    JsonWriter w = {buf, size, 0};
+    append(w, "[");
+    for (int day = 0; day < 7; day++) {
+        append(w, day ? ",%s" : "%s", weekly_watering_enabled[day] ? "true" : "false");
+    }
+    append(w, "]");
+    return w.length;
+}
+
+size_t api_json_schedule(char *buf, size_t size) {
+    JsonWriter w = {buf, size, 0};
+    append(w, "{\"slots\":[");
+    bool first = true;
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        const ScheduleSlot &slot = schedule_slots[i];
+        if (slot.days == 0) continue;
+        append(w, "%s{\"hour\":%d,\"minute\":%d,\"days\":[", first ? "" : ",", slot.hour, slot.minute);
+        for (int day = 0; day < 7; day++) {
+            append(w, day ? ",%s" : "%s", (slot.days & (1 << day)) ? "true" : "false");
+        }
+        append(w, "]}");
+        first = false;
+    }
+    append(w, "],\"catchup_s\":%lu}", schedule_catchup_s);
+    return w.length;
+}
+
+size_t api_json_calibration(char *buf, size_t size) {
+    JsonWriter w = {buf, size, 0};
+    append(w, "[");
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        append(w, i ? ",%.2f" : "%.2f", pump_calibration[i]);
+    }
+    append(w, "]");
+    return w.length;
+}
+
+size_t api_json_motor_speed(char *buf, size_t size) {
+    JsonWriter w = {buf, size, 0};
+    append(w, "{\"fertilizer_motor_speed\":%d}", fertilizer_motor_speed);
+    return w.length;
+}
+
+size_t api_json_watering_duration(char *buf, size_t size) {
+    JsonWriter w = {buf, size, 0};
+    append(w, "{\"watering_duration_ms\":%lu}", watering_duration_ms);
+    return w.length;
+}
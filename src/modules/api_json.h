@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+
+// Bodies of the settings GET endpoints, rendered straight into a caller buffer.
+// Each returns the full length needed (snprintf semantics) so they can be used
+// as ResponseBuilder callbacks for the response cache.
+
+size_t api_json_weekly_dosing(char *buf, size_t size);
+size_t api_json_weekly_watering_enabled(char *buf, size_t size);
+size_t api_json_schedule(char *buf, size_t size);
+size_t api_json_calibration(char *buf, size_t size);
+size_t api_json_motor_speed(char *buf, size_t size);
+size_t api_json_watering_duration(char *buf, size_t size);
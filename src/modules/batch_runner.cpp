@@ -0,0 +1,262 @@
+#include "batch_runner.h"
+#include "motor_shield_control.h"
+#include "pump_control.h"
+#include "logger.h"
+#include "hal/clock.h"
+#include "hal/isr.h"
+#include "config/config.h"
+
+extern int fertilizer_motor_speed;
+extern bool humidifier_pump_active;
+extern bool watering_pump_active;
+
+#define BATCH_WATERING_PUMP 5
+#define BATCH_HUMIDIFIER_PUMP 6
+
+enum BatchState : uint8_t {
+    BATCH_IDLE,
+    BATCH_RUNNING,
+    BATCH_COMPLETED,
+    BATCH_ABORTED
+};
+
+enum BatchStepState : uint8_t {
+    STEP_PENDING,
+    STEP_RUNNING,
+    STEP_DONE,
+    STEP_ABORTED
+};
+
+struct BatchReport {
+    uint32_t id;
+    BatchState state;
+    uint8_t current;                        // Index of the running step
+    uint32_t planned_ms;
+    uint32_t start_ms;
+    uint32_t end_ms;
+    char reason[48];
+    BatchStepState step_state[BATCH_MAX_STEPS];
+    uint32_t step_actual_ms[BATCH_MAX_STEPS];
+};
+
+static BatchProgram program;
+static BatchReport report;
+static uint32_t step_start_ms = 0;
+// The report is written by the control task and read by the web server task
+static hal_lock_t report_mux = HAL_LOCK_INITIALIZER;
+
+static const char *batch_state_name(BatchState state) {
+    switch (state) {
+        case BATCH_IDLE: return "idle";
+        case BATCH_RUNNING: return "running";
+        case BATCH_COMPLETED: return "completed";
+        case BATCH_ABORTED: return "aborted";
+    }
+    return "unknown";
+}
+
+static const char *step_state_name(BatchStepState state) {
+    switch (state) {
+        case STEP_PENDING: return "pending";
+        case STEP_RUNNING: return "running";
+        case STEP_DONE: return "done";
+        case STEP_ABORTED: return "aborted";
+    }
+    return "unknown";
+}
+
+bool batch_parse(JsonObjectConst in, BatchProgram &out, String &error) {
+    JsonArrayConst steps = in["steps"];
+    if (steps.isNull() || steps.size() == 0) {
+        error = "Expected a non-empty steps array";
+        return false;
+    }
+    if (steps.size() > BATCH_MAX_STEPS) {
+        error = "At most " + String(BATCH_MAX_STEPS) + " steps";
+        return false;
+    }
+
+    memset(&out, 0, sizeof(out));
+    uint32_t total_ms = 0;
+    for (JsonObjectConst step : steps) {
+        String where = "steps[" + String(out.count) + "]";
+        if (step.isNull()) {
+            error = where + " must be an object";
+            return false;
+        }
+        BatchStep &s = out.steps[out.count];
+        const char *action = step["action"] | "";
+        if (!step["ms"].is<long>() || step["ms"].as<long>() < 1 || step["ms"].as<long>() > BATCH_MAX_STEP_MS) {
+            error = where + ".ms must be 1-" + String(BATCH_MAX_STEP_MS);
+            return false;
+        }
+        s.ms = step["ms"].as<long>();
+        if (strcmp(action, "wait") == 0) {
+            s.action = BATCH_WAIT;
+            s.pump = -1;
+        } else if (strcmp(action, "pump") == 0) {
+            s.action = BATCH_PUMP;
+            if (!step["pump"].is<int>() || step["pump"].as<int>() < 0 || step["pump"].as<int>() > BATCH_HUMIDIFIER_PUMP) {
+                error = where + ".pump must be 0-" + String(BATCH_HUMIDIFIER_PUMP);
+                return false;
+            }
+            s.pump = step["pump"].as<int>();
+            s.speed = fertilizer_motor_speed;
+            if (step.containsKey("speed")) {
+                if (s.pump >= NUM_FERTILIZERS) {
+                    error = where + ".speed only applies to fertilizer pumps";
+                    return false;
+                }
+                if (!step["speed"].is<int>() || step["speed"].as<int>() < 1 || step["speed"].as<int>() > 255) {
+                    error = where + ".speed must be 1-255";
+                    return false;
+                }
+                s.speed = step["speed"].as<int>();
+            }
+        } else {
+            error = where + ".action must be \"pump\" or \"wait\"";
+            return false;
+        }
+        total_ms += s.ms;
+        if (total_ms > BATCH_MAX_TOTAL_MS) {
+            error = "Program longer than " + String(BATCH_MAX_TOTAL_MS) + " ms";
+            return false;
+        }
+        out.count++;
+    }
+    return true;
+}
+
+static void pump_on(const BatchStep &step) {
+    if (step.pump < NUM_FERTILIZERS) {
+        motor_command(step.pump + 1, step.speed); // Fertilizer pumps 0-4 are motors 1-5
+    } else if (step.pump == BATCH_WATERING_PUMP) {
+        pump_control_run_watering_pump(step.ms);
+    } else {
+        pump_control_run_humidifier_pump(step.ms);
+    }
+}
+
+static void pump_off(const BatchStep &step) {
+    if (step.pump < NUM_FERTILIZERS) {
+        motor_command(step.pump + 1, 0);
+    } else if (step.pump == BATCH_WATERING_PUMP) {
+        if (watering_pump_active) pump_control_stop_watering_pump();
+    } else {
+        if (humidifier_pump_active) pump_control_stop_humidifier_pump();
+    }
+}
+
+static void start_step(uint8_t index) {
+    const BatchStep &step = program.steps[index];
+    if (step.action == BATCH_PUMP) pump_on(step);
+    step_start_ms = hal_millis();
+    hal_lock_enter(&report_mux);
+    report.current = index;
+    report.step_state[index] = STEP_RUNNING;
+    hal_lock_exit(&report_mux);
+}
+
+static void finish(BatchState state, const char *reason) {
+    hal_lock_enter(&report_mux);
+    report.state = state;
+    report.end_ms = hal_millis();
+    strncpy(report.reason, reason, sizeof(report.reason) - 1);
+    report.reason[sizeof(report.reason) - 1] = '\0';
+    hal_lock_exit(&report_mux);
+
+    String log_msg = "Batch " + String(report.id) + " " + batch_state_name(state) + " after " +
+                     String(report.end_ms - report.start_ms) + " ms";
+    if (reason[0]) log_msg += String(" - ") + reason;
+    logger_log(log_msg.c_str());
+}
+
+bool batch_runner_start(const BatchProgram &p, uint32_t id) {
+    if (batch_runner_is_running() || p.count == 0) return false;
+
+    hal_lock_enter(&report_mux);
+    program = p;
+    memset(&report, 0, sizeof(report));
+    report.id = id;
+    report.state = BATCH_RUNNING;
+    report.start_ms = hal_millis();
+    for (int i = 0; i < program.count; i++) {
+        report.planned_ms += program.steps[i].ms;
+    }
+    hal_lock_exit(&report_mux);
+
+    String log_msg = "Batch " + String(id) + " started - " + String(program.count) + " steps, " +
+                     String(report.planned_ms) + " ms";
+    logger_log(log_msg.c_str());
+    start_step(0);
+    return true;
+}
+
+void batch_runner_run() {
+    if (report.state != BATCH_RUNNING) return;
+
+    uint8_t index = report.current;
+    const BatchStep &step = program.steps[index];
+    uint32_t elapsed = hal_millis() - step_start_ms;
+    if (elapsed < step.ms) return;
+
+    if (step.action == BATCH_PUMP) pump_off(step);
+    hal_lock_enter(&report_mux);
+    report.step_state[index] = STEP_DONE;
+    report.step_actual_ms[index] = elapsed;
+    hal_lock_exit(&report_mux);
+
+    if (index + 1 < program.count) {
+        start_step(index + 1);
+    } else {
+        finish(BATCH_COMPLETED, "");
+    }
+}
+
+void batch_runner_abort(const char *reason) {
+    if (report.state != BATCH_RUNNING) return;
+    uint8_t index = report.current;
+    const BatchStep &step = program.steps[index];
+    if (step.action == BATCH_PUMP) pump_off(step);
+    hal_lock_enter(&report_mux);
+    report.step_state[index] = STEP_ABORTED;
+    report.step_actual_ms[index] = hal_millis() - step_start_ms;
+    hal_lock_exit(&report_mux);
+    finish(BATCH_ABORTED, reason);
+}
+
+bool batch_runner_is_running() {
+    return report.state == BATCH_RUNNING;
+}
+
+String batch_runner_get_report_json() {
+    BatchReport r;
+    BatchProgram p;
+    hal_lock_enter(&report_mux);
+    memcpy(&r, &report, sizeof(r));
+    memcpy(&p, &program, sizeof(p));
+    hal_lock_exit(&report_mux);
+
+    DynamicJsonDocument doc(512 + p.count * 128);
+    doc["id"] = r.id;
+    doc["state"] = batch_state_name(r.state);
+    if (r.state != BATCH_IDLE) {
+        doc["planned_ms"] = r.planned_ms;
+        doc["elapsed_ms"] = (r.state == BATCH_RUNNING ? hal_millis() : r.end_ms) - r.start_ms;
+        if (r.reason[0]) doc["reason"] = r.reason;
+        JsonArray steps = doc.createNestedArray("steps");
+        for (int i = 0; i < p.count; i++) {
+            JsonObject step = steps.createNestedObject();
+            step["action"] = p.steps[i].action == BATCH_PUMP ? "pump" : "wait";
+            if (p.steps[i].action == BATCH_PUMP) step["pump"] = p.steps[i].pump;
+            step["ms"] = p.steps[i].ms;
+            step["state"] = step_state_name(r.step_state[i]);
+            if (r.step_state[i] == STEP_DONE || r.step_state[i] == STEP_ABORTED) {
+                step["actual_ms"] = r.step_actual_ms[i];
+            }
+        }
+    }
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
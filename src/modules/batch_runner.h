@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config/config.h"
+
+// Timed maintenance programs submitted through /api/batch, e.g. priming all
+// fertilizer lines one after another. The whole list is validated before
+// anything runs; loop() then steps through it with batch_runner_run() and the
+// outcome is kept as one report.
+//
+// Request body: {"steps": [
+//   {"action": "pump", "pump": 2, "ms": 3000, "speed": 200},  // speed optional
+//   {"action": "wait", "ms": 1000}
+// ]}
+// Pumps 0-4 are the fertilizer pumps, 5 the watering pump, 6 the humidifier pump.
+
+#define BATCH_JSON_SIZE 4096 // Document capacity for a request with BATCH_MAX_STEPS steps
+
+enum BatchAction : uint8_t {
+    BATCH_PUMP,
+    BATCH_WAIT
+};
+
+struct BatchStep {
+    BatchAction action;
+    int8_t pump;
+    uint8_t speed;
+    uint32_t ms;
+};
+
+struct BatchProgram {
+    uint8_t count;
+    BatchStep steps[BATCH_MAX_STEPS];
+};
+
+// Validate and convert a request; false with error set if any step is invalid
+bool batch_parse(JsonObjectConst in, BatchProgram &program, String &error);
+
+// Control task only
+bool batch_runner_start(const BatchProgram &program, uint32_t id);
+void batch_runner_run();
+void batch_runner_abort(const char *reason);
+bool batch_runner_is_running();
+
+// Report of the running or last program (any task)
+String batch_runner_get_report_json();
@@ -0,0 +1,47 @@
+#include "boot_timeline.h"
+#include "hal/clock.h"
+#include "config/config.h"
+
+struct BootEntry {
+    const char *stage;
+    uint32_t start_us;
+    uint32_t end_us;
+};
+
+static BootEntry entries[BOOT_TIMELINE_ENTRIES];
+static uint32_t entry_count = 0;
+static uint32_t last_mark_us = 0;
+static uint32_t dropped = 0;
+
+static void append(const char *stage, uint32_t start_us, uint32_t end_us) {
+    if (entry_count >= BOOT_TIMELINE_ENTRIES) {
+        dropped++;
+        return;
+    }
+    entries[entry_count] = {stage, start_us, end_us};
+    __atomic_store_n(&entry_count, entry_count + 1, __ATOMIC_RELEASE);
+}
+
+void boot_timeline_mark(const char *stage) {
+    uint32_t now = hal_micros();
+    append(stage, last_mark_us, now);
+    last_mark_us = now;
+}
+
+void boot_timeline_event(const char *stage, unsigned long started_us) {
+    append(stage, started_us, hal_micros());
+}
+
+String boot_timeline_get_json() {
+    uint32_t count = __atomic_load_n(&entry_count, __ATOMIC_ACQUIRE);
+    String json = "{\"fast_start\":" + String(FAST_START ? "true" : "false");
+    json += ",\"dropped\":" + String(dropped) + ",\"stages\":[";
+    for (uint32_t i = 0; i < count; i++) {
+        if (i) json += ",";
+        json += "{\"stage\":\"" + String(entries[i].stage) + "\"";
+        json += ",\"start_us\":" + String(entries[i].start_us);
+        json += ",\"duration_us\":" + String(entries[i].end_us - entries[i].start_us) + "}";
+    }
+    json += "]}";
+    return json;
+}
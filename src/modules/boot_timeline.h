@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+// Timestamps of the boot stages, for /api/boot. setup() marks the end of each
+// init stage; with FAST_START the network bring-up that follows in loop() adds
+// its steps as events, each timed from when that step began. Times are
+// micros() since the app started.
+//
+// Written by the loop task only. Entries are append-only and published by a
+// release store of the count, so readers on other tasks need no lock.
+
+// A setup() stage just finished; it began at the previous mark (or at boot).
+// The name is kept, not copied.
+void boot_timeline_mark(const char *stage);
+
+// A background bring-up step finished that began at started_us
+void boot_timeline_event(const char *stage, unsigned long started_us);
+
+String boot_timeline_get_json();
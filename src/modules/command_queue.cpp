@@ -0,0 +1,179 @@
+#include "command_queue.h"
+#include "logger.h"
+#include "trace_recorder.h"
+#include "config/config.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+struct Job {
+    uint32_t id;             // 0 = unused slot
+    CommandType type;
+    JobState state;
+    uint32_t submitted_us;
+    uint32_t started_us;
+    uint32_t finished_us;
+    char message[JOB_MESSAGE_LEN];
+};
+
+static QueueHandle_t queue = nullptr;
+static Job jobs[COMMAND_JOB_HISTORY]; // Indexed by id % COMMAND_JOB_HISTORY
+static uint32_t next_job_id = 1;
+static portMUX_TYPE job_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *job_state_name(JobState state) {
+    switch (state) {
+        case JOB_QUEUED: return "queued";
+        case JOB_RUNNING: return "running";
+        case JOB_DONE: return "done";
+        case JOB_FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+const char *command_type_name(CommandType type) {
+    switch (type) {
+        case CMD_START_WATERING: return "start_watering";
+        case CMD_STOP_ALL: return "stop_all_pumps";
+        case CMD_FILL_MAIN_TANK: return "fill_main_tank";
+        case CMD_STOP_MAIN_TANK: return "stop_main_tank";
+        case CMD_RUN_HUMIDIFIER: return "run_humidifier_pump";
+        case CMD_STOP_HUMIDIFIER: return "stop_humidifier_pump";
+        case CMD_RUN_WATERING_PUMP: return "run_watering_pump";
+        case CMD_STOP_WATERING_PUMP: return "stop_watering_pump";
+        case CMD_DEBUG_PUMP: return "debug_pump";
+        case CMD_CAL_RUN: return "calibration_run";
+        case CMD_CAL_MEASURE: return "calibration_measure";
+        case CMD_CAL_FINISH: return "calibration_finish";
+        case CMD_CAL_CANCEL: return "calibration_cancel";
+        case CMD_APPLY_SETTINGS: return "apply_settings";
+        case CMD_RESET_FILL_MODEL: return "reset_fill_model";
+        case CMD_RUN_BATCH: return "run_batch";
+        case CMD_ABORT_BATCH: return "abort_batch";
+    }
+    return "unknown";
+}
+
+void command_queue_init() {
+    queue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(Command));
+    memset(jobs, 0, sizeof(jobs));
+}
+
+uint32_t command_queue_submit(CommandType type, int32_t a0, int32_t a1, int32_t a2, float value, void *payload) {
+    if (!queue) return 0;
+
+    // Register the job before sending so it is visible as soon as the loop can
+    // run it. A slot whose job is still pending is never reused, and a failed
+    // send puts back the record it replaced and, if possible, its ID.
+    portENTER_CRITICAL(&job_mux);
+    uint32_t id = next_job_id;
+    Job &job = jobs[id % COMMAND_JOB_HISTORY];
+    if (job.id != 0 && (job.state == JOB_QUEUED || job.state == JOB_RUNNING)) {
+        portEXIT_CRITICAL(&job_mux);
+        return 0;
+    }
+    Job replaced = job;
+    next_job_id = id + 1 ? id + 1 : 1;
+    job.id = id;
+    job.type = type;
+    job.state = JOB_QUEUED;
+    job.submitted_us = micros();
+    job.started_us = 0;
+    job.finished_us = 0;
+    job.message[0] = '\0';
+    portEXIT_CRITICAL(&job_mux);
+
+    Command cmd = {id, type, {a0, a1, a2}, value, payload};
+    if (xQueueSend(queue, &cmd, 0) != pdTRUE) {
+        portENTER_CRITICAL(&job_mux);
+        if (job.id == id) job = replaced;
+        if (next_job_id == (id + 1 ? id + 1 : 1)) next_job_id = id; // Nobody took a later ID
+        portEXIT_CRITICAL(&job_mux);
+        return 0;
+    }
+    return id;
+}
+
+static void update_job(uint32_t id, JobState state, const char *message) {
+    portENTER_CRITICAL(&job_mux);
+    Job &job = jobs[id % COMMAND_JOB_HISTORY];
+    if (job.id == id) {
+        job.state = state;
+        if (state == JOB_RUNNING) {
+            job.started_us = micros();
+        } else {
+            job.finished_us = micros();
+            strncpy(job.message, message, JOB_MESSAGE_LEN - 1);
+            job.message[JOB_MESSAGE_LEN - 1] = '\0';
+        }
+    }
+    portEXIT_CRITICAL(&job_mux);
+}
+
+void command_queue_process(CommandExecutor executor) {
+    if (!queue) return;
+    Command cmd;
+    while (xQueueReceive(queue, &cmd, 0) == pdTRUE) {
+        update_job(cmd.job_id, JOB_RUNNING, "");
+        trace_record_command(cmd);
+        char message[JOB_MESSAGE_LEN] = "";
+        bool ok = executor(cmd, message, sizeof(message));
+        update_job(cmd.job_id, ok ? JOB_DONE : JOB_FAILED, message);
+        if (!ok) {
+            String log_msg = "Command " + String(command_type_name(cmd.type)) + " (job " +
+                             String(cmd.job_id) + ") failed: " + message;
+            logger_log(log_msg.c_str());
+        }
+    }
+}
+
+static void append_job_json(const Job &job, String &json) {
+    json += "{\"id\":" + String(job.id);
+    json += ",\"command\":\"" + String(command_type_name(job.type)) + "\"";
+    json += ",\"state\":\"" + String(job_state_name(job.state)) + "\"";
+    if (job.started_us) {
+        json += ",\"wait_us\":" + String(job.started_us - job.submitted_us);
+    }
+    if (job.finished_us) {
+        json += ",\"run_us\":" + String(job.finished_us - job.started_us);
+        json += ",\"total_us\":" + String(job.finished_us - job.submitted_us);
+    }
+    json += ",\"message\":\"";
+    for (const char *c = job.message; *c; c++) {
+        if (*c == '"' || *c == '\\') json += '\\';
+        json += *c;
+    }
+    json += "\"}";
+}
+
+bool command_queue_get_job_json(uint32_t job_id, String &json) {
+    if (job_id == 0) return false;
+    Job job;
+    portENTER_CRITICAL(&job_mux);
+    job = jobs[job_id % COMMAND_JOB_HISTORY];
+    portEXIT_CRITICAL(&job_mux);
+    if (job.id != job_id) return false;
+    json = "";
+    append_job_json(job, json);
+    return true;
+}
+
+String command_queue_get_jobs_json() {
+    Job snapshot[COMMAND_JOB_HISTORY];
+    portENTER_CRITICAL(&job_mux);
+    memcpy(snapshot, jobs, sizeof(snapshot));
+    uint32_t newest = next_job_id - 1;
+    portEXIT_CRITICAL(&job_mux);
+
+    // Newest first
+    String json = "[";
+    bool first = true;
+    for (uint32_t i = 0; i < COMMAND_JOB_HISTORY && i < newest; i++) {
+        const Job &job = snapshot[(newest - i) % COMMAND_JOB_HISTORY];
+        if (job.id != newest - i) continue;
+        if (!first) json += ",";
+        append_job_json(job, json);
+        first = false;
+    }
+    json += "]";
+    return json;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <Arduino.h>
+
+// Commands from the web server task to the control loop.
+// HTTP handlers only validate their parameters and submit a command; loop() runs
+// command_queue_process(), which executes the commands in submission order.
+// Each command gets a job ID whose progress and timing can be looked up
+// through /api/jobs/<id> until it drops out of the job history.
+
+enum CommandType : uint8_t {
+    CMD_START_WATERING,
+    CMD_STOP_ALL,
+    CMD_FILL_MAIN_TANK,
+    CMD_STOP_MAIN_TANK,
+    CMD_RUN_HUMIDIFIER,      // args[0] = ms
+    CMD_STOP_HUMIDIFIER,
+    CMD_RUN_WATERING_PUMP,   // args[0] = ms
+    CMD_STOP_WATERING_PUMP,
+    CMD_DEBUG_PUMP,          // args[0] = pump, args[1] = on (1) / off (0), args[2] = speed
+    CMD_CAL_RUN,             // args[0] = pump, args[1] = point
+    CMD_CAL_MEASURE,         // args[0] = pump, args[1] = point, value = ml
+    CMD_CAL_FINISH,          // args[0] = pump
+    CMD_CAL_CANCEL,
+    CMD_APPLY_SETTINGS,      // payload = heap SettingsPatch
+    CMD_RESET_FILL_MODEL,
+    CMD_RUN_BATCH,           // payload = heap BatchProgram
+    CMD_ABORT_BATCH
+};
+
+enum JobState : uint8_t {
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED
+};
+
+struct Command {
+    uint32_t job_id;
+    CommandType type;
+    int32_t args[3];
+    float value;
+    void *payload;           // Owned by the command; released by the executor
+};
+
+#define JOB_MESSAGE_LEN 64
+
+// Runs one command on the control task. Returns false and fills message on failure;
+// message may also be set on success. Must free cmd.payload.
+typedef bool (*CommandExecutor)(const Command &cmd, char *message, size_t message_size);
+
+void command_queue_init();
+
+// Queue a command; returns its job ID, or 0 when the queue is full or the job
+// history holds only pending jobs (the payload then still belongs to the caller)
+uint32_t command_queue_submit(CommandType type, int32_t a0 = 0, int32_t a1 = 0, int32_t a2 = 0,
+                              float value = 0, void *payload = nullptr);
+
+// Execute all queued commands; called from loop()
+void command_queue_process(CommandExecutor executor);
+
+// Job status as JSON; false if the job is unknown or no longer in the history
+bool command_queue_get_job_json(uint32_t job_id, String &json);
+String command_queue_get_jobs_json();
+const char *command_type_name(CommandType type);
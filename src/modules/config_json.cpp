@@ -0,0 +1,242 @@
+#include "config_json.h"
+#include "config/config.h"
+#include <math.h>
+#include <string.h>
+
+void config_to_json(const SettingsBlob &blob, JsonObject out) {
+    out["version"] = SETTINGS_VERSION;
+
+    JsonArray weekly = out.createNestedArray("weekly_dosing");
+    for (int day = 0; day < 7; day++) {
+        JsonArray day_doses = weekly.createNestedArray();
+        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+            day_doses.add(blob.weekly_dosing_ml[day][fert]);
+        }
+    }
+    JsonArray enabled = out.createNestedArray("weekly_watering_enabled");
+    for (int day = 0; day < 7; day++) {
+        enabled.add(blob.weekly_watering_enabled[day] != 0);
+    }
+
+    // Used slots only; on import the list replaces the whole table
+    JsonObject schedule = out.createNestedObject("schedule");
+    JsonArray slots = schedule.createNestedArray("slots");
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        const ScheduleSlot &slot = blob.schedule_slots[i];
+        if (slot.days == 0) continue;
+        JsonObject entry = slots.createNestedObject();
+        entry["hour"] = slot.hour;
+        entry["minute"] = slot.minute;
+        JsonArray days = entry.createNestedArray("days");
+        for (int day = 0; day < 7; day++) {
+            days.add((slot.days & (1 << day)) != 0);
+        }
+    }
+    schedule["catchup_s"] = blob.schedule_catchup_s;
+
+    JsonArray calibration = out.createNestedArray("calibration");
+    JsonArray curves = out.createNestedArray("calibration_curves");
+    JsonArray spinup = out.createNestedArray("spinup_ms");
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        calibration.add(blob.pump_calibration[i]);
+        JsonArray curve = curves.createNestedArray();
+        for (int p = 0; p < CAL_CURVE_POINTS; p++) {
+            curve.add(blob.pump_curve[i][p]);
+        }
+        spinup.add(blob.pump_spinup_ms[i]);
+    }
+
+    out["fertilizer_motor_speed"] = blob.fertilizer_motor_speed;
+    out["watering_duration_ms"] = blob.watering_duration_ms;
+    out["watering_target_ml"] = blob.watering_target_ml;
+
+    JsonObject sequence = out.createNestedObject("sequence_mode");
+    sequence["pipelined"] = blob.sequence_pipelined != 0;
+    sequence["fill_offset_ms"] = blob.fill_offset_ms;
+}
+
+// Read a number within [min_value, max_value]
+static bool read_number(JsonVariantConst value, float min_value, float max_value, float &out) {
+    if (!value.is<float>()) {
+        return false;
+    }
+    float v = value.as<float>();
+    if (isnan(v) || v < min_value || v > max_value) {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+// read_number() for whole-number fields: 8.7 is rejected, not truncated to 8
+static bool read_integer(JsonVariantConst value, float min_value, float max_value, float &out) {
+    return read_number(value, min_value, max_value, out) && out == floorf(out);
+}
+
+static bool fail(String &error, const String &message) {
+    error = message;
+    return false;
+}
+
+bool config_from_json(JsonObjectConst in, SettingsPatch &patch, String &error) {
+    SettingsBlob &blob = patch.values;
+    float v;
+
+    if (in.containsKey("weekly_dosing")) {
+        JsonArrayConst weekly = in["weekly_dosing"];
+        if (weekly.isNull() || weekly.size() != 7) return fail(error, "weekly_dosing must be 7 arrays");
+        for (int day = 0; day < 7; day++) {
+            JsonArrayConst day_doses = weekly[day];
+            if (day_doses.isNull() || day_doses.size() != NUM_FERTILIZERS) {
+                return fail(error, "weekly_dosing[" + String(day) + "] must have " + String(NUM_FERTILIZERS) + " values");
+            }
+            for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+                if (!read_number(day_doses[fert], 0, MAX_DOSE_ML, v)) {
+                    return fail(error, "weekly_dosing[" + String(day) + "][" + String(fert) + "] out of range");
+                }
+                settings_patch_set(patch, blob.weekly_dosing_ml[day][fert], v, SETTING_WEEKLY_DOSING);
+            }
+        }
+    }
+
+    if (in.containsKey("weekly_watering_enabled")) {
+        JsonArrayConst enabled = in["weekly_watering_enabled"];
+        if (enabled.isNull() || enabled.size() != 7) return fail(error, "weekly_watering_enabled must have 7 values");
+        for (int day = 0; day < 7; day++) {
+            if (!enabled[day].is<bool>()) return fail(error, "weekly_watering_enabled values must be booleans");
+            settings_patch_set(patch, blob.weekly_watering_enabled[day], enabled[day].as<bool>() ? 1 : 0, SETTING_WATERING_DAYS);
+        }
+    }
+
+    if (in.containsKey("schedule")) {
+        JsonObjectConst schedule = in["schedule"];
+        if (schedule.isNull()) return fail(error, "schedule must be an object");
+        if (schedule.containsKey("slots")) {
+            JsonArrayConst slots = schedule["slots"];
+            if (slots.isNull() || slots.size() > SCHEDULE_MAX_SLOTS) {
+                return fail(error, "schedule.slots must be an array of at most " + String(SCHEDULE_MAX_SLOTS));
+            }
+            // The whole table is replaced, unused slots included
+            memset(blob.schedule_slots, 0, sizeof(blob.schedule_slots));
+            settings_patch_mark(patch, blob.schedule_slots, sizeof(blob.schedule_slots), SETTING_SCHEDULE);
+            for (size_t i = 0; i < slots.size(); i++) {
+                JsonObjectConst entry = slots[i];
+                ScheduleSlot &slot = blob.schedule_slots[i];
+                String name = "schedule.slots[" + String(i) + "]";
+                if (entry.isNull()) return fail(error, name + " must be an object");
+                if (!read_integer(entry["hour"], 0, 23, v)) return fail(error, name + ".hour must be 0-23");
+                slot.hour = (uint8_t)v;
+                if (!read_integer(entry["minute"], 0, 59, v)) return fail(error, name + ".minute must be 0-59");
+                slot.minute = (uint8_t)v;
+                slot.days = SCHEDULE_EVERY_DAY;
+                if (entry.containsKey("days")) {
+                    JsonArrayConst days = entry["days"];
+                    if (days.isNull() || days.size() != 7) return fail(error, name + ".days must have 7 values");
+                    slot.days = 0;
+                    for (int day = 0; day < 7; day++) {
+                        if (!days[day].is<bool>()) return fail(error, name + ".days values must be booleans");
+                        if (days[day].as<bool>()) slot.days |= 1 << day;
+                    }
+                    if (slot.days == 0) return fail(error, name + " needs at least one day");
+                }
+            }
+        }
+        // Version 1 backups: a single daily time, now the first slot
+        if (schedule.containsKey("hour")) {
+            if (!read_integer(schedule["hour"], 0, 23, v)) return fail(error, "schedule.hour must be 0-23");
+            settings_patch_slot_time(patch, 0, (int)v, -1);
+        }
+        if (schedule.containsKey("minute")) {
+            if (!read_integer(schedule["minute"], 0, 59, v)) return fail(error, "schedule.minute must be 0-59");
+            settings_patch_slot_time(patch, 0, -1, (int)v);
+        }
+        if (schedule.containsKey("catchup_s")) {
+            if (!read_integer(schedule["catchup_s"], 0, SCHEDULE_MAX_CATCHUP_S, v)) {
+                return fail(error, "schedule.catchup_s must be 0-" + String(SCHEDULE_MAX_CATCHUP_S));
+            }
+            settings_patch_set(patch, blob.schedule_catchup_s, v, SETTING_SCHEDULE);
+        }
+    }
+
+    if (in.containsKey("calibration")) {
+        JsonArrayConst calibration = in["calibration"];
+        if (calibration.isNull() || calibration.size() != NUM_FERTILIZERS) {
+            return fail(error, "calibration must have " + String(NUM_FERTILIZERS) + " values");
+        }
+        for (int i = 0; i < NUM_FERTILIZERS; i++) {
+            if (!read_number(calibration[i], 0.001f, MAX_CALIBRATION_ML_PER_S, v)) {
+                return fail(error, "calibration[" + String(i) + "] out of range");
+            }
+            settings_patch_set(patch, blob.pump_calibration[i], v, SETTING_CALIBRATION);
+        }
+    }
+
+    if (in.containsKey("calibration_curves")) {
+        JsonArrayConst curves = in["calibration_curves"];
+        if (curves.isNull() || curves.size() != NUM_FERTILIZERS) {
+            return fail(error, "calibration_curves must have " + String(NUM_FERTILIZERS) + " curves");
+        }
+        for (int i = 0; i < NUM_FERTILIZERS; i++) {
+            JsonArrayConst curve = curves[i];
+            if (curve.isNull() || curve.size() != CAL_CURVE_POINTS) {
+                return fail(error, "calibration_curves[" + String(i) + "] must have " + String(CAL_CURVE_POINTS) + " points");
+            }
+            for (int p = 0; p < CAL_CURVE_POINTS; p++) {
+                // 0 marks an uncalibrated pump
+                if (!read_number(curve[p], 0, MAX_CALIBRATION_ML_PER_S, v)) {
+                    return fail(error, "calibration_curves[" + String(i) + "][" + String(p) + "] out of range");
+                }
+                settings_patch_set(patch, blob.pump_curve[i][p], v, SETTING_CALIBRATION_CURVE);
+            }
+        }
+    }
+
+    if (in.containsKey("spinup_ms")) {
+        JsonArrayConst spinup = in["spinup_ms"];
+        if (spinup.isNull() || spinup.size() != NUM_FERTILIZERS) {
+            return fail(error, "spinup_ms must have " + String(NUM_FERTILIZERS) + " values");
+        }
+        for (int i = 0; i < NUM_FERTILIZERS; i++) {
+            if (!read_number(spinup[i], 0, CAL_MAX_SPINUP_MS, v)) {
+                return fail(error, "spinup_ms[" + String(i) + "] out of range");
+            }
+            settings_patch_set(patch, blob.pump_spinup_ms[i], v, SETTING_CALIBRATION_CURVE);
+        }
+    }
+
+    if (in.containsKey("fertilizer_motor_speed")) {
+        if (!read_number(in["fertilizer_motor_speed"], 1, 255, v)) return fail(error, "fertilizer_motor_speed must be 1-255");
+        settings_patch_set(patch, blob.fertilizer_motor_speed, v, SETTING_MOTOR_SPEED);
+    }
+
+    if (in.containsKey("watering_duration_ms")) {
+        if (!read_number(in["watering_duration_ms"], 1000, 1800000, v)) {
+            return fail(error, "watering_duration_ms must be 1000-1800000");
+        }
+        settings_patch_set(patch, blob.watering_duration_ms, v, SETTING_WATERING_DURATION);
+    }
+
+    if (in.containsKey("watering_target_ml")) {
+        if (!read_number(in["watering_target_ml"], 0, MAX_WATERING_VOLUME_ML, v)) {
+            return fail(error, "watering_target_ml must be 0-" + String(MAX_WATERING_VOLUME_ML));
+        }
+        settings_patch_set(patch, blob.watering_target_ml, v, SETTING_WATERING_VOLUME);
+    }
+
+    if (in.containsKey("sequence_mode")) {
+        JsonObjectConst sequence = in["sequence_mode"];
+        if (sequence.isNull()) return fail(error, "sequence_mode must be an object");
+        if (sequence.containsKey("pipelined")) {
+            if (!sequence["pipelined"].is<bool>()) return fail(error, "sequence_mode.pipelined must be a boolean");
+            settings_patch_set(patch, blob.sequence_pipelined, sequence["pipelined"].as<bool>() ? 1 : 0, SETTING_SEQUENCE_MODE);
+        }
+        if (sequence.containsKey("fill_offset_ms")) {
+            if (!read_number(sequence["fill_offset_ms"], 0, MAX_FILL_OFFSET_MS, v)) {
+                return fail(error, "sequence_mode.fill_offset_ms must be 0-" + String(MAX_FILL_OFFSET_MS));
+            }
+            settings_patch_set(patch, blob.fill_offset_ms, v, SETTING_SEQUENCE_MODE);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "settings_store.h"
+
+// JSON representation of the whole configuration, used by /api/config
+// for bulk get/set and for backup/restore.
+
+#define CONFIG_JSON_SIZE 4096 // Document capacity for a full configuration
+
+void config_to_json(const SettingsBlob &blob, JsonObject out);
+
+// Collect a partial or full JSON document into a settings patch (start from
+// settings_patch_init). Returns false with error set on the first invalid value;
+// the caller then discards the patch so a rejected update changes nothing.
+bool config_from_json(JsonObjectConst in, SettingsPatch &patch, String &error);
@@ -0,0 +1,170 @@
+#include "control_commands.h"
+#include "motor_shield_control.h"
+#include "pump_control.h"
+#include "pump_calibration.h"
+#include "valve_control.h"
+#include "fill_model.h"
+#include "settings_store.h"
+#include "batch_runner.h"
+#include "scheduler.h"
+#include "watering_sequence.h"
+#include "config/config.h"
+
+// Runs a command queued by an HTTP handler; called from loop() only
+bool control_execute_command(const Command &cmd, char *message, size_t message_size) {
+    switch (cmd.type) {
+        case CMD_START_WATERING:
+            if (watering_sequence_get_state() != IDLE) {
+                strlcpy(message, "Sequence already running", message_size);
+                return false;
+            }
+            if (pump_calibration_is_running()) {
+                strlcpy(message, "Pump calibration running", message_size);
+                return false;
+            }
+            if (batch_runner_is_running()) {
+                strlcpy(message, "Batch program running", message_size);
+                return false;
+            }
+            start_watering_sequence();
+            strlcpy(message, "Watering sequence started", message_size);
+            return true;
+        case CMD_STOP_ALL:
+            // Stop all fertilizer pumps (motors 1-5)
+            for (int i = 1; i <= 5; i++) {
+                stop_motor(i);
+            }
+            valve_control_stop_main_tank();
+            watering_sequence_set_filling(false);
+            pump_control_stop_humidifier_pump();
+            pump_control_stop_watering_pump();
+            strlcpy(message, "All pumps stopped", message_size);
+            return true;
+        case CMD_FILL_MAIN_TANK:
+            valve_control_fill_main_tank();
+            watering_sequence_set_filling(true);
+            strlcpy(message, "Filling main tank", message_size);
+            return true;
+        case CMD_STOP_MAIN_TANK:
+            valve_control_stop_main_tank();
+            watering_sequence_set_filling(false);
+            strlcpy(message, "Stopped main tank", message_size);
+            return true;
+        case CMD_RUN_HUMIDIFIER:
+            pump_control_run_humidifier_pump(cmd.args[0]);
+            strlcpy(message, "Humidifier pump running", message_size);
+            return true;
+        case CMD_STOP_HUMIDIFIER:
+            pump_control_stop_humidifier_pump();
+            strlcpy(message, "Humidifier pump stopped", message_size);
+            return true;
+        case CMD_RUN_WATERING_PUMP:
+            pump_control_run_watering_pump(cmd.args[0]);
+            strlcpy(message, "Watering pump running", message_size);
+            return true;
+        case CMD_STOP_WATERING_PUMP:
+            pump_control_stop_watering_pump();
+            strlcpy(message, "Watering pump stopped", message_size);
+            return true;
+        case CMD_DEBUG_PUMP: {
+            int pump = cmd.args[0];
+            bool on = cmd.args[1] != 0;
+            if (pump >= 0 && pump <= 4) {
+                // Fertilizer pumps (0-4 map to motors 1-5)
+                int motor_num = pump + 1;
+                if (on) {
+                    set_motor_speed(motor_num, cmd.args[2]);
+                    run_motor_forward(motor_num);
+                } else {
+                    stop_motor(motor_num);
+                }
+                snprintf(message, message_size, "Fertilizer pump %d turned %s", pump, on ? "on" : "off");
+            } else if (pump == 5) {
+                // Watering pump
+                if (on) pump_control_run_watering_pump(60000);
+                else pump_control_stop_watering_pump();
+                watering_sequence_set_filling(on);
+                snprintf(message, message_size, "Watering pump turned %s", on ? "on" : "off");
+            } else {
+                // Humidifier pump
+                if (on) pump_control_run_humidifier_pump(60000);
+                else pump_control_stop_humidifier_pump();
+                snprintf(message, message_size, "Humidifier pump turned %s", on ? "on" : "off");
+            }
+            return true;
+        }
+        case CMD_CAL_RUN:
+            if (watering_sequence_get_state() != IDLE) {
+                strlcpy(message, "Sequence running", message_size);
+                return false;
+            }
+            if (batch_runner_is_running()) {
+                strlcpy(message, "Batch program running", message_size);
+                return false;
+            }
+            if (!pump_calibration_start_point(cmd.args[0], cmd.args[1])) {
+                strlcpy(message, "Invalid pump/point or calibration already running", message_size);
+                return false;
+            }
+            strlcpy(message, "Calibration point running", message_size);
+            return true;
+        case CMD_CAL_MEASURE:
+            if (!pump_calibration_measure(cmd.args[0], cmd.args[1], cmd.value)) {
+                strlcpy(message, "Measurement does not match the calibration session", message_size);
+                return false;
+            }
+            strlcpy(message, "Measurement recorded", message_size);
+            return true;
+        case CMD_CAL_FINISH:
+            if (!pump_calibration_finish(cmd.args[0])) {
+                strlcpy(message, "Calibration incomplete - run and measure every point first", message_size);
+                return false;
+            }
+            strlcpy(message, "Calibration curve saved", message_size);
+            return true;
+        case CMD_CAL_CANCEL:
+            pump_calibration_cancel();
+            strlcpy(message, "Calibration cancelled", message_size);
+            return true;
+        case CMD_APPLY_SETTINGS: {
+            // Only the values the request submitted, so other queued edits are kept
+            SettingsPatch *patch = (SettingsPatch *)cmd.payload;
+            settings_apply_patch(*patch);
+            settings_mark_dirty(patch->fields);
+            if (patch->fields & SETTING_SCHEDULE) scheduler_reschedule();
+            delete patch;
+            strlcpy(message, "Settings saved", message_size);
+            return true;
+        }
+        case CMD_RESET_FILL_MODEL:
+            fill_model_reset();
+            strlcpy(message, "Fill statistics reset", message_size);
+            return true;
+        case CMD_RUN_BATCH: {
+            BatchProgram *batch = (BatchProgram *)cmd.payload;
+            bool ok = false;
+            if (watering_sequence_get_state() != IDLE || pump_control_is_dosing()) {
+                strlcpy(message, "Sequence running", message_size);
+            } else if (pump_calibration_is_running()) {
+                strlcpy(message, "Pump calibration running", message_size);
+            } else if (!batch_runner_start(*batch, cmd.job_id)) {
+                strlcpy(message, "Another batch program is running", message_size);
+            } else {
+                strlcpy(message, "Batch program started", message_size);
+                ok = true;
+            }
+            delete batch;
+            return ok;
+        }
+        case CMD_ABORT_BATCH:
+            if (!batch_runner_is_running()) {
+                strlcpy(message, "No batch program running", message_size);
+                return false;
+            }
+            batch_runner_abort("Aborted over the API");
+            strlcpy(message, "Batch program aborted", message_size);
+            return true;
+    }
+    strlcpy(message, "Unknown command", message_size);
+    return false;
+}
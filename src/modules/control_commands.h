@@ -0,0 +1,7 @@
+#pragma once
+#include "command_queue.h"
+
+// Executes the commands that the HTTP handlers queue (see command_queue.h).
+// main.cpp passes it to command_queue_process(); the trace replay calls it
+// directly with the recorded commands.
+bool control_execute_command(const Command &cmd, char *message, size_t message_size);
@@ -0,0 +1,150 @@
+#include "fill_model.h"
+#include "logger.h"
+#include "metrics.h"
+#include <Arduino.h>
+#include "hal/prefs.h"
+#include <ArduinoJson.h>
+#include "config/config.h"
+#include <math.h>
+
+#define FILL_MODEL_VERSION 1
+#define FILL_MODEL_ALPHA 0.2f      // Weight of a new fill once the model is warmed up
+#define FILL_MODEL_SIGMA 4.0f      // Timeout = mean + SIGMA * stddev ...
+#define FILL_MODEL_MAX_MARGIN 1.25f // ... but never less than 125% of the slowest normal fill
+#define FILL_MODEL_FAST_RATIO 0.3f // Fills shorter than this fraction of the mean are flagged
+
+// Persisted as one NVS blob
+struct FillModelState {
+    uint8_t version;
+    uint16_t samples;        // Successful fills learned
+    float mean_ms;           // Exponentially weighted mean duration
+    float var_ms2;           // Exponentially weighted variance
+    float max_ms;            // Slowest successful fill
+    uint32_t timeouts;       // Fills cut off by the timeout
+    uint32_t fast_fills;     // Suspiciously short fills (not learned)
+};
+
+static FillModelState state;
+static unsigned long last_duration_ms = 0;
+static bool last_reached_full = false;
+
+static void fill_model_defaults() {
+    memset(&state, 0, sizeof(state));
+    state.version = FILL_MODEL_VERSION;
+}
+
+static void fill_model_save() {
+    hal_prefs_begin("fill_model", false);
+    hal_prefs_put_bytes("state", &state, sizeof(state));
+    hal_prefs_end();
+    metrics_count_nvs_commit();
+}
+
+void fill_model_init() {
+    fill_model_defaults();
+
+    hal_prefs_begin("fill_model", true);
+    FillModelState stored;
+    size_t len = hal_prefs_get_bytes("state", &stored, sizeof(stored));
+    hal_prefs_end();
+
+    if (len == sizeof(stored) && stored.version == FILL_MODEL_VERSION) {
+        state = stored;
+        String log_msg = "Fill model loaded - " + String(state.samples) + " fills, expected " +
+                         String((unsigned long)state.mean_ms) + " ms, timeout " + String(fill_model_get_timeout_ms()) + " ms";
+        logger_log(log_msg.c_str());
+    } else {
+        logger_log("Fill model initialized - no history, using default timeout");
+    }
+}
+
+bool fill_model_is_trained() {
+    return state.samples >= FILL_MODEL_MIN_SAMPLES;
+}
+
+unsigned long fill_model_get_expected_ms() {
+    return (unsigned long)state.mean_ms;
+}
+
+unsigned long fill_model_get_timeout_ms() {
+    if (!fill_model_is_trained()) {
+        return MAIN_TANK_FILL_TIMEOUT_MS;
+    }
+    float by_spread = state.mean_ms + FILL_MODEL_SIGMA * sqrtf(state.var_ms2);
+    float by_max = state.max_ms * FILL_MODEL_MAX_MARGIN;
+    float timeout = by_spread > by_max ? by_spread : by_max;
+    if (timeout < FILL_MODEL_MIN_TIMEOUT_MS) timeout = FILL_MODEL_MIN_TIMEOUT_MS;
+    if (timeout > MAIN_TANK_FILL_TIMEOUT_MS) timeout = MAIN_TANK_FILL_TIMEOUT_MS;
+    return (unsigned long)timeout;
+}
+
+void fill_model_record(unsigned long duration_ms, bool reached_full) {
+    last_duration_ms = duration_ms;
+    last_reached_full = reached_full;
+
+    if (!reached_full) {
+        // Timeouts are anomalies, never part of the learned distribution
+        state.timeouts++;
+        fill_model_save();
+        return;
+    }
+
+    float x = (float)duration_ms;
+    if (fill_model_is_trained() && x < state.mean_ms * FILL_MODEL_FAST_RATIO) {
+        // Probably a partly filled tank or a sensor fault - keep it out of the model
+        state.fast_fills++;
+        String log_msg = "Fill model: unusually short fill (" + String(duration_ms) + " ms, expected ~" +
+                         String((unsigned long)state.mean_ms) + " ms) - not learned";
+        logger_log(log_msg.c_str());
+        fill_model_save();
+        return;
+    }
+
+    // Cumulative average while warming up, exponential weighting afterwards
+    state.samples++;
+    float alpha = 1.0f / state.samples;
+    if (alpha < FILL_MODEL_ALPHA) alpha = FILL_MODEL_ALPHA;
+    float diff = x - state.mean_ms;
+    float incr = alpha * diff;
+    state.mean_ms += incr;
+    state.var_ms2 = (1.0f - alpha) * (state.var_ms2 + diff * incr);
+    if (x > state.max_ms) state.max_ms = x;
+
+    fill_model_save();
+
+    String log_msg = "Fill model updated - fill took " + String(duration_ms) + " ms, expected " +
+                     String((unsigned long)state.mean_ms) + " ms, next timeout " + String(fill_model_get_timeout_ms()) + " ms";
+    logger_log(log_msg.c_str());
+}
+
+void fill_model_reset() {
+    fill_model_defaults();
+    last_duration_ms = 0;
+    last_reached_full = false;
+    fill_model_save();
+    logger_log("Fill model reset");
+}
+
+String fill_model_get_stats_json() {
+    StaticJsonDocument<384> doc;
+    doc["samples"] = state.samples;
+    doc["trained"] = fill_model_is_trained();
+    doc["expected_ms"] = (unsigned long)state.mean_ms;
+    doc["stddev_ms"] = (unsigned long)sqrtf(state.var_ms2);
+    doc["max_ms"] = (unsigned long)state.max_ms;
+    doc["timeout_ms"] = fill_model_get_timeout_ms();
+    doc["default_timeout_ms"] = MAIN_TANK_FILL_TIMEOUT_MS;
+    if (state.mean_ms > 0) {
+        // Average inflow over the sensed volume, litres per minute
+        doc["flow_l_per_min"] = (MAIN_TANK_FILL_VOLUME_ML / 1000.0f) / (state.mean_ms / 60000.0f);
+    } else {
+        doc["flow_l_per_min"] = 0;
+    }
+    doc["timeouts"] = state.timeouts;
+    doc["fast_fills"] = state.fast_fills;
+    doc["last_duration_ms"] = last_duration_ms;
+    doc["last_reached_full"] = last_reached_full;
+    String response;
+    serializeJson(doc, response);
+    return response;
+}
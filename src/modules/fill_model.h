@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+
+// Learned model of main tank fill duration, used to detect anomalous fills
+// (stuck valve, low pressure) before MAIN_TANK_FILL_TIMEOUT_MS runs out.
+
+void fill_model_init();
+
+// Record a finished fill. reached_full is false when the fill was cut off by the timeout.
+void fill_model_record(unsigned long duration_ms, bool reached_full);
+
+// Timeout to apply to the current fill (learned once enough fills have been seen)
+unsigned long fill_model_get_timeout_ms();
+unsigned long fill_model_get_expected_ms();
+bool fill_model_is_trained();
+
+void fill_model_reset();
+String fill_model_get_stats_json();
@@ -0,0 +1,42 @@
+#include "flow_meter.h"
+#include "logger.h"
+#include "hal/pulse_counter.h"
+#include "config/config.h"
+
+static bool available = false;
+
+void flow_meter_init() {
+    if (!FLOW_METER_ENABLED) {
+        logger_log("Flow meter disabled - watering is time-based only");
+        return;
+    }
+
+    if (!hal_pulse_counter_begin(FLOW_METER_PIN)) {
+        logger_log("ERROR: Flow meter PCNT configuration failed - volume watering unavailable");
+        return;
+    }
+    available = true;
+    logger_log("Flow meter initialized");
+}
+
+void flow_meter_reset() {
+    if (!available) {
+        return;
+    }
+    hal_pulse_counter_clear();
+}
+
+unsigned long flow_meter_get_pulses() {
+    if (!available) {
+        return 0;
+    }
+    return hal_pulse_counter_read();
+}
+
+float flow_meter_get_volume_ml() {
+    return flow_meter_get_pulses() * 1000.0f / FLOW_METER_PULSES_PER_LITER;
+}
+
+bool flow_meter_is_available() {
+    return available;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Hall-effect flow meter on the watering line, counted by the ESP32 PCNT peripheral.
+// Pulses are counted in hardware; the CPU only sees one interrupt per counter overflow.
+
+void flow_meter_init();
+void flow_meter_reset();
+unsigned long flow_meter_get_pulses();
+float flow_meter_get_volume_ml();
+bool flow_meter_is_available();
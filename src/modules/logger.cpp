@@ -1,5 +1,6 @@
 #include "logger.h"
-#include <LittleFS.h>
+#include "hal/clock.h"
+#include "hal/fs.h"
 
 // Log queue structure
 struct LogEntry {
@@ -23,12 +24,12 @@ static unsigned long logs_written = 0;
 
 // Helper function to acquire mutex
 static bool acquire_mutex(unsigned long timeout_ms = 100) {
-    unsigned long start = millis();
+    unsigned long start = hal_millis();
     while (log_mutex) {
-        if (millis() - start > timeout_ms) {
+        if (hal_millis() - start > timeout_ms) {
             return false;
         }
-        delay(1);
+        hal_delay(1);
     }
     log_mutex = true;
     return true;
@@ -57,40 +58,40 @@ void logger_init() {
     Serial.println("Logger initialized with queue-based system");
     
     // Create initial log entry if LittleFS is available
-    if (LittleFS.begin()) {
+    if (hal_fs_begin()) {
         logger_log("Logger system initialized with buffered writing");
         logger_log("System startup");
     }
 }
 
 String get_timestamp() {
-    time_t now = time(nullptr);
+    time_t now = hal_time();
     struct tm timeinfo;
     if (localtime_r(&now, &timeinfo)) {
         char buf[32];
         strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
         return String(buf);
     }
-    return String(millis()); // Fallback to millis if NTP not synced
+    return String(hal_millis()); // Fallback to millis if NTP not synced
 }
 
 void rotate_log_if_needed() {
-    File logFile = LittleFS.open(LOG_FILE_PATH, "r");
+    hal_file_t logFile = hal_fs_open(LOG_FILE_PATH, "r");
     if (!logFile) {
         return; // No current log file, nothing to rotate
     }
     
-    size_t fileSize = logFile.size();
-    logFile.close();
+    size_t fileSize = hal_file_size(logFile);
+    hal_file_close(logFile);
     
     if (fileSize >= MAX_LOG_FILE_SIZE) {
         // Delete old backup if it exists
-        if (LittleFS.exists(LOG_FILE_BACKUP_PATH)) {
-            LittleFS.remove(LOG_FILE_BACKUP_PATH);
+        if (hal_fs_exists(LOG_FILE_BACKUP_PATH)) {
+            hal_fs_remove(LOG_FILE_BACKUP_PATH);
         }
         
         // Move current log to backup
-        LittleFS.rename(LOG_FILE_PATH, LOG_FILE_BACKUP_PATH);
+        hal_fs_rename(LOG_FILE_PATH, LOG_FILE_BACKUP_PATH);
         
         Serial.println("Log file rotated");
     }
@@ -133,7 +134,7 @@ void logger_log(const char* message) {
     LogEntry* entry = &log_queue[queue_write_index];
     strncpy(entry->message, message, MAX_LOG_ENTRY_SIZE - 1);
     entry->message[MAX_LOG_ENTRY_SIZE - 1] = '\0'; // Ensure null termination
-    entry->timestamp_millis = millis();
+    entry->timestamp_millis = hal_millis();
     entry->valid = true;
     
     // Update queue indices
@@ -152,15 +153,14 @@ void logger_process_queue() {
     const int max_per_cycle = 20;
     
     // Open file once for batch writing (more efficient)
-    File logFile;
+    hal_file_t logFile = nullptr;
     bool file_opened = false;
     
     while (processed < max_per_cycle && queue_count > 0) {
         if (!acquire_mutex(100)) {
             // Couldn't acquire mutex, try again next cycle
             if (file_opened) {
-                logFile.flush();
-                logFile.close();
+                hal_file_close(logFile);
             }
             return;
         }
@@ -196,23 +196,23 @@ void logger_process_queue() {
         // Open file if not already open
         if (!file_opened) {
             // Check if rotation is needed first (only on first entry)
-            File checkFile = LittleFS.open(LOG_FILE_PATH, "r");
+            hal_file_t checkFile = hal_fs_open(LOG_FILE_PATH, "r");
             if (checkFile) {
-                size_t fileSize = checkFile.size();
-                checkFile.close();
+                size_t fileSize = hal_file_size(checkFile);
+                hal_file_close(checkFile);
                 
                 if (fileSize >= MAX_LOG_FILE_SIZE) {
                     // Rotate log file
-                    if (LittleFS.exists(LOG_FILE_BACKUP_PATH)) {
-                        LittleFS.remove(LOG_FILE_BACKUP_PATH);
+                    if (hal_fs_exists(LOG_FILE_BACKUP_PATH)) {
+                        hal_fs_remove(LOG_FILE_BACKUP_PATH);
                     }
-                    LittleFS.rename(LOG_FILE_PATH, LOG_FILE_BACKUP_PATH);
+                    hal_fs_rename(LOG_FILE_PATH, LOG_FILE_BACKUP_PATH);
                     Serial.println("Log file rotated");
                 }
             }
             
             // Open file for appending
-            logFile = LittleFS.open(LOG_FILE_PATH, "a");
+            logFile = hal_fs_open(LOG_FILE_PATH, "a");
             if (!logFile) {
                 Serial.println("Failed to open log file for writing: " + String(LOG_FILE_PATH));
                 processed++;
@@ -226,7 +226,7 @@ void logger_process_queue() {
         String logEntry = "[" + timestamp + "] " + String(message_copy) + "\n";
         
         // Write to file
-        size_t written = logFile.print(logEntry);
+        size_t written = hal_file_write(logFile, logEntry.c_str(), logEntry.length());
         
         if (written > 0) {
             logs_written++;
@@ -237,17 +237,16 @@ void logger_process_queue() {
     
     // Close and flush file if it was opened
     if (file_opened) {
-        logFile.flush(); // Force write to filesystem
-        logFile.close();
+        hal_file_close(logFile); // Flushes to the filesystem
     }
     
     // Periodically report statistics
     static unsigned long last_stats_report = 0;
-    if (millis() - last_stats_report > 60000) { // Every 60 seconds
+    if (hal_millis() - last_stats_report > 60000) { // Every 60 seconds
         if (logs_dropped > 0 || queue_count > 50) {
             Serial.println("LOG STATS: Written=" + String(logs_written) + ", Dropped=" + String(logs_dropped) + ", Queued=" + String(queue_count));
         }
-        last_stats_report = millis();
+        last_stats_report = hal_millis();
     }
 }
 
@@ -260,7 +259,7 @@ void logger_flush() {
     while (queue_count > 0 && iterations < max_iterations) {
         logger_process_queue();
         iterations++;
-        yield(); // Allow ESP32 to handle WiFi, etc.
+        hal_yield(); // Allow ESP32 to handle WiFi, etc.
     }
     
     if (queue_count > 0) {
@@ -271,41 +270,45 @@ void logger_flush() {
 }
 
 String logger_get_logs(int max_lines) {
-    File logFile = LittleFS.open(LOG_FILE_PATH, "r");
+    hal_file_t logFile = hal_fs_open(LOG_FILE_PATH, "r");
     if (!logFile) {
         return "No log file found";
     }
     
-    size_t fileSize = logFile.size();
+    size_t fileSize = hal_file_size(logFile);
     if (fileSize == 0) {
-        logFile.close();
+        hal_file_close(logFile);
         return "Log file is empty";
     }
     
     // For large files, read only the last portion
     String result = "";
+    bool skip_partial_line = false;
     if (max_lines > 0 && fileSize > 10000) {
         // Read last 10KB for large files
-        size_t readSize = min(fileSize, (size_t)10000);
-        logFile.seek(fileSize - readSize);
-        
-        // Skip partial first line
-        while (logFile.available() && logFile.read() != '\n');
-        
-        // Read the rest
-        while (logFile.available()) {
-            char c = logFile.read();
-            result += c;
-        }
+        hal_file_seek(logFile, fileSize - 10000);
+        result.reserve(10000);
+        skip_partial_line = true;
     } else {
         // Read entire file for small files
-        while (logFile.available()) {
-            char c = logFile.read();
-            result += c;
+        result.reserve(fileSize);
+    }
+    
+    char buf[256];
+    size_t n;
+    while ((n = hal_file_read(logFile, buf, sizeof(buf))) > 0) {
+        size_t start = 0;
+        if (skip_partial_line) {
+            // Skip partial first line
+            while (start < n && buf[start] != '\n') start++;
+            if (start == n) continue;
+            start++;
+            skip_partial_line = false;
         }
+        result.concat(buf + start, n - start);
     }
     
-    logFile.close();
+    hal_file_close(logFile);
     
     if (result.length() == 0) {
         return "Unable to read log contents";
@@ -315,21 +318,21 @@ String logger_get_logs(int max_lines) {
 }
 
 void logger_clear() {
-    if (LittleFS.exists(LOG_FILE_PATH)) {
-        LittleFS.remove(LOG_FILE_PATH);
+    if (hal_fs_exists(LOG_FILE_PATH)) {
+        hal_fs_remove(LOG_FILE_PATH);
     }
-    if (LittleFS.exists(LOG_FILE_BACKUP_PATH)) {
-        LittleFS.remove(LOG_FILE_BACKUP_PATH);
+    if (hal_fs_exists(LOG_FILE_BACKUP_PATH)) {
+        hal_fs_remove(LOG_FILE_BACKUP_PATH);
     }
     Serial.println("Log files cleared");
 }
 
 size_t logger_get_file_size() {
-    File logFile = LittleFS.open(LOG_FILE_PATH, "r");
+    hal_file_t logFile = hal_fs_open(LOG_FILE_PATH, "r");
     if (!logFile) {
         return 0;
     }
-    size_t size = logFile.size();
-    logFile.close();
+    size_t size = hal_file_size(logFile);
+    hal_file_close(logFile);
     return size;
 }
@@ -2,7 +2,6 @@
 #define LOGGER_H
 
 #include <Arduino.h>
-#include <LittleFS.h>
 #include <time.h>
 
 // Configuration
@@ -0,0 +1,216 @@
+#include "loop_profiler.h"
+#include "logger.h"
+#include "seqlock.h"
+#include "hal/clock.h"
+#include "config/config.h"
+#include <ArduinoJson.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOW_LOG_INTERVAL_MS 10000 // Slow passes are still captured in between, only the log line is skipped
+
+static const char *const stage_names[LOOP_STAGE_COUNT] = {
+    "ota", "log_drain", "log_flush", "wifi", "trace", "settings", "commands", "scheduler",
+    "pump_control", "calibration", "batch", "sensors", "manual", "sequence", "publish"
+};
+
+// One pass in the ring, in cycles. A stage longer than 2^32 cycles (about 17 s at
+// 240 MHz) wraps; only an OTA upload blocks that long, and it ends in a reboot.
+// Seqlock-guarded (seqlock.h).
+struct PassRecord {
+    uint32_t sequence;
+    uint32_t cycles[LOOP_STAGE_COUNT];
+};
+
+struct SlowPass {
+    uint32_t ms;                        // hal_millis() at the end of the pass
+    uint32_t pass_us;
+    uint32_t stage_us[LOOP_STAGE_COUNT];
+};
+
+// Everything but the ring, seqlock-guarded as well
+struct ProfileTotals {
+    uint32_t sequence;
+    uint32_t cycles_per_us;
+    uint32_t passes;                    // Since the last reset; the next ring row is passes % LOOP_PROFILE_PASSES
+    uint32_t slow_passes;               // Since the last reset; the newest capture is (slow_passes - 1) % LOOP_SLOW_CAPTURES
+    uint32_t peak_pass_us;
+    uint32_t peak_stage_us[LOOP_STAGE_COUNT];
+    SlowPass slow[LOOP_SLOW_CAPTURES];
+};
+
+static PassRecord ring[LOOP_PROFILE_PASSES];
+static ProfileTotals totals;
+
+// Pass in progress, control loop only
+static uint32_t current[LOOP_STAGE_COUNT];
+static uint32_t last_mark = 0;
+static uint32_t last_slow_log_ms = 0;
+static bool slow_logged = false;
+
+// Set by other tasks
+static uint32_t slow_threshold_us = LOOP_SLOW_THRESHOLD_US;
+static bool reset_requested = false;
+
+const char *loop_stage_name(LoopStage stage) {
+    return stage < LOOP_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+void loop_profiler_begin() {
+    if (totals.cycles_per_us == 0 || __atomic_exchange_n(&reset_requested, false, __ATOMIC_ACQUIRE)) {
+        // The ring needs no clearing: only rows written since the reset are read
+        seqlock_write_begin(totals.sequence);
+        totals.cycles_per_us = hal_cycles_per_us();
+        totals.passes = 0;
+        totals.slow_passes = 0;
+        totals.peak_pass_us = 0;
+        memset(totals.peak_stage_us, 0, sizeof(totals.peak_stage_us));
+        seqlock_write_end(totals.sequence);
+        slow_logged = false;
+    }
+    memset(current, 0, sizeof(current));
+    last_mark = hal_cycles();
+}
+
+uint32_t loop_profiler_mark(LoopStage stage) {
+    uint32_t now = hal_cycles();
+    uint32_t cycles = now - last_mark;
+    last_mark = now;
+    if (stage < LOOP_STAGE_COUNT) current[stage] += cycles;
+    return cycles / totals.cycles_per_us;
+}
+
+static void log_slow_pass(const SlowPass &capture) {
+    if (slow_logged && capture.ms - last_slow_log_ms < SLOW_LOG_INTERVAL_MS) return;
+    slow_logged = true;
+    last_slow_log_ms = capture.ms;
+    int slowest = 0;
+    for (int i = 1; i < LOOP_STAGE_COUNT; i++) {
+        if (capture.stage_us[i] > capture.stage_us[slowest]) slowest = i;
+    }
+    String log_msg = "Slow loop pass: " + String(capture.pass_us / 1000) + " ms, " + stage_names[slowest] + " " +
+                     String(capture.stage_us[slowest] / 1000) + " ms (" + String(totals.slow_passes) + " slow passes)";
+    logger_log(log_msg.c_str());
+}
+
+uint32_t loop_profiler_end() {
+    uint32_t cycles_per_us = totals.cycles_per_us;
+    uint64_t pass_cycles = 0;
+    for (int i = 0; i < LOOP_STAGE_COUNT; i++) pass_cycles += current[i];
+    uint32_t pass_us = (uint32_t)(pass_cycles / cycles_per_us);
+
+    PassRecord &row = ring[totals.passes % LOOP_PROFILE_PASSES];
+    seqlock_write_begin(row.sequence);
+    memcpy(row.cycles, current, sizeof(row.cycles));
+    seqlock_write_end(row.sequence);
+
+    bool slow = pass_us > __atomic_load_n(&slow_threshold_us, __ATOMIC_RELAXED);
+    seqlock_write_begin(totals.sequence);
+    totals.passes++;
+    if (pass_us > totals.peak_pass_us) totals.peak_pass_us = pass_us;
+    for (int i = 0; i < LOOP_STAGE_COUNT; i++) {
+        uint32_t us = current[i] / cycles_per_us;
+        if (us > totals.peak_stage_us[i]) totals.peak_stage_us[i] = us;
+    }
+    SlowPass *capture = nullptr;
+    if (slow) {
+        capture = &totals.slow[totals.slow_passes % LOOP_SLOW_CAPTURES];
+        capture->ms = hal_millis();
+        capture->pass_us = pass_us;
+        for (int i = 0; i < LOOP_STAGE_COUNT; i++) capture->stage_us[i] = current[i] / cycles_per_us;
+        totals.slow_passes++;
+    }
+    seqlock_write_end(totals.sequence);
+
+    if (capture) log_slow_pass(*capture);
+    return pass_us;
+}
+
+void loop_profiler_configure(uint32_t threshold_us, bool reset) {
+    __atomic_store_n(&slow_threshold_us, threshold_us, __ATOMIC_RELAXED);
+    if (reset) __atomic_store_n(&reset_requested, true, __ATOMIC_RELEASE);
+}
+
+uint32_t loop_profiler_get_slow_threshold_us() {
+    return __atomic_load_n(&slow_threshold_us, __ATOMIC_RELAXED);
+}
+
+static int compare_us(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted values
+static uint32_t percentile(const uint32_t *sorted, uint32_t count, uint32_t p) {
+    if (count == 0) return 0;
+    uint32_t rank = (p * count + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static void add_distribution(JsonObject out, uint32_t *values, uint32_t count, uint32_t peak_us) {
+    qsort(values, count, sizeof(uint32_t), compare_us);
+    out["p50_us"] = percentile(values, count, 50);
+    out["p95_us"] = percentile(values, count, 95);
+    out["p99_us"] = percentile(values, count, 99);
+    out["max_us"] = count ? values[count - 1] : 0;
+    out["peak_us"] = peak_us; // Since boot or the last reset, not only the kept passes
+}
+
+String loop_profiler_get_json() {
+    ProfileTotals t;
+    if (!seqlock_read(totals.sequence, totals, t)) return String();
+    uint32_t cycles_per_us = t.cycles_per_us ? t.cycles_per_us : 1;
+    uint32_t rows = t.passes < LOOP_PROFILE_PASSES ? t.passes : LOOP_PROFILE_PASSES;
+
+    // One column of microseconds per stage, then one for the whole pass
+    uint32_t *columns = (uint32_t *)malloc(sizeof(uint32_t) * (LOOP_STAGE_COUNT + 1) * LOOP_PROFILE_PASSES);
+    if (!columns) return String();
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < rows; r++) {
+        PassRecord row;
+        if (!seqlock_read(ring[r].sequence, ring[r], row)) continue; // Left out rather than waited for
+        uint64_t pass_cycles = 0;
+        for (int s = 0; s < LOOP_STAGE_COUNT; s++) {
+            columns[s * LOOP_PROFILE_PASSES + count] = row.cycles[s] / cycles_per_us;
+            pass_cycles += row.cycles[s];
+        }
+        columns[LOOP_STAGE_COUNT * LOOP_PROFILE_PASSES + count] = (uint32_t)(pass_cycles / cycles_per_us);
+        count++;
+    }
+
+    DynamicJsonDocument doc(6144);
+    doc["passes"] = t.passes;
+    doc["kept"] = count;
+    doc["cycles_per_us"] = t.cycles_per_us;
+    doc["slow_threshold_us"] = loop_profiler_get_slow_threshold_us();
+    doc["slow_passes"] = t.slow_passes;
+    add_distribution(doc.createNestedObject("pass"), columns + LOOP_STAGE_COUNT * LOOP_PROFILE_PASSES, count,
+                     t.peak_pass_us);
+    JsonArray stages = doc.createNestedArray("stages");
+    for (int s = 0; s < LOOP_STAGE_COUNT; s++) {
+        JsonObject stage = stages.createNestedObject();
+        stage["name"] = stage_names[s];
+        add_distribution(stage, columns + s * LOOP_PROFILE_PASSES, count, t.peak_stage_us[s]);
+    }
+    free(columns);
+
+    // Newest first; stages under a microsecond are left out
+    JsonArray slow = doc.createNestedArray("slow");
+    uint32_t now_ms = hal_millis();
+    uint32_t captures = t.slow_passes < LOOP_SLOW_CAPTURES ? t.slow_passes : LOOP_SLOW_CAPTURES;
+    for (uint32_t i = 0; i < captures; i++) {
+        const SlowPass &capture = t.slow[(t.slow_passes - 1 - i) % LOOP_SLOW_CAPTURES];
+        JsonObject entry = slow.createNestedObject();
+        entry["age_ms"] = now_ms - capture.ms;
+        entry["pass_us"] = capture.pass_us;
+        JsonObject stage_us = entry.createNestedObject("stages");
+        for (int s = 0; s < LOOP_STAGE_COUNT; s++) {
+            if (capture.stage_us[s]) stage_us[stage_names[s]] = capture.stage_us[s];
+        }
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+
+// Where the control loop spends its time. loop() calls loop_profiler_begin() at
+// the top of a pass and loop_profiler_mark() after each stage; the cycle counter
+// difference since the previous mark is charged to that stage. The last
+// LOOP_PROFILE_PASSES passes are kept stage by stage, and /api/loop_profile
+// reports percentiles and maxima per stage from them. A pass slower than the
+// threshold is kept as a slow capture and logged, naming the stage that stalled.
+//
+// Only the control loop writes. The web server task copies ring rows and the
+// totals under sequence counters like the state snapshot, so the loop never waits.
+
+enum LoopStage : uint8_t {
+    LOOP_STAGE_OTA,
+    LOOP_STAGE_LOG_DRAIN,
+    LOOP_STAGE_LOG_FLUSH,
+    LOOP_STAGE_WIFI,
+    LOOP_STAGE_TRACE,
+    LOOP_STAGE_SETTINGS,
+    LOOP_STAGE_COMMANDS,
+    LOOP_STAGE_SCHEDULER,
+    LOOP_STAGE_PUMP_CONTROL,
+    LOOP_STAGE_CALIBRATION,
+    LOOP_STAGE_BATCH,
+    LOOP_STAGE_SENSORS,
+    LOOP_STAGE_MANUAL,
+    LOOP_STAGE_SEQUENCE,
+    LOOP_STAGE_PUBLISH,
+    LOOP_STAGE_COUNT
+};
+
+const char *loop_stage_name(LoopStage stage);
+
+// Control loop only
+void loop_profiler_begin();
+uint32_t loop_profiler_mark(LoopStage stage); // Returns the stage time in microseconds
+uint32_t loop_profiler_end();                 // Returns the pass time in microseconds
+
+// Any task; applied at the start of the next pass. reset clears the ring, the
+// maxima and the slow captures.
+void loop_profiler_configure(uint32_t slow_threshold_us, bool reset);
+uint32_t loop_profiler_get_slow_threshold_us();
+
+// /api/loop_profile body; empty if the ring copy could not be allocated or the
+// loop was updating the totals for every read attempt
+String loop_profiler_get_json();
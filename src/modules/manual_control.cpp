@@ -0,0 +1,271 @@
+#include "manual_control.h"
+#include "motor_shield_control.h"
+#include "pump_control.h"
+#include "pump_calibration.h"
+#include "batch_runner.h"
+#include "logger.h"
+#include "trace_recorder.h"
+#include "config/config.h"
+#include <ESPAsyncWebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+extern bool humidifier_pump_active;
+extern bool watering_pump_active;
+extern int fertilizer_motor_speed;
+
+#define MANUAL_FRAME_LEN 5
+#define MANUAL_ACK_LEN 10
+#define MANUAL_STATE_LEN (2 + MANUAL_CHANNELS)
+#define MANUAL_WATERING_CHANNEL 5
+#define MANUAL_HUMIDIFIER_CHANNEL 6
+
+struct ManualCommand {
+    uint32_t client_id;
+    uint32_t received_us;
+    uint8_t op;
+    uint8_t seq;
+    uint8_t channel;
+    uint16_t arg;
+};
+
+static AsyncWebSocket manual_ws("/api/manual");
+static QueueHandle_t command_queue = nullptr;
+
+// Fertilizer channels driven from here; 5 and 6 report the pump_control state
+static uint8_t fert_speed[NUM_FERTILIZERS] = {0};
+static uint8_t fert_last_speed[NUM_FERTILIZERS] = {0};
+static unsigned long fert_pulse_end[NUM_FERTILIZERS] = {0}; // 0 = no pulse pending
+
+// Latency statistics (receive -> motor command issued)
+static unsigned long command_count = 0;
+static unsigned long rejected_count = 0;
+static uint32_t last_latency_us = 0;
+static uint32_t max_latency_us = 0;
+static uint64_t total_latency_us = 0;
+
+static bool fertilizer_busy() {
+    return pump_control_is_dosing() || pump_calibration_is_running() || batch_runner_is_running();
+}
+
+static uint8_t channel_speed(int channel) {
+    if (channel < NUM_FERTILIZERS) return fert_speed[channel];
+    if (channel == MANUAL_WATERING_CHANNEL) return watering_pump_active ? 255 : 0;
+    if (channel == MANUAL_HUMIDIFIER_CHANNEL) return humidifier_pump_active ? 255 : 0;
+    return 0;
+}
+
+static uint8_t running_mask() {
+    uint8_t mask = 0;
+    for (int ch = 0; ch < MANUAL_CHANNELS; ch++) {
+        if (channel_speed(ch) > 0) mask |= 1 << ch;
+    }
+    return mask;
+}
+
+static void set_fertilizer(int channel, uint8_t speed) {
+    motor_command(channel + 1, speed); // Fertilizer pumps 0-4 are motors 1-5
+    fert_speed[channel] = speed;
+    if (speed > 0) fert_last_speed[channel] = speed;
+    else fert_pulse_end[channel] = 0;
+}
+
+static void broadcast_state() {
+    if (manual_ws.count() == 0) return;
+    uint8_t frame[MANUAL_STATE_LEN];
+    frame[0] = MANUAL_STATE_FRAME;
+    frame[1] = running_mask();
+    for (int ch = 0; ch < MANUAL_CHANNELS; ch++) {
+        frame[2 + ch] = channel_speed(ch);
+    }
+    manual_ws.binaryAll(frame, sizeof(frame));
+}
+
+static void send_ack(const ManualCommand &cmd, uint8_t status, uint32_t latency_us) {
+    uint8_t frame[MANUAL_ACK_LEN];
+    frame[0] = cmd.op | MANUAL_ACK_FLAG;
+    frame[1] = cmd.seq;
+    frame[2] = status;
+    frame[3] = cmd.channel;
+    frame[4] = latency_us & 0xFF;
+    frame[5] = (latency_us >> 8) & 0xFF;
+    frame[6] = (latency_us >> 16) & 0xFF;
+    frame[7] = (latency_us >> 24) & 0xFF;
+    frame[8] = running_mask();
+    frame[9] = cmd.channel < MANUAL_CHANNELS ? channel_speed(cmd.channel) : 0;
+    manual_ws.binary(cmd.client_id, frame, sizeof(frame));
+}
+
+static void stop_manual_fertilizers() {
+    for (int ch = 0; ch < NUM_FERTILIZERS; ch++) {
+        if (fert_speed[ch] > 0) set_fertilizer(ch, 0);
+    }
+}
+
+static uint8_t execute(const ManualCommand &cmd) {
+    if (cmd.op == MANUAL_OP_PING) return MANUAL_OK;
+    if (cmd.op == MANUAL_OP_STOP_ALL) {
+        stop_manual_fertilizers();
+        if (cmd.client_id != 0) {
+            // Explicit stop from a client also stops the watering and humidifier pumps
+            if (watering_pump_active) pump_control_stop_watering_pump();
+            if (humidifier_pump_active) pump_control_stop_humidifier_pump();
+        }
+        return MANUAL_OK;
+    }
+    if (cmd.channel >= MANUAL_CHANNELS) return MANUAL_BAD_CHANNEL;
+
+    if (cmd.channel < NUM_FERTILIZERS) {
+        int ch = cmd.channel;
+        uint8_t speed;
+        switch (cmd.op) {
+            case MANUAL_OP_STOP:
+                set_fertilizer(ch, 0);
+                return MANUAL_OK;
+            case MANUAL_OP_START:
+                if (fertilizer_busy()) return MANUAL_BUSY;
+                speed = cmd.arg > 0 ? (cmd.arg > 255 ? 255 : cmd.arg) : fertilizer_motor_speed;
+                fert_pulse_end[ch] = 0;
+                set_fertilizer(ch, speed);
+                return MANUAL_OK;
+            case MANUAL_OP_SPEED:
+                if (fertilizer_busy()) return MANUAL_BUSY;
+                speed = cmd.arg > 255 ? 255 : cmd.arg;
+                if (fert_speed[ch] > 0 || speed == 0) set_fertilizer(ch, speed);
+                else fert_last_speed[ch] = speed; // Used by the next pulse
+                return MANUAL_OK;
+            case MANUAL_OP_PULSE:
+                if (fertilizer_busy()) return MANUAL_BUSY;
+                if (cmd.arg == 0) return MANUAL_BAD_FRAME;
+                speed = fert_last_speed[ch] > 0 ? fert_last_speed[ch] : fertilizer_motor_speed;
+                set_fertilizer(ch, speed);
+                fert_pulse_end[ch] = millis() + cmd.arg;
+                if (fert_pulse_end[ch] == 0) fert_pulse_end[ch] = 1;
+                return MANUAL_OK;
+        }
+        return MANUAL_BAD_FRAME;
+    }
+
+    // Watering and humidifier pumps run at fixed speed through pump_control
+    bool watering = cmd.channel == MANUAL_WATERING_CHANNEL;
+    switch (cmd.op) {
+        case MANUAL_OP_STOP:
+            if (watering) pump_control_stop_watering_pump();
+            else pump_control_stop_humidifier_pump();
+            return MANUAL_OK;
+        case MANUAL_OP_START:
+        case MANUAL_OP_PULSE: {
+            unsigned long ms = cmd.op == MANUAL_OP_PULSE ? cmd.arg : MANUAL_RUN_MAX_MS;
+            if (ms == 0) return MANUAL_BAD_FRAME;
+            if (watering) pump_control_run_watering_pump(ms);
+            else pump_control_run_humidifier_pump(ms);
+            return MANUAL_OK;
+        }
+        case MANUAL_OP_SPEED:
+            return MANUAL_UNSUPPORTED;
+    }
+    return MANUAL_BAD_FRAME;
+}
+
+static void on_ws_event(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type,
+                        void *arg, uint8_t *data, size_t len) {
+    if (type == WS_EVT_CONNECT) {
+        broadcast_state();
+        return;
+    }
+    if (type == WS_EVT_DISCONNECT) {
+        if (server->count() == 0) {
+            // Nobody left to stop a jogging pump: stop the manual fertilizer channels
+            ManualCommand cmd = {0, micros(), MANUAL_OP_STOP_ALL, 0, 0, 0};
+            xQueueSend(command_queue, &cmd, 0);
+        }
+        return;
+    }
+    if (type != WS_EVT_DATA) return;
+
+    AwsFrameInfo *info = (AwsFrameInfo *)arg;
+    ManualCommand cmd = {client->id(), micros(), 0, 0, 0, 0};
+    if (!info->final || info->index != 0 || info->opcode != WS_BINARY || len != MANUAL_FRAME_LEN) {
+        send_ack(cmd, MANUAL_BAD_FRAME, 0);
+        return;
+    }
+    cmd.op = data[0];
+    cmd.seq = data[1];
+    cmd.channel = data[2];
+    cmd.arg = data[3] | (data[4] << 8);
+    if (xQueueSend(command_queue, &cmd, 0) != pdTRUE) {
+        rejected_count++;
+        send_ack(cmd, MANUAL_QUEUE_FULL, 0);
+    }
+}
+
+void manual_control_init(AsyncWebServer &server) {
+    command_queue = xQueueCreate(MANUAL_QUEUE_LENGTH, sizeof(ManualCommand));
+    manual_ws.onEvent(on_ws_event);
+    server.addHandler(&manual_ws);
+}
+
+void manual_control_process() {
+    bool changed = false;
+    ManualCommand cmd;
+    while (command_queue && xQueueReceive(command_queue, &cmd, 0) == pdTRUE) {
+        uint8_t status = execute(cmd);
+        if (status == MANUAL_OK && cmd.op != MANUAL_OP_PING) trace_record_manual();
+        uint32_t latency_us = micros() - cmd.received_us;
+        if (cmd.client_id == 0) {
+            logger_log("Manual control: last client disconnected, fertilizer pumps stopped");
+        } else {
+            if (status == MANUAL_OK) {
+                command_count++;
+                last_latency_us = latency_us;
+                total_latency_us += latency_us;
+                if (latency_us > max_latency_us) max_latency_us = latency_us;
+            } else {
+                rejected_count++;
+            }
+            send_ack(cmd, status, latency_us);
+        }
+        if (status == MANUAL_OK && cmd.op != MANUAL_OP_PING) changed = true;
+    }
+
+    // End fertilizer pulses
+    unsigned long now = millis();
+    for (int ch = 0; ch < NUM_FERTILIZERS; ch++) {
+        if (fert_pulse_end[ch] && (long)(now - fert_pulse_end[ch]) >= 0) {
+            set_fertilizer(ch, 0);
+            changed = true;
+        }
+    }
+
+    // Watering and humidifier pumps also stop on their own timers
+    static uint8_t last_mask = 0;
+    uint8_t mask = running_mask();
+    if (mask != last_mask) {
+        last_mask = mask;
+        changed = true;
+    }
+    if (changed) broadcast_state();
+
+    manual_ws.cleanupClients();
+}
+
+void manual_control_wait(unsigned long ms) {
+    if (!command_queue) {
+        delay(ms);
+        return;
+    }
+    ManualCommand cmd;
+    xQueuePeek(command_queue, &cmd, pdMS_TO_TICKS(ms));
+}
+
+String manual_control_get_stats_json() {
+    String json = "{";
+    json += "\"clients\":" + String(manual_ws.count()) + ",";
+    json += "\"commands\":" + String(command_count) + ",";
+    json += "\"rejected\":" + String(rejected_count) + ",";
+    json += "\"last_latency_us\":" + String(last_latency_us) + ",";
+    json += "\"max_latency_us\":" + String(max_latency_us) + ",";
+    json += "\"avg_latency_us\":" + String(command_count ? (unsigned long)(total_latency_us / command_count) : 0UL) + ",";
+    json += "\"running_mask\":" + String(running_mask()) + "}";
+    return json;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+
+class AsyncWebServer;
+
+// Manual pump control over a WebSocket (/api/manual) with a small binary protocol.
+// Frames are parsed on the web server task and queued; loop() executes them through
+// manual_control_process(), so motor I2C traffic stays on one task.
+//
+// Command frame (5 bytes, little endian):
+//   [0] op   [1] seq   [2] channel   [3..4] arg (uint16)
+// Channels: 0-4 fertilizer pumps, 5 watering pump, 6 humidifier pump.
+//
+// Ack frame (10 bytes), sent to the issuing client:
+//   [0] op | 0x80   [1] seq   [2] status   [3] channel
+//   [4..7] latency_us (uint32, frame received -> motor command issued)
+//   [8] running mask (bit n = channel n on)   [9] channel speed
+//
+// State frame (9 bytes), sent to all clients after every change:
+//   [0] 0x90   [1] running mask   [2..8] speed per channel
+
+enum ManualOp {
+    MANUAL_OP_START = 0x01,    // arg = speed (0 = configured fertilizer speed)
+    MANUAL_OP_STOP = 0x02,
+    MANUAL_OP_SPEED = 0x03,    // arg = speed, applied if running
+    MANUAL_OP_PULSE = 0x04,    // arg = run time in ms, at the last speed
+    MANUAL_OP_STOP_ALL = 0x05,
+    MANUAL_OP_PING = 0x06      // Ack only, for round-trip measurement
+};
+
+enum ManualStatus {
+    MANUAL_OK = 0,
+    MANUAL_BAD_FRAME = 1,
+    MANUAL_BAD_CHANNEL = 2,
+    MANUAL_QUEUE_FULL = 3,
+    MANUAL_BUSY = 4,           // Automatic dosing, calibration or a batch program owns the pumps
+    MANUAL_UNSUPPORTED = 5     // e.g. speed change on a fixed-speed pump
+};
+
+#define MANUAL_ACK_FLAG 0x80
+#define MANUAL_STATE_FRAME 0x90
+#define MANUAL_CHANNELS 7
+
+void manual_control_init(AsyncWebServer &server);
+void manual_control_process();
+// Sleep up to ms, returning as soon as a command is queued
+void manual_control_wait(unsigned long ms);
+String manual_control_get_stats_json();
@@ -0,0 +1,191 @@
+#include "metrics.h"
+#include "logger.h"
+#include "seqlock.h"
+#include "hal/clock.h"
+#include "hal/heap.h"
+#include "hal/motor.h"
+#include "config/config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Upper bucket bounds in microseconds; one more bucket catches everything above
+static const uint32_t bucket_bounds_us[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+#define BUCKET_COUNT (sizeof(bucket_bounds_us) / sizeof(bucket_bounds_us[0]) + 1)
+
+// Seqlock-guarded (seqlock.h). Buckets are not cumulative here.
+struct Histogram {
+    uint32_t sequence;
+    uint32_t buckets[BUCKET_COUNT];
+    uint32_t count;
+    uint64_t sum_us;
+};
+
+struct HttpRoute {
+    const char *method;
+    const char *path;
+};
+
+struct PumpRuntime {
+    uint32_t sequence;
+    uint64_t total_ms[HAL_MOTOR_COUNT];
+    uint32_t started_ms[HAL_MOTOR_COUNT];
+    bool running[HAL_MOTOR_COUNT];
+};
+
+static Histogram histograms[METRICS_HISTOGRAM_COUNT];
+static Histogram http_histograms[METRICS_HTTP_ROUTES];
+static HttpRoute http_routes[METRICS_HTTP_ROUTES];
+static int http_route_count = 0;
+static PumpRuntime pumps;
+
+static uint32_t nvs_commits = 0;
+static uint32_t wifi_reconnects = 0;
+static int wifi_rssi = 0;
+static bool wifi_rssi_set = false;
+
+static void observe(Histogram &h, uint32_t us) {
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && us > bucket_bounds_us[bucket]) bucket++;
+    seqlock_write_begin(h.sequence);
+    h.buckets[bucket]++;
+    h.count++;
+    h.sum_us += us;
+    seqlock_write_end(h.sequence);
+}
+
+void metrics_observe(MetricsHistogram histogram, uint32_t us) {
+    if (histogram < METRICS_HISTOGRAM_COUNT) observe(histograms[histogram], us);
+}
+
+int metrics_http_route(const char *method, const char *path) {
+    for (int i = 0; i < http_route_count; i++) {
+        if (strcmp(http_routes[i].method, method) == 0 && strcmp(http_routes[i].path, path) == 0) return i;
+    }
+    if (http_route_count >= METRICS_HTTP_ROUTES) return -1;
+    http_routes[http_route_count] = {method, path};
+    return http_route_count++;
+}
+
+void metrics_http_observe(int route, uint32_t us) {
+    if (route >= 0 && route < http_route_count) observe(http_histograms[route], us);
+}
+
+void metrics_count_nvs_commit() {
+    __atomic_fetch_add(&nvs_commits, 1, __ATOMIC_RELAXED);
+}
+
+void metrics_count_wifi_reconnect() {
+    __atomic_fetch_add(&wifi_reconnects, 1, __ATOMIC_RELAXED);
+}
+
+void metrics_set_wifi_rssi(int rssi) {
+    wifi_rssi = rssi;
+    wifi_rssi_set = true;
+}
+
+void metrics_pump_changed(int index, bool running) {
+    if (index < 0 || index >= HAL_MOTOR_COUNT || pumps.running[index] == running) return;
+    uint32_t now = hal_millis();
+    seqlock_write_begin(pumps.sequence);
+    if (running) {
+        pumps.started_ms[index] = now;
+    } else {
+        pumps.total_ms[index] += now - pumps.started_ms[index];
+    }
+    pumps.running[index] = running;
+    seqlock_write_end(pumps.sequence);
+}
+
+struct MetricsWriter {
+    char *buf;
+    size_t size;
+    size_t length;
+};
+
+static void append(MetricsWriter &w, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t remaining = w.length < w.size ? w.size - w.length : 0;
+    int written = vsnprintf(remaining ? w.buf + w.length : nullptr, remaining, format, args);
+    va_end(args);
+    if (written > 0) {
+        w.length += written;
+    }
+}
+
+static void header(MetricsWriter &w, const char *name, const char *type, const char *help) {
+    append(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metric(MetricsWriter &w, const char *name, const char *type, const char *help, unsigned long value) {
+    header(w, name, type, help);
+    append(w, "%s %lu\n", name, value);
+}
+
+// Sample lines of one histogram; labels is empty or `key="value",`
+static void histogram_samples(MetricsWriter &w, const char *name, const char *labels, const Histogram &source) {
+    Histogram h;
+    if (!seqlock_read(source.sequence, source, h)) return; // Held by the loop; the next scrape has it
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < BUCKET_COUNT - 1; i++) {
+        cumulative += h.buckets[i];
+        append(w, "%s_bucket{%sle=\"%g\"} %lu\n", name, labels, bucket_bounds_us[i] / 1e6, (unsigned long)cumulative);
+    }
+    append(w, "%s_bucket{%sle=\"+Inf\"} %lu\n", name, labels, (unsigned long)h.count);
+    if (*labels) {
+        // Drop the trailing comma for the plain samples
+        append(w, "%s_sum{%.*s} %.6f\n%s_count{%.*s} %lu\n", name, (int)strlen(labels) - 1, labels, h.sum_us / 1e6,
+               name, (int)strlen(labels) - 1, labels, (unsigned long)h.count);
+    } else {
+        append(w, "%s_sum %.6f\n%s_count %lu\n", name, h.sum_us / 1e6, name, (unsigned long)h.count);
+    }
+}
+
+static void histogram(MetricsWriter &w, const char *name, const char *help, MetricsHistogram id) {
+    header(w, name, "histogram", help);
+    histogram_samples(w, name, "", histograms[id]);
+}
+
+size_t metrics_build(char *buf, size_t size) {
+    MetricsWriter w = {buf, size, 0};
+    metric(w, "irrigation_uptime_seconds", "counter", "Seconds since boot", hal_millis() / 1000);
+    metric(w, "irrigation_heap_free_bytes", "gauge", "Free heap", (unsigned long)hal_heap_free());
+    metric(w, "irrigation_heap_min_free_bytes", "gauge", "Lowest free heap since boot", (unsigned long)hal_heap_min_free());
+    metric(w, "irrigation_heap_largest_free_block_bytes", "gauge", "Largest allocatable block",
+           (unsigned long)hal_heap_largest_block());
+    metric(w, "irrigation_log_queue_entries", "gauge", "Log entries waiting to be written", (unsigned long)logger_get_queue_count());
+    metric(w, "irrigation_log_written_total", "counter", "Log entries written", logger_get_written_count());
+    metric(w, "irrigation_log_dropped_total", "counter", "Log entries dropped on a full queue", logger_get_dropped_count());
+    metric(w, "irrigation_nvs_commits_total", "counter", "Blobs written to NVS",
+           __atomic_load_n(&nvs_commits, __ATOMIC_RELAXED));
+    metric(w, "irrigation_wifi_reconnects_total", "counter", "WiFi reconnect attempts",
+           __atomic_load_n(&wifi_reconnects, __ATOMIC_RELAXED));
+    if (wifi_rssi_set) {
+        header(w, "irrigation_wifi_rssi_dbm", "gauge", "WiFi signal strength");
+        append(w, "irrigation_wifi_rssi_dbm %d\n", wifi_rssi);
+    }
+
+    PumpRuntime p;
+    bool pumps_read = seqlock_read(pumps.sequence, pumps, p);
+    uint32_t now = hal_millis();
+    header(w, "irrigation_pump_runtime_seconds_total", "counter", "Time each motor channel has been running");
+    for (int i = 0; pumps_read && i < HAL_MOTOR_COUNT; i++) {
+        uint64_t ms = p.total_ms[i] + (p.running[i] ? now - p.started_ms[i] : 0);
+        append(w, "irrigation_pump_runtime_seconds_total{channel=\"%d\"} %.3f\n", i + 1, ms / 1000.0);
+    }
+
+    histogram(w, "irrigation_loop_duration_seconds", "Control loop pass time without the idle wait", METRICS_LOOP);
+    histogram(w, "irrigation_i2c_command_duration_seconds", "Motor shield command time", METRICS_I2C);
+    histogram(w, "irrigation_log_drain_duration_seconds", "Log queue write-out time per loop pass", METRICS_LOG_DRAIN);
+
+    // Routes that have not been requested yet are left out to keep the scrape small
+    header(w, "irrigation_http_handler_duration_seconds", "histogram", "Web handler time until the response is queued");
+    for (int i = 0; i < http_route_count; i++) {
+        if (__atomic_load_n(&http_histograms[i].count, __ATOMIC_RELAXED) == 0) continue;
+        char labels[96];
+        snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\",", http_routes[i].method, http_routes[i].path);
+        histogram_samples(w, "irrigation_http_handler_duration_seconds", labels, http_histograms[i]);
+    }
+    return w.length;
+}
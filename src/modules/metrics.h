@@ -0,0 +1,35 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Runtime metrics for /api/metrics, rendered in the Prometheus text format.
+//
+// Timings go into fixed-bucket histograms (microseconds in, seconds out). Each
+// histogram has one writer task (the control loop, or the web server task for
+// the HTTP routes); an observation is a handful of plain stores inside a
+// sequence counter, like the state snapshot, so the writer never waits and a
+// scrape retries instead of reading a half-updated histogram.
+
+enum MetricsHistogram : uint8_t {
+    METRICS_LOOP,         // Control loop pass, without the idle wait
+    METRICS_I2C,          // One motor shield command (I2C transfers)
+    METRICS_LOG_DRAIN,    // logger_process_queue() calls that wrote entries
+    METRICS_HISTOGRAM_COUNT
+};
+
+void metrics_observe(MetricsHistogram histogram, uint32_t us);
+
+// Register a web route during setup; returns its histogram index, or -1 once
+// METRICS_HTTP_ROUTES are in use. The strings are kept, not copied. Registering
+// the same route again returns the same index.
+int metrics_http_route(const char *method, const char *path);
+void metrics_http_observe(int route, uint32_t us);
+
+// Counters and gauges
+void metrics_count_nvs_commit();               // Any task
+void metrics_count_wifi_reconnect();
+void metrics_set_wifi_rssi(int rssi);          // dBm; reported once set
+void metrics_pump_changed(int index, bool running); // Control task; motor index 0-6
+
+// Body of /api/metrics. Returns the full length needed (snprintf semantics).
+size_t metrics_build(char *buf, size_t size);
@@ -1,20 +1,45 @@
 #include "motor_shield_control.h"
 #include "logger.h"
-#include <Wire.h>
-#include <Adafruit_MotorShield.h>
+#include "metrics.h"
+#include "trace_recorder.h"
+#include "hal/clock.h"
+#include "hal/motor.h"
 
-// Motor shield instances
-Adafruit_MotorShield motor_shield1 = Adafruit_MotorShield(0x60); // Main shield
-Adafruit_MotorShield motor_shield2 = Adafruit_MotorShield(0x61); // Extra shield
+// Commanded state, for status reporting
+static uint8_t motor_speed[7] = {0};
+static bool motor_running[7] = {false};
 
-// Motor pointers for up to 7 motors (4 on shield1, 3 on shield2)
-Adafruit_DCMotor *motors[7] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+// Shield commands: each is timed for /api/metrics and recorded in the trace
+static void shield_set_speed(int index, uint8_t speed) {
+    unsigned long start = hal_micros();
+    hal_motor_set_speed(index, speed);
+    metrics_observe(METRICS_I2C, hal_micros() - start);
+    trace_record_motor(index, TRACE_MOTOR_SPEED, speed);
+}
 
-void motor_shield_init() {
-    Wire.begin();
+static void shield_forward(int index) {
+    unsigned long start = hal_micros();
+    hal_motor_forward(index);
+    metrics_observe(METRICS_I2C, hal_micros() - start);
+    trace_record_motor(index, TRACE_MOTOR_FORWARD, 0);
+}
+
+static void shield_release(int index) {
+    unsigned long start = hal_micros();
+    hal_motor_release(index);
+    metrics_observe(METRICS_I2C, hal_micros() - start);
+    trace_record_motor(index, TRACE_MOTOR_RELEASE, 0);
+}
+
+static void set_running(int index, bool running) {
+    motor_running[index] = running;
+    metrics_pump_changed(index, running);
+}
 
-    bool shield1_ok = motor_shield1.begin();
-    bool shield2_ok = motor_shield2.begin();
+void motor_shield_init() {
+    uint8_t found = hal_motor_begin();
+    bool shield1_ok = found & HAL_MOTOR_SHIELD_MAIN;
+    bool shield2_ok = found & HAL_MOTOR_SHIELD_EXTRA;
 
     if (!shield1_ok) {
         logger_log("ERROR: Motor Shield 1 (0x60) not found - check wiring");
@@ -27,19 +52,9 @@ void motor_shield_init() {
         return;
     }
 
-    // Initialize motor pointers (motors 1-4 on shield1)
-    for (int i = 0; i < 4; i++) {
-        motors[i] = shield1_ok ? motor_shield1.getMotor(i + 1) : nullptr;
-        if (motors[i]) {
-            motors[i]->run(RELEASE);
-        }
-    }
-    // Initialize motor pointers (motors 1-3 on shield2)
-    for (int i = 0; i < 3; i++) {
-        motors[4 + i] = shield2_ok ? motor_shield2.getMotor(i + 1) : nullptr;
-        if (motors[4 + i]) {
-            motors[4 + i]->run(RELEASE);
-        }
+    // Motors 1-4 are on shield1, 5-7 on shield2
+    for (int i = 0; i < HAL_MOTOR_COUNT; i++) {
+        hal_motor_release(i);
     }
 
     logger_log("Motor shields initialized successfully");
@@ -54,10 +69,11 @@ void set_motor_speed(int motor_number, int speed) {
     if (speed > 255) speed = 255;
 
     int motor_index = motor_number - 1;
-    if (motors[motor_index]) {
-        motors[motor_index]->setSpeed(speed);
+    if (hal_motor_present(motor_index)) {
+        shield_set_speed(motor_index, speed);
+        motor_speed[motor_index] = speed;
         // Add delay to ensure I2C command is processed
-        delay(50);
+        hal_delay(50);
         
         String log_msg = "Motor " + String(motor_number) + " speed set to " + String(speed);
         logger_log(log_msg.c_str());
@@ -70,10 +86,11 @@ void run_motor_forward(int motor_number) {
     }
 
     int motor_index = motor_number - 1;
-    if (motors[motor_index]) {
-        motors[motor_index]->run(FORWARD);
+    if (hal_motor_present(motor_index)) {
+        shield_forward(motor_index);
+        set_running(motor_index, true);
         // Add delay to ensure I2C command is processed
-        delay(50);
+        hal_delay(50);
         
         String log_msg = "Motor " + String(motor_number) + " started";
         logger_log(log_msg.c_str());
@@ -86,10 +103,11 @@ void stop_motor(int motor_number) {
     }
 
     int motor_index = motor_number - 1;
-    if (motors[motor_index]) {
-        motors[motor_index]->run(RELEASE);
+    if (hal_motor_present(motor_index)) {
+        shield_release(motor_index);
+        set_running(motor_index, false);
         // Add delay to ensure I2C command is processed
-        delay(50);
+        hal_delay(50);
         
         String log_msg = "Motor " + String(motor_number) + " stopped";
         logger_log(log_msg.c_str());
@@ -98,9 +116,38 @@ void stop_motor(int motor_number) {
 
 void stop_all_motors() {
     logger_log("Stopping all motors");
-    for (int i = 0; i < 7; i++) {
-        if (motors[i]) {
-            motors[i]->run(RELEASE);
+    for (int i = 0; i < HAL_MOTOR_COUNT; i++) {
+        shield_release(i);
+        set_running(i, false);
+    }
+}
+
+void motor_command(int motor_number, int speed) {
+    if (motor_number < 1 || motor_number > 7) {
+        return; // Invalid motor number
+    }
+
+    if (speed < 0) speed = 0;
+    if (speed > 255) speed = 255;
+
+    int motor_index = motor_number - 1;
+    if (hal_motor_present(motor_index)) {
+        // Wire transfers are synchronous, so no settle delay is needed here
+        if (speed == 0) {
+            shield_release(motor_index);
+        } else {
+            shield_set_speed(motor_index, speed);
+            shield_forward(motor_index);
+            motor_speed[motor_index] = speed;
         }
+        set_running(motor_index, speed > 0);
+    }
+}
+
+int get_motor_speed(int motor_number) {
+    if (motor_number < 1 || motor_number > 7) {
+        return 0;
     }
+    int motor_index = motor_number - 1;
+    return motor_running[motor_index] ? motor_speed[motor_index] : 0;
 }
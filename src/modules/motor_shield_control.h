@@ -1,12 +1,14 @@
 #ifndef MOTOR_SHIELD_CONTROL_H
 #define MOTOR_SHIELD_CONTROL_H
 
-#include <Adafruit_MotorShield.h>
-
 void motor_shield_init();
 void set_motor_speed(int motor_number, int speed);
 void run_motor_forward(int motor_number);
 void stop_motor(int motor_number);
 void stop_all_motors();
+// Set speed and direction in one go without the settle delays; speed 0 releases the motor
+void motor_command(int motor_number, int speed);
+// Last commanded speed of a running motor, 0 when stopped
+int get_motor_speed(int motor_number);
 
 #endif // MOTOR_SHIELD_CONTROL_H
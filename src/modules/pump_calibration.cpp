@@ -0,0 +1,242 @@
+#include "pump_calibration.h"
+#include "motor_shield_control.h"
+#include "logger.h"
+#include "settings_store.h"
+#include <Arduino.h>
+#include "hal/clock.h"
+#include <ArduinoJson.h>
+#include "config/config.h"
+
+extern float pump_calibration[NUM_FERTILIZERS];
+extern float pump_curve[NUM_FERTILIZERS][CAL_CURVE_POINTS];
+extern unsigned long pump_spinup_ms[NUM_FERTILIZERS];
+extern int fertilizer_motor_speed;
+
+const int cal_curve_duty[CAL_CURVE_POINTS] = CAL_CURVE_DUTIES;
+
+#define SPINUP_POINT CAL_CURVE_POINTS // Index of the short full-duty run
+
+// Guided calibration session (one pump at a time)
+static int session_pump = -1;
+static float measured_ml[CAL_CURVE_POINTS + 1];
+static bool measured[CAL_CURVE_POINTS + 1];
+static int running_point = -1;
+static unsigned long running_end_time = 0;
+
+bool pump_calibration_has_curve(int pump) {
+    if (pump < 0 || pump >= NUM_FERTILIZERS) {
+        return false;
+    }
+    for (int i = 0; i < CAL_CURVE_POINTS; i++) {
+        if (pump_curve[pump][i] <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float pump_calibration_rate(int pump, int speed) {
+    if (pump < 0 || pump >= NUM_FERTILIZERS) {
+        return 1.0;
+    }
+    if (!pump_calibration_has_curve(pump)) {
+        return pump_calibration[pump] > 0 ? pump_calibration[pump] : 1.0;
+    }
+
+    const float *curve = pump_curve[pump];
+    float rate;
+    if (speed <= cal_curve_duty[0]) {
+        // Below the first point, scale towards zero flow at zero duty
+        rate = curve[0] * speed / cal_curve_duty[0];
+    } else if (speed >= cal_curve_duty[CAL_CURVE_POINTS - 1]) {
+        rate = curve[CAL_CURVE_POINTS - 1];
+    } else {
+        int i = 1;
+        while (speed > cal_curve_duty[i]) i++;
+        float t = (float)(speed - cal_curve_duty[i - 1]) / (cal_curve_duty[i] - cal_curve_duty[i - 1]);
+        rate = curve[i - 1] + t * (curve[i] - curve[i - 1]);
+    }
+    return rate > 0.001f ? rate : 0.001f;
+}
+
+// Near full duty a peristaltic pump starts to slip: extra duty adds little
+// flow, and what it delivers follows load and supply voltage rather than duty.
+// Walk the curve while each segment still gains a fair share of flow per duty
+// step compared with the first point.
+int pump_calibration_fastest_accurate_speed(int pump) {
+    if (!pump_calibration_has_curve(pump)) {
+        return 0;
+    }
+    const float *curve = pump_curve[pump];
+    float base_gain = curve[0] / cal_curve_duty[0];
+    int fastest = cal_curve_duty[0];
+    for (int i = 1; i < CAL_CURVE_POINTS; i++) {
+        float gain = (curve[i] - curve[i - 1]) / (cal_curve_duty[i] - cal_curve_duty[i - 1]);
+        if (gain < CAL_MIN_FLOW_GAIN * base_gain) {
+            break;
+        }
+        fastest = cal_curve_duty[i];
+    }
+    return fastest;
+}
+
+int pump_calibration_fastest_accurate_speed_all() {
+    int fastest = 0;
+    for (int p = 0; p < NUM_FERTILIZERS; p++) {
+        int speed = pump_calibration_fastest_accurate_speed(p);
+        if (speed > 0 && (fastest == 0 || speed < fastest)) {
+            fastest = speed;
+        }
+    }
+    return fastest;
+}
+
+unsigned long pump_calibration_spinup_ms(int pump) {
+    if (!pump_calibration_has_curve(pump)) {
+        return 0;
+    }
+    return pump_spinup_ms[pump];
+}
+
+static void reset_session(int pump) {
+    session_pump = pump;
+    for (int i = 0; i <= CAL_CURVE_POINTS; i++) {
+        measured[i] = false;
+        measured_ml[i] = 0;
+    }
+}
+
+bool pump_calibration_start_point(int pump, int point) {
+    if (pump < 0 || pump >= NUM_FERTILIZERS || point < 0 || point > SPINUP_POINT || running_point >= 0) {
+        return false;
+    }
+    if (pump != session_pump) {
+        reset_session(pump);
+    }
+
+    int duty = point == SPINUP_POINT ? cal_curve_duty[CAL_CURVE_POINTS - 1] : cal_curve_duty[point];
+    unsigned long run_ms = point == SPINUP_POINT ? CAL_SHORT_RUN_MS : CAL_RUN_MS;
+    int motor_num = pump + 1;
+    set_motor_speed(motor_num, duty);
+    run_motor_forward(motor_num);
+    // Start timing after the motor command so I2C latency is not counted
+    running_end_time = hal_millis() + run_ms;
+    running_point = point;
+
+    String log_msg = "Calibration: pump " + String(pump) + " point " + String(point) + " running at duty " +
+                     String(duty) + " for " + String(run_ms) + " ms";
+    logger_log(log_msg.c_str());
+    return true;
+}
+
+void pump_calibration_run() {
+    if (running_point >= 0 && hal_millis() > running_end_time) {
+        stop_motor(session_pump + 1);
+        String log_msg = "Calibration: pump " + String(session_pump) + " point " + String(running_point) +
+                         " done - measure the output and submit it";
+        logger_log(log_msg.c_str());
+        running_point = -1;
+    }
+}
+
+bool pump_calibration_is_running() {
+    return running_point >= 0;
+}
+
+bool pump_calibration_measure(int pump, int point, float ml) {
+    if (pump != session_pump || point < 0 || point > SPINUP_POINT || ml <= 0) {
+        return false;
+    }
+    measured_ml[point] = ml;
+    measured[point] = true;
+    return true;
+}
+
+bool pump_calibration_finish(int pump) {
+    if (pump != session_pump || running_point >= 0) {
+        return false;
+    }
+    for (int i = 0; i < CAL_CURVE_POINTS; i++) {
+        if (!measured[i]) {
+            return false;
+        }
+    }
+
+    // Spin-up: compare the long and short run at full duty. The difference is
+    // steady-state flow; whatever the long run lacks against that is dead time.
+    float spinup_ms = 0;
+    if (measured[SPINUP_POINT]) {
+        float long_ml = measured_ml[CAL_CURVE_POINTS - 1];
+        float short_ml = measured_ml[SPINUP_POINT];
+        float steady_rate = (long_ml - short_ml) * 1000.0f / (CAL_RUN_MS - CAL_SHORT_RUN_MS);
+        if (steady_rate > 0) {
+            spinup_ms = CAL_RUN_MS - long_ml * 1000.0f / steady_rate;
+        }
+        if (spinup_ms < 0) spinup_ms = 0;
+        if (spinup_ms > CAL_MAX_SPINUP_MS) spinup_ms = CAL_MAX_SPINUP_MS;
+    }
+
+    for (int i = 0; i < CAL_CURVE_POINTS; i++) {
+        pump_curve[pump][i] = measured_ml[i] * 1000.0f / (CAL_RUN_MS - spinup_ms);
+    }
+    pump_spinup_ms[pump] = (unsigned long)spinup_ms;
+    // Keep the single-value calibration in step with the current speed
+    pump_calibration[pump] = pump_calibration_rate(pump, fertilizer_motor_speed);
+    settings_mark_dirty(SETTING_CALIBRATION | SETTING_CALIBRATION_CURVE);
+
+    String log_msg = "Calibration: pump " + String(pump) + " curve saved, spin-up " + String(pump_spinup_ms[pump]) +
+                     " ms, fastest accurate speed " + String(pump_calibration_fastest_accurate_speed(pump));
+    logger_log(log_msg.c_str());
+    session_pump = -1;
+    return true;
+}
+
+void pump_calibration_cancel() {
+    if (running_point >= 0) {
+        stop_motor(session_pump + 1);
+        running_point = -1;
+    }
+    session_pump = -1;
+    logger_log("Calibration session cancelled");
+}
+
+String pump_calibration_get_json() {
+    DynamicJsonDocument doc(2048);
+    JsonArray duties = doc.createNestedArray("duties");
+    for (int i = 0; i < CAL_CURVE_POINTS; i++) {
+        duties.add(cal_curve_duty[i]);
+    }
+    doc["run_ms"] = CAL_RUN_MS;
+    doc["short_run_ms"] = CAL_SHORT_RUN_MS;
+    doc["fertilizer_motor_speed"] = fertilizer_motor_speed;
+    doc["fastest_accurate_speed"] = pump_calibration_fastest_accurate_speed_all();
+
+    JsonArray pumps = doc.createNestedArray("pumps");
+    for (int p = 0; p < NUM_FERTILIZERS; p++) {
+        JsonObject pump = pumps.createNestedObject();
+        pump["calibrated"] = pump_calibration_has_curve(p);
+        JsonArray curve = pump.createNestedArray("curve");
+        for (int i = 0; i < CAL_CURVE_POINTS; i++) {
+            curve.add(pump_curve[p][i]);
+        }
+        pump["spinup_ms"] = pump_spinup_ms[p];
+        pump["rate_at_speed"] = pump_calibration_rate(p, fertilizer_motor_speed);
+        pump["fastest_accurate_speed"] = pump_calibration_fastest_accurate_speed(p);
+    }
+
+    JsonObject session = doc.createNestedObject("session");
+    session["pump"] = session_pump;
+    session["running_point"] = running_point;
+    JsonArray done = session.createNestedArray("measured");
+    for (int i = 0; i <= CAL_CURVE_POINTS; i++) {
+        if (measured[i] && session_pump >= 0) {
+            done.add(measured_ml[i]);
+        } else {
+            done.add(nullptr);
+        }
+    }
+
+    String response;
+    serializeJson(doc, response);
+    return response;
+}
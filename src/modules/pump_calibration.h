@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "config/config.h"
+
+// Speed-dependent calibration of the fertilizer pumps.
+// Each pump has a curve of ml/s at CAL_CURVE_DUTIES plus a spin-up correction;
+// pumps without a curve fall back to the single pump_calibration[] value.
+
+extern const int cal_curve_duty[CAL_CURVE_POINTS];
+
+// Flow rate (ml/s) of a fertilizer pump at the given motor speed
+float pump_calibration_rate(int pump, int speed);
+unsigned long pump_calibration_spinup_ms(int pump);
+bool pump_calibration_has_curve(int pump);
+// Highest curve duty before the pump starts to slip (0 without a curve)
+int pump_calibration_fastest_accurate_speed(int pump);
+// Lowest of the above over all calibrated pumps, as they share one speed (0 if none)
+int pump_calibration_fastest_accurate_speed_all();
+
+// Guided calibration: run each point, then report the measured volume.
+// Point CAL_CURVE_POINTS is the short full-duty run used for the spin-up estimate.
+bool pump_calibration_start_point(int pump, int point);
+bool pump_calibration_measure(int pump, int point, float ml);
+bool pump_calibration_finish(int pump);
+void pump_calibration_cancel();
+void pump_calibration_run();
+bool pump_calibration_is_running();
+
+String pump_calibration_get_json();
@@ -1,7 +1,10 @@
 #include "pump_control.h"
 #include "motor_shield_control.h"
 #include "logger.h"
+#include "flow_meter.h"
+#include "pump_calibration.h"
 #include <Arduino.h>
+#include "hal/clock.h"
 #include "config/config.h"
 #include <time.h>
 
@@ -26,14 +29,28 @@ static unsigned long humidifier_pump_end_time = 0;
 // Watering pump state
 bool watering_pump_active = false;
 static unsigned long watering_pump_end_time = 0;
+static unsigned long watering_pump_start_time = 0;
+static time_t watering_pump_start_epoch = 0;
+static float watering_target_ml = 0; // 0 = time-based run
+
+// Stall detection window
+static unsigned long stall_window_start = 0;
+static float stall_window_volume = 0;
+
+// Recent watering runs (ring buffer, newest at watering_run_next - 1)
+static WateringRun watering_runs[WATERING_RUN_HISTORY];
+static int watering_run_next = 0;
+static int watering_run_count = 0;
 
 unsigned long ml_to_runtime(int pump, float ml) {
-    float cal = (pump >= 0 && pump < NUM_FERTILIZERS && pump_calibration[pump] > 0) ? pump_calibration[pump] : 1.0;
-    return (unsigned long)(ml * 1000 / cal);
+    // Flow at the configured speed from the pump's curve (or its single calibration value),
+    // plus the time the pump needs to spin up before it delivers at that rate
+    float cal = pump_calibration_rate(pump, fertilizer_motor_speed);
+    return (unsigned long)(ml * 1000 / cal) + pump_calibration_spinup_ms(pump);
 }
 
 int get_current_day_of_week() {
-    time_t now = time(nullptr);
+    time_t now = hal_time();
     struct tm timeinfo;
     if (localtime_r(&now, &timeinfo)) {
         return timeinfo.tm_wday; // 0=Sunday, 1=Monday, ..., 6=Saturday
@@ -76,7 +93,7 @@ bool start_fertilizer_dosing() {
             pump_running[dosing_stage] = true;
             
             // Set end time AFTER starting the motor to account for I2C delays
-            dosing_end_time = millis() + ml_to_runtime(dosing_stage, current_ml);
+            dosing_end_time = hal_millis() + ml_to_runtime(dosing_stage, current_ml);
             
             String log_msg = "Fertilizer pump " + String(dosing_stage) + " started - dosing " + String(current_ml) + " ml";
             logger_log(log_msg.c_str());
@@ -103,7 +120,7 @@ void pump_control_run_humidifier_pump(unsigned long ms) {
     set_motor_speed(humidifier_motor, MAX_MOTOR_SPEED);
     run_motor_forward(humidifier_motor);
     humidifier_pump_active = true;
-    humidifier_pump_end_time = millis() + ms;
+    humidifier_pump_end_time = hal_millis() + ms;
     
     String log_msg = "Humidifier pump started - running for " + String(ms) + " ms";
     logger_log(log_msg.c_str());
@@ -116,22 +133,108 @@ void pump_control_stop_humidifier_pump() {
     logger_log("Humidifier pump stopped");
 }
 
-void pump_control_run_watering_pump(unsigned long ms) {
+static void start_watering_run(unsigned long ms, float target_ml) {
+    flow_meter_reset();
     int watering_motor = WATERING_PUMP_CHANNEL;  // Motor 6 for watering pump
     set_motor_speed(watering_motor, MAX_MOTOR_SPEED);
     run_motor_forward(watering_motor);
     watering_pump_active = true;
-    watering_pump_end_time = millis() + ms;
-    
-    String log_msg = "Watering pump started - running for " + String(ms) + " ms";
-    logger_log(log_msg.c_str());
+    watering_pump_start_time = hal_millis();
+    watering_pump_start_epoch = hal_time();
+    watering_pump_end_time = watering_pump_start_time + ms;
+    watering_target_ml = target_ml;
+    stall_window_start = watering_pump_start_time;
+    stall_window_volume = 0;
 }
 
-void pump_control_stop_watering_pump() {
+// Stop the watering pump and record the run
+static void finish_watering_run(WateringRunResult result) {
     int watering_motor = WATERING_PUMP_CHANNEL;  // Motor 6 for watering pump
     stop_motor(watering_motor);
     watering_pump_active = false;
-    logger_log("Watering pump stopped");
+
+    WateringRun *run = &watering_runs[watering_run_next];
+    run->start_time = watering_pump_start_epoch;
+    run->duration_ms = hal_millis() - watering_pump_start_time;
+    run->volume_ml = flow_meter_get_volume_ml();
+    run->target_ml = watering_target_ml;
+    run->result = result;
+    watering_run_next = (watering_run_next + 1) % WATERING_RUN_HISTORY;
+    if (watering_run_count < WATERING_RUN_HISTORY) watering_run_count++;
+
+    String log_msg = "Watering pump stopped (" + String(watering_run_result_name(result)) + ") after " +
+                     String(run->duration_ms) + " ms";
+    if (flow_meter_is_available()) {
+        log_msg += " - delivered " + String(run->volume_ml, 0) + " ml";
+    }
+    logger_log(log_msg.c_str());
+}
+
+void pump_control_run_watering_pump(unsigned long ms) {
+    start_watering_run(ms, 0);
+    String log_msg = "Watering pump started - running for " + String(ms) + " ms";
+    logger_log(log_msg.c_str());
+}
+
+void pump_control_run_watering_pump_volume(float target_ml, unsigned long max_ms) {
+    start_watering_run(max_ms, target_ml);
+    String log_msg = "Watering pump started - delivering " + String(target_ml, 0) + " ml (max " + String(max_ms) + " ms)";
+    logger_log(log_msg.c_str());
+}
+
+void pump_control_stop_watering_pump() {
+    if (watering_pump_active) {
+        finish_watering_run(WATERING_RUN_STOPPED);
+    } else {
+        int watering_motor = WATERING_PUMP_CHANNEL;  // Motor 6 for watering pump
+        stop_motor(watering_motor);
+        logger_log("Watering pump stopped");
+    }
+}
+
+// Returns true if the watering line has stopped delivering water
+static bool watering_line_stalled() {
+    if (!flow_meter_is_available()) {
+        return false;
+    }
+    unsigned long now = hal_millis();
+    if (now - watering_pump_start_time < FLOW_STALL_GRACE_MS || now - stall_window_start < FLOW_STALL_WINDOW_MS) {
+        return false;
+    }
+    float volume = flow_meter_get_volume_ml();
+    float rate_ml_per_s = (volume - stall_window_volume) * 1000.0f / (now - stall_window_start);
+    stall_window_start = now;
+    stall_window_volume = volume;
+    if (rate_ml_per_s < FLOW_STALL_MIN_ML_PER_S) {
+        String log_msg = "[SAFETY] Watering line stalled - flow " + String(rate_ml_per_s, 1) + " ml/s";
+        logger_log(log_msg.c_str());
+        return true;
+    }
+    return false;
+}
+
+float pump_control_get_watering_volume_ml() {
+    return flow_meter_get_volume_ml();
+}
+
+int pump_control_get_watering_runs(WateringRun *runs, int max_runs) {
+    int n = watering_run_count < max_runs ? watering_run_count : max_runs;
+    for (int i = 0; i < n; i++) {
+        int idx = (watering_run_next - 1 - i + WATERING_RUN_HISTORY) % WATERING_RUN_HISTORY;
+        runs[i] = watering_runs[idx];
+    }
+    return n;
+}
+
+const char *watering_run_result_name(WateringRunResult result) {
+    switch (result) {
+        case WATERING_RUN_COMPLETED: return "completed";
+        case WATERING_RUN_TARGET_REACHED: return "target_reached";
+        case WATERING_RUN_TIMEOUT: return "timeout";
+        case WATERING_RUN_STALLED: return "stalled";
+        case WATERING_RUN_STOPPED: return "stopped";
+    }
+    return "unknown";
 }
 
 void pump_control_init() {
@@ -148,18 +251,24 @@ void pump_control_init() {
 
 void pump_control_run() {
     // Humidifier pump logic
-    if (humidifier_pump_active && millis() > humidifier_pump_end_time) {
+    if (humidifier_pump_active && hal_millis() > humidifier_pump_end_time) {
         pump_control_stop_humidifier_pump();
     }
     
     // Watering pump logic
-    if (watering_pump_active && millis() > watering_pump_end_time) {
-        pump_control_stop_watering_pump();
+    if (watering_pump_active) {
+        if (watering_target_ml > 0 && flow_meter_get_volume_ml() >= watering_target_ml) {
+            finish_watering_run(WATERING_RUN_TARGET_REACHED);
+        } else if (hal_millis() > watering_pump_end_time) {
+            finish_watering_run(watering_target_ml > 0 ? WATERING_RUN_TIMEOUT : WATERING_RUN_COMPLETED);
+        } else if (watering_line_stalled()) {
+            finish_watering_run(WATERING_RUN_STALLED);
+        }
     }
     
     // Dosing sequence
     if (dosing_stage >= 0 && dosing_stage < NUM_FERTILIZERS) {
-        if (millis() > dosing_end_time) {
+        if (hal_millis() > dosing_end_time) {
             int motor_num = dosing_stage + 1;  // Convert pump index to motor number (1-5)
             stop_motor(motor_num);
             
@@ -181,7 +290,7 @@ void pump_control_run() {
                     pump_running[dosing_stage] = true;
                     
                     // Set end time AFTER starting the motor to account for I2C delays
-                    dosing_end_time = millis() + ml_to_runtime(dosing_stage, current_ml);
+                    dosing_end_time = hal_millis() + ml_to_runtime(dosing_stage, current_ml);
                     
                     String log_msg = "Fertilizer pump " + String(dosing_stage) + " started - dosing " + String(current_ml) + " ml";
                     logger_log(log_msg.c_str());
@@ -203,10 +312,39 @@ void pump_control_run() {
     }
 }
 
+void pump_control_abort_dosing() {
+    if (dosing_stage < 0) {
+        return;
+    }
+    if (dosing_stage < NUM_FERTILIZERS) {
+        stop_motor(dosing_stage + 1);
+        pump_running[dosing_stage] = false;
+    }
+    String log_msg = "Fertilizer dosing aborted at pump " + String(dosing_stage);
+    logger_log(log_msg.c_str());
+    dosing_stage = -1;
+}
+
 bool pump_control_is_dosing() {
     return dosing_stage >= 0;
 }
 
+int pump_control_get_dosing_stage() {
+    return dosing_stage;
+}
+
+unsigned long pump_control_get_dosing_end_ms() {
+    return dosing_end_time;
+}
+
+unsigned long pump_control_get_humidifier_end_ms() {
+    return humidifier_pump_end_time;
+}
+
+unsigned long pump_control_get_watering_end_ms() {
+    return watering_pump_end_time;
+}
+
 int get_fertilizer_motor_speed() {
     return fertilizer_motor_speed;
 }
\ No newline at end of file
@@ -1,5 +1,22 @@
 #pragma once
 #include "config/config.h"
+#include <time.h>
+
+enum WateringRunResult {
+    WATERING_RUN_COMPLETED,      // Time-based run finished
+    WATERING_RUN_TARGET_REACHED, // Volume target delivered
+    WATERING_RUN_TIMEOUT,        // Volume target not reached within the time limit
+    WATERING_RUN_STALLED,        // Flow dropped below FLOW_STALL_MIN_ML_PER_S
+    WATERING_RUN_STOPPED         // Stopped manually
+};
+
+struct WateringRun {
+    time_t start_time;
+    unsigned long duration_ms;
+    float volume_ml;   // Delivered volume (0 without flow meter)
+    float target_ml;   // 0 for time-based runs
+    WateringRunResult result;
+};
 
 void pump_control_init();
 void pump_control_run();
@@ -8,9 +25,18 @@ unsigned long ml_to_runtime(int pump, float ml);
 void pump_control_run_humidifier_pump(unsigned long ms);
 void pump_control_stop_humidifier_pump();
 void pump_control_run_watering_pump(unsigned long ms);
+void pump_control_run_watering_pump_volume(float target_ml, unsigned long max_ms);
 void pump_control_stop_watering_pump();
 bool pump_control_is_dosing();
+void pump_control_abort_dosing();
+int pump_control_get_dosing_stage(); // -1 when not dosing
+unsigned long pump_control_get_dosing_end_ms();
+unsigned long pump_control_get_humidifier_end_ms();
+unsigned long pump_control_get_watering_end_ms();
 int get_fertilizer_motor_speed();
 int get_current_day_of_week();
 float get_current_dosing_ml(int fertilizer_index);
-bool is_watering_enabled_today(); 
\ No newline at end of file
+bool is_watering_enabled_today();
+float pump_control_get_watering_volume_ml();
+int pump_control_get_watering_runs(WateringRun *runs, int max_runs);
+const char *watering_run_result_name(WateringRunResult result);
@@ -0,0 +1,100 @@
+#include "response_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RESPONSE_CACHE_INITIAL_SIZE 256
+
+struct CacheEntry {
+    bool valid;
+    uint64_t version;
+    char *body;
+    size_t capacity;
+    size_t length;
+    char etag[40];
+};
+
+static CacheEntry entries[RC_SLOT_COUNT];
+static unsigned long cache_hits = 0;
+static unsigned long cache_misses = 0;
+static uint32_t boot_id = 0;
+
+void response_cache_init(uint32_t id) {
+    boot_id = id;
+    response_cache_clear();
+}
+
+static bool ensure_capacity(CacheEntry &entry, size_t needed) {
+    if (entry.capacity >= needed) {
+        return true;
+    }
+    size_t capacity = entry.capacity ? entry.capacity : RESPONSE_CACHE_INITIAL_SIZE;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    char *body = (char *)realloc(entry.body, capacity);
+    if (!body) {
+        return false;
+    }
+    entry.body = body;
+    entry.capacity = capacity;
+    return true;
+}
+
+bool response_cache_get(ResponseCacheSlot slot, uint64_t version, ResponseBuilder builder, CachedResponse &out) {
+    if (slot < 0 || slot >= RC_SLOT_COUNT) {
+        return false;
+    }
+    CacheEntry &entry = entries[slot];
+
+    if (entry.valid && entry.version == version) {
+        cache_hits++;
+    } else {
+        cache_misses++;
+        entry.valid = false;
+        if (!ensure_capacity(entry, RESPONSE_CACHE_INITIAL_SIZE)) {
+            return false;
+        }
+        size_t length = builder(entry.body, entry.capacity);
+        if (length >= entry.capacity) {
+            // First pass was truncated - grow and render again
+            if (!ensure_capacity(entry, length + 1)) {
+                return false;
+            }
+            length = builder(entry.body, entry.capacity);
+        }
+        entry.length = length;
+        entry.version = version;
+        snprintf(entry.etag, sizeof(entry.etag), "\"%08lx-%x-%llx\"", (unsigned long)boot_id, (unsigned)slot,
+                 (unsigned long long)version);
+        entry.valid = true;
+    }
+
+    out.body = entry.body;
+    out.length = entry.length;
+    out.etag = entry.etag;
+    return true;
+}
+
+bool response_cache_etag_matches(const char *if_none_match, const char *etag) {
+    if (!if_none_match || !etag) {
+        return false;
+    }
+    // Accept a single tag, a weak tag or a comma separated list
+    const char *found = strstr(if_none_match, etag);
+    return found != nullptr || strcmp(if_none_match, "*") == 0;
+}
+
+void response_cache_clear() {
+    for (int i = 0; i < RC_SLOT_COUNT; i++) {
+        entries[i].valid = false;
+    }
+}
+
+unsigned long response_cache_get_hits() {
+    return cache_hits;
+}
+
+unsigned long response_cache_get_misses() {
+    return cache_misses;
+}
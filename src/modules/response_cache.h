@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Small per-endpoint cache of rendered GET responses. Each slot keeps the last body
+// together with the version it was built for; a request with the same version is
+// served from the cache, a newer version rebuilds the body once.
+// Only used from the web server task, so no locking is done here.
+
+enum ResponseCacheSlot {
+    RC_CONFIG,
+    RC_WEEKLY_DOSING,
+    RC_WEEKLY_WATERING,
+    RC_SCHEDULE,
+    RC_CALIBRATION,
+    RC_MOTOR_SPEED,
+    RC_WATERING_DURATION,
+    RC_STATUS,
+    RC_SLOT_COUNT
+};
+
+// Render a body into buf. Returns the full length needed (snprintf semantics),
+// so the cache can grow the buffer and call again if it was too small.
+typedef size_t (*ResponseBuilder)(char *buf, size_t size);
+
+struct CachedResponse {
+    const char *body;
+    size_t length;
+    const char *etag; // Quoted, ready for the ETag header
+};
+
+// Versions restart with every boot, so ETags also carry a random id per boot;
+// a tag a browser kept from before a restart never matches. Call before serving.
+void response_cache_init(uint32_t boot_id);
+
+bool response_cache_get(ResponseCacheSlot slot, uint64_t version, ResponseBuilder builder, CachedResponse &out);
+
+// True if an If-None-Match header value matches the etag
+bool response_cache_etag_matches(const char *if_none_match, const char *etag);
+
+void response_cache_clear();
+unsigned long response_cache_get_hits();
+unsigned long response_cache_get_misses();
@@ -1,54 +1,217 @@
 #include "scheduler.h"
 #include "logger.h"
+#include "metrics.h"
+#include "trace_recorder.h"
+#include "time_sync.h"
 #include <Arduino.h>
+#include "hal/clock.h"
+#include "hal/prefs.h"
 #include "config/config.h"
-#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
-extern float dosing_ml[NUM_FERTILIZERS];
-extern int schedule_hour;
-extern int schedule_minute;
+#define SCHEDULER_NAMESPACE "sched"
+#define ON_TIME_S 60             // Always in the window, even with catch-up off (the old minute match)
+#define FUTURE_RUN_LIMIT_S 86400 // A stored run further ahead than this was made with a wrong clock
 
-unsigned long last_run = 0;
-bool has_run_today = false;
+extern ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS];
+extern unsigned long schedule_catchup_s;
+
+// Slot time of the last run, also kept in NVS
+static time_t last_run_slot = 0;
+// Slot time of the next run, 0 = no slot is used
+static time_t next_run = 0;
+// Nothing to do while now - quiet_from < quiet_s. A step back wraps the
+// unsigned difference, so it also ends the quiet time.
+static time_t quiet_from = 0;
+static uint32_t quiet_s = 0;
+// Work out next_run at the next check. The first plan after boot also looks
+// back for a slot missed while the device was off.
+static bool replan = true;
+static bool catch_up = true;
 
 void trigger_dosing(); // Implemented in main.cpp
 
-void scheduler_init() {
-    last_run = 0;
-    has_run_today = false;
-    configTime(0, 0, "pool.ntp.org");
-    logger_log("Scheduler initialized - waiting for NTP sync");
-    time_t now = 0;
-    int retries = 0;
-    while (now < 8 * 3600 * 2 && retries < 20) {
-        delay(500);
-        now = time(nullptr);
-        retries++;
-    }
-    if (now < 8 * 3600 * 2) {
-        logger_log("WARNING: NTP sync failed - scheduling may be inaccurate");
-    } else {
-        logger_log("NTP time synchronized successfully");
+static time_t catchup_window() {
+    return schedule_catchup_s > ON_TIME_S ? (time_t)schedule_catchup_s : ON_TIME_S;
+}
+
+// Earliest slot time at or after from, 0 if no slot is used
+static time_t next_slot_time(time_t from) {
+    struct tm day;
+    if (!localtime_r(&from, &day)) return 0;
+    // Eight days, so a slot earlier in the day than from is found a week later
+    for (int d = 0; d <= 7; d++) {
+        int wday = (day.tm_wday + d) % 7;
+        time_t best = 0;
+        for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+            const ScheduleSlot &slot = schedule_slots[i];
+            if (!(slot.days & (1 << wday))) continue;
+            struct tm at = day;
+            at.tm_mday += d;
+            at.tm_hour = slot.hour;
+            at.tm_min = slot.minute;
+            at.tm_sec = 0;
+            at.tm_isdst = -1; // That day's offset, so the schedule follows DST
+            time_t t = mktime(&at);
+            if (t >= from && (best == 0 || t < best)) best = t;
+        }
+        if (best) return best;
+    }
+    return 0;
+}
+
+static String slot_label(time_t t) {
+    struct tm at;
+    char label[8];
+    localtime_r(&t, &at);
+    snprintf(label, sizeof(label), "%02d:%02d", at.tm_hour, at.tm_min);
+    return String(label);
+}
+
+static void save_last_run() {
+    uint32_t epoch = (uint32_t)last_run_slot;
+    hal_prefs_begin(SCHEDULER_NAMESPACE, false);
+    hal_prefs_put_bytes("last_run", &epoch, sizeof(epoch));
+    hal_prefs_end();
+    metrics_count_nvs_commit();
+}
+
+static void log_missed(time_t slot, time_t now) {
+    String log_msg = "Missed scheduled run at " + slot_label(slot) + " (" + String((long)((now - slot) / 60)) +
+                     " min late, catch-up window " + String((long)(catchup_window() / 60)) + " min)";
+    logger_log(log_msg.c_str());
+}
+
+static void plan(time_t now) {
+    // Slots already past are left out, except after boot when the last run is known
+    bool look_back = catch_up && last_run_slot != 0;
+    time_t from = now - (look_back ? catchup_window() : ON_TIME_S) + 1;
+    if (look_back) {
+        // Report the latest slot missed while the device was off, looking back one day
+        time_t missed = 0;
+        time_t t = last_run_slot > from - 86400 ? last_run_slot : from - 86400;
+        while ((t = next_slot_time(t + 1)) != 0 && t < from) missed = t;
+        if (missed) log_missed(missed, now);
     }
+    // Never the same slot twice, also when the clock stepped back after the run
+    if (last_run_slot >= from && last_run_slot - now < FUTURE_RUN_LIMIT_S) from = last_run_slot + 1;
+    next_run = next_slot_time(from);
+    replan = false;
+    catch_up = false;
+}
+
+static void run_slot(time_t slot, time_t now, int passed_over) {
+    String log_msg = "Scheduled watering triggered for " + slot_label(slot);
+    if (now - slot >= ON_TIME_S) {
+        log_msg += " (" + String((long)((now - slot) / 60)) + " min late";
+        if (passed_over) log_msg += ", " + String(passed_over) + " earlier slot(s) folded in";
+        log_msg += ")";
+    }
+    logger_log(log_msg.c_str());
+    trace_record_schedule();
+    trigger_dosing();
+    last_run_slot = slot;
+    save_last_run();
+}
+
+void scheduler_init() {
+    uint32_t stored = 0;
+    hal_prefs_begin(SCHEDULER_NAMESPACE, true);
+    size_t len = hal_prefs_get_bytes("last_run", &stored, sizeof(stored));
+    hal_prefs_end();
+    last_run_slot = len == sizeof(stored) ? (time_t)stored : 0;
+    next_run = 0;
+    quiet_s = 0;
+    replan = true;
+    catch_up = true;
+    logger_log("Scheduler initialized");
+}
+
+void scheduler_reschedule() {
+    replan = true;
+    quiet_s = 0;
 }
 
 void scheduler_run() {
-    time_t now = time(nullptr);
-    struct tm timeinfo;
-    if (!localtime_r(&now, &timeinfo)) {
-        logger_log("ERROR: Failed to get current time for scheduling");
+    time_t now = hal_time();
+    if ((uint32_t)(now - quiet_from) < quiet_s) return;
+
+    time_t previous = quiet_from;
+    quiet_from = now;
+    if (!time_sync_is_valid()) {
+        // 1970 would match a midnight slot; look again once the clock can be valid
+        quiet_s = (uint32_t)(TIME_VALID_EPOCH - now);
+        return;
+    }
+    if (replan || now < previous) plan(now);
+    if (next_run == 0) {
+        quiet_s = UINT32_MAX; // No slot used; scheduler_reschedule() ends this
+        return;
+    }
+    if (now < next_run) {
+        quiet_s = (uint32_t)(next_run - now);
         return;
     }
-    int hour = timeinfo.tm_hour;
-    int min = timeinfo.tm_min;
-    if (hour == schedule_hour && min == schedule_minute && !has_run_today) {
-        String log_msg = "Scheduled watering triggered at " + String(hour) + ":" + String(min);
-        logger_log(log_msg.c_str());
-        trigger_dosing();
-        has_run_today = true;
-        last_run = millis();
+
+    // Due. A clock step, a stalled loop or an outage may have passed several
+    // slots: the latest one still inside the catch-up window runs, once.
+    time_t window = catchup_window();
+    time_t due = now - next_run < window ? next_run : next_slot_time(now - window + 1);
+    if (due != 0 && due <= now) {
+        int passed_over = 0;
+        for (;;) {
+            time_t later = next_slot_time(due + 1);
+            if (later == 0 || later > now) break;
+            due = later;
+            passed_over++;
+        }
+        run_slot(due, now, passed_over);
+    } else {
+        log_missed(next_run, now);
     }
-    if (hour != schedule_hour || min != schedule_minute) {
-        has_run_today = false;
+    next_run = next_slot_time(now + 1);
+    quiet_s = next_run ? (uint32_t)(next_run - now) : UINT32_MAX;
+}
+
+time_t scheduler_get_next_run() {
+    return next_run;
+}
+
+time_t scheduler_get_last_run() {
+    return last_run_slot;
+}
+
+bool scheduler_parse_slots(const char *text, ScheduleSlot slots[SCHEDULE_MAX_SLOTS]) {
+    ScheduleSlot parsed[SCHEDULE_MAX_SLOTS];
+    memset(parsed, 0, sizeof(parsed));
+    int count = 0;
+    const char *p = text;
+    while (*p) {
+        int hour, minute, used = 0;
+        if (count == SCHEDULE_MAX_SLOTS) return false;
+        if (sscanf(p, "%2d:%2d%n", &hour, &minute, &used) != 2 || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+            return false;
+        }
+        p += used;
+        uint8_t days = SCHEDULE_EVERY_DAY;
+        if (*p == '/') {
+            p++;
+            days = 0;
+            for (int day = 0; day < 7; day++, p++) {
+                if (*p != '0' && *p != '1') return false;
+                if (*p == '1') days |= 1 << day;
+            }
+            if (days == 0) return false;
+        }
+        parsed[count].hour = hour;
+        parsed[count].minute = minute;
+        parsed[count].days = days;
+        count++;
+        if (*p == ',') p++;
+        else if (*p) return false;
     }
-} 
\ No newline at end of file
+    memcpy(slots, parsed, sizeof(parsed));
+    return true;
+}
@@ -1,3 +1,24 @@
 #pragma once
+#include <time.h>
+#include "settings_store.h"
+
+// Runs the watering sequence at the schedule slots (up to SCHEDULE_MAX_SLOTS
+// times, each on its own weekdays). The next run time is worked out in advance,
+// so a loop pass normally costs one comparison with the clock; it is only
+// recomputed after a run, a schedule change or a clock step back.
+//
+// The slot time of the last run is kept in NVS. After a reboot or an outage the
+// latest missed slot still runs if it is at most schedule_catchup_s late, and
+// several missed slots start one run, not one each.
 void scheduler_init();
-void scheduler_run(); 
\ No newline at end of file
+void scheduler_run();
+void scheduler_reschedule(); // The schedule settings changed
+
+time_t scheduler_get_next_run(); // Slot time of the next run, 0 if none is planned
+time_t scheduler_get_last_run(); // Slot time of the last scheduled run, 0 if none is known
+
+// Form encoding of the slot table: "08:00,18:30/0111110" - comma separated
+// HH:MM, each optionally followed by / and seven 0/1 flags from Sunday to
+// Saturday (without them, every day). An empty string clears the table.
+// Returns false, leaving slots untouched, if text does not parse.
+bool scheduler_parse_slots(const char *text, ScheduleSlot slots[SCHEDULE_MAX_SLOTS]);
@@ -1,27 +1,158 @@
 #include "sensors.h"
+#include "valve_control.h"
 #include "logger.h"
+#include "trace_recorder.h"
 #include <Arduino.h>
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/isr.h"
+#include "hal/timer.h"
 #include "config/config.h"
 
-static bool liquid_level = false;
-static bool last_liquid_level = false;
+// Debounced liquid level - updated from the interrupt path only
+static volatile bool liquid_level = false;
+static volatile bool level_changed = false;
+static bool last_logged_level = false;
+
+// Timestamps of the raw edge that started the last accepted transition
+static volatile unsigned long full_edge_us = 0;
+static volatile unsigned long full_edge_ms = 0;
+static volatile unsigned long empty_edge_ms = 0;
+
+// Glitch filter state
+static volatile bool debounce_pending = false;
+static volatile unsigned long pending_edge_us = 0;
+static volatile unsigned long pending_edge_ms = 0;
+static hal_timer_t debounce_timer = nullptr;
+static hal_lock_t sensor_mux = HAL_LOCK_INITIALIZER;
+
+// Statistics
+static volatile unsigned long raw_edge_count = 0;
+static volatile unsigned long glitch_count = 0;
+static volatile unsigned long valve_close_latency_us = 0;
+static volatile bool valve_closed_by_sensor = false;
+
+// Accept a new level. Runs in interrupt or timer context with sensor_mux held.
+static void HAL_ISR_ATTR commit_level(bool level, unsigned long edge_us, unsigned long edge_ms) {
+    if (level == liquid_level) {
+        // Level bounced back before the filter window expired
+        glitch_count++;
+        return;
+    }
+    liquid_level = level;
+    level_changed = true;
+
+    if (level) {
+        full_edge_us = edge_us;
+        full_edge_ms = edge_ms;
+        // Tank full: close the valve right here instead of waiting for loop()
+        if (valve_control_close_from_isr()) {
+            valve_close_latency_us = hal_micros() - edge_us;
+            valve_closed_by_sensor = true;
+        }
+    } else {
+        empty_edge_ms = edge_ms;
+    }
+}
+
+static void HAL_ISR_ATTR liquid_sensor_isr() {
+    unsigned long now_us = hal_micros();
+    hal_lock_enter_isr(&sensor_mux);
+    raw_edge_count++;
+    trace_record_sensor_edge(hal_gpio_read(LIQUID_SENSOR_PIN));
+    if (LIQUID_SENSOR_DEBOUNCE_US == 0 || debounce_timer == nullptr) {
+        commit_level(hal_gpio_read(LIQUID_SENSOR_PIN), now_us, hal_millis());
+    } else {
+        // Remember the first edge of a burst and (re)start the filter window
+        if (!debounce_pending) {
+            pending_edge_us = now_us;
+            pending_edge_ms = hal_millis();
+            debounce_pending = true;
+        }
+        hal_timer_stop(debounce_timer);
+        hal_timer_start_once(debounce_timer, LIQUID_SENSOR_DEBOUNCE_US);
+    }
+    hal_lock_exit_isr(&sensor_mux);
+}
+
+// Runs in the high-priority timer task once the pin has been stable for the filter window
+static void debounce_timer_callback(void *arg) {
+    hal_lock_enter(&sensor_mux);
+    if (debounce_pending) {
+        debounce_pending = false;
+        commit_level(hal_gpio_read(LIQUID_SENSOR_PIN), pending_edge_us, pending_edge_ms);
+    }
+    hal_lock_exit(&sensor_mux);
+}
 
 void sensors_init() {
-    pinMode(LIQUID_SENSOR_PIN, INPUT);
-    logger_log("Sensors initialized");
+    hal_gpio_input(LIQUID_SENSOR_PIN);
+    liquid_level = hal_gpio_read(LIQUID_SENSOR_PIN);
+    last_logged_level = liquid_level;
+
+    if (LIQUID_SENSOR_DEBOUNCE_US > 0) {
+        debounce_timer = hal_timer_create(debounce_timer_callback, nullptr, "liquid_debounce");
+        if (debounce_timer == nullptr) {
+            logger_log("WARNING: Liquid sensor debounce timer unavailable - using raw edges");
+        }
+    }
+    hal_gpio_attach_change(LIQUID_SENSOR_PIN, liquid_sensor_isr);
+
+    String log_msg = "Sensors initialized - liquid level " + String(liquid_level ? "PRESENT" : "NOT PRESENT") +
+                     ", debounce " + String(LIQUID_SENSOR_DEBOUNCE_US) + " us";
+    logger_log(log_msg.c_str());
 }
 
 void sensors_read() {
-    last_liquid_level = liquid_level;
-    liquid_level = digitalRead(LIQUID_SENSOR_PIN);
-    
-    // Log only when liquid level changes
-    if (liquid_level != last_liquid_level) {
-        String log_msg = "Liquid level changed: " + String(liquid_level ? "PRESENT" : "NOT PRESENT");
+    // The interrupt path does the work; here we only report what happened
+    if (!level_changed) {
+        return;
+    }
+
+    hal_lock_enter(&sensor_mux);
+    bool level = liquid_level;
+    bool closed_by_sensor = valve_closed_by_sensor;
+    unsigned long latency_us = valve_close_latency_us;
+    level_changed = false;
+    valve_closed_by_sensor = false;
+    hal_lock_exit(&sensor_mux);
+
+    // Log only when the accepted level differs from the last one reported
+    if (level != last_logged_level) {
+        String log_msg = "Liquid level changed: " + String(level ? "PRESENT" : "NOT PRESENT");
+        logger_log(log_msg.c_str());
+        last_logged_level = level;
+    }
+    if (closed_by_sensor) {
+        String log_msg = "Main tank valve closed by sensor interrupt - " + String(latency_us) + " us after full edge";
         logger_log(log_msg.c_str());
     }
 }
 
 bool sensors_get_liquid_level() {
     return liquid_level;
-} 
\ No newline at end of file
+}
+
+unsigned long sensors_get_last_full_edge_ms() {
+    return full_edge_ms;
+}
+
+unsigned long sensors_get_last_full_edge_us() {
+    return full_edge_us;
+}
+
+unsigned long sensors_get_last_empty_edge_ms() {
+    return empty_edge_ms;
+}
+
+unsigned long sensors_get_raw_edge_count() {
+    return raw_edge_count;
+}
+
+unsigned long sensors_get_glitch_count() {
+    return glitch_count;
+}
+
+unsigned long sensors_get_valve_close_latency_us() {
+    return valve_close_latency_us;
+}
@@ -1,4 +1,14 @@
 #pragma once
 void sensors_init();
 void sensors_read();
-bool sensors_get_liquid_level(); 
\ No newline at end of file
+bool sensors_get_liquid_level();
+
+// Edge timestamps of the last accepted transitions (time of the first raw edge)
+unsigned long sensors_get_last_full_edge_ms();
+unsigned long sensors_get_last_full_edge_us();
+unsigned long sensors_get_last_empty_edge_ms();
+
+// Interrupt statistics
+unsigned long sensors_get_raw_edge_count();
+unsigned long sensors_get_glitch_count();
+unsigned long sensors_get_valve_close_latency_us();
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "hal/clock.h"
+#include "config/config.h"
+
+// Sequence lock for data written by one task and copied by others: the
+// sequence is odd while an update is in progress. Writers never wait.
+//
+// Readers may run at a higher priority than the writer (web handlers on the
+// AsyncTCP task, the control loop at priority 1), so a reader that finds an
+// update in progress sleeps a tick to let the writer finish instead of
+// spinning, and gives up after SEQLOCK_READ_ATTEMPTS tries.
+
+static inline void seqlock_write_begin(uint32_t &sequence) {
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(uint32_t &sequence) {
+    __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+// Copy source, guarded by sequence, into out. Returns false if every attempt
+// overlapped an update; out is then not a consistent copy. retries, if given,
+// counts the attempts that had to be repeated.
+template <typename T>
+static bool seqlock_read(const uint32_t &sequence, const T &source, T &out, uint32_t *retries = nullptr) {
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            if (retries) __atomic_fetch_add(retries, 1, __ATOMIC_RELAXED);
+            hal_delay(1);
+        }
+        uint32_t before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+        memcpy(&out, &source, sizeof(out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&sequence, __ATOMIC_RELAXED) == before) return true;
+    }
+    return false;
+}
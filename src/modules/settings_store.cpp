@@ -0,0 +1,387 @@
+#include "settings_store.h"
+#include "logger.h"
+#include "metrics.h"
+#include <Arduino.h>
+#include "hal/clock.h"
+#include "hal/prefs.h"
+#include <stddef.h>
+#include <string.h>
+#include "config/config.h"
+
+#define SETTINGS_NAMESPACE "irrigation"
+#define SETTINGS_KEY "cfg"
+
+extern float weekly_dosing_ml[7][NUM_FERTILIZERS];
+extern bool weekly_watering_enabled[7];
+extern ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS];
+extern unsigned long schedule_catchup_s;
+extern float pump_calibration[NUM_FERTILIZERS];
+extern float pump_curve[NUM_FERTILIZERS][CAL_CURVE_POINTS];
+extern unsigned long pump_spinup_ms[NUM_FERTILIZERS];
+extern int fertilizer_motor_speed;
+extern unsigned long watering_duration_ms;
+extern float watering_target_ml;
+extern bool sequence_pipelined;
+extern unsigned long fill_offset_ms;
+
+// Last blob written to (or read from) NVS, used to skip no-op commits
+static SettingsBlob committed;
+
+// Write-behind state; marked from the network task, consumed by the control loop
+static volatile uint32_t dirty_fields = 0;
+static volatile unsigned long first_dirty_ms = 0;
+static volatile unsigned long last_dirty_ms = 0;
+static volatile uint32_t settings_version = 1;
+
+uint32_t settings_crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t blob_crc(const SettingsBlob &blob) {
+    return settings_crc32((const uint8_t *)&blob, offsetof(SettingsBlob, crc));
+}
+
+void settings_defaults(SettingsBlob &blob) {
+    memset(&blob, 0, sizeof(blob));
+    blob.version = SETTINGS_VERSION;
+    blob.size = sizeof(SettingsBlob);
+    for (int day = 0; day < 7; day++) {
+        blob.weekly_watering_enabled[day] = 1;
+        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+            blob.weekly_dosing_ml[day][fert] = 1.0;
+        }
+    }
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        blob.pump_calibration[i] = 1.0;
+    }
+    blob.schedule_slots[0].hour = 8;
+    blob.schedule_slots[0].days = SCHEDULE_EVERY_DAY;
+    blob.schedule_catchup_s = SCHEDULE_MAX_LATE_S;
+    blob.fertilizer_motor_speed = 200;
+    blob.watering_duration_ms = MAX_WATERING_TIME_MS;
+}
+
+void settings_capture(SettingsBlob &blob) {
+    memset(&blob, 0, sizeof(blob)); // Padding must be zero for a stable CRC
+    blob.version = SETTINGS_VERSION;
+    blob.size = sizeof(SettingsBlob);
+    memcpy(blob.weekly_dosing_ml, weekly_dosing_ml, sizeof(blob.weekly_dosing_ml));
+    memcpy(blob.pump_calibration, pump_calibration, sizeof(blob.pump_calibration));
+    memcpy(blob.pump_curve, pump_curve, sizeof(blob.pump_curve));
+    for (int day = 0; day < 7; day++) {
+        blob.weekly_watering_enabled[day] = weekly_watering_enabled[day] ? 1 : 0;
+    }
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        blob.pump_spinup_ms[i] = pump_spinup_ms[i];
+    }
+    blob.watering_target_ml = watering_target_ml;
+    blob.watering_duration_ms = watering_duration_ms;
+    blob.fill_offset_ms = fill_offset_ms;
+    memcpy(blob.schedule_slots, schedule_slots, sizeof(blob.schedule_slots));
+    blob.schedule_catchup_s = schedule_catchup_s;
+    blob.fertilizer_motor_speed = fertilizer_motor_speed;
+    blob.sequence_pipelined = sequence_pipelined ? 1 : 0;
+}
+
+void settings_apply(const SettingsBlob &blob) {
+    settings_apply_fields(blob, SETTING_ALL);
+}
+
+void settings_apply_fields(const SettingsBlob &blob, uint32_t fields) {
+    if (fields & SETTING_WEEKLY_DOSING) {
+        memcpy(weekly_dosing_ml, blob.weekly_dosing_ml, sizeof(blob.weekly_dosing_ml));
+    }
+    if (fields & SETTING_CALIBRATION) {
+        memcpy(pump_calibration, blob.pump_calibration, sizeof(blob.pump_calibration));
+    }
+    if (fields & SETTING_CALIBRATION_CURVE) {
+        memcpy(pump_curve, blob.pump_curve, sizeof(blob.pump_curve));
+        for (int i = 0; i < NUM_FERTILIZERS; i++) {
+            pump_spinup_ms[i] = blob.pump_spinup_ms[i];
+        }
+    }
+    if (fields & SETTING_WATERING_DAYS) {
+        for (int day = 0; day < 7; day++) {
+            weekly_watering_enabled[day] = blob.weekly_watering_enabled[day] != 0;
+        }
+    }
+    if (fields & SETTING_WATERING_VOLUME) watering_target_ml = blob.watering_target_ml;
+    if (fields & SETTING_WATERING_DURATION) watering_duration_ms = blob.watering_duration_ms;
+    if (fields & SETTING_SCHEDULE) {
+        memcpy(schedule_slots, blob.schedule_slots, sizeof(blob.schedule_slots));
+        schedule_catchup_s = blob.schedule_catchup_s;
+    }
+    if (fields & SETTING_MOTOR_SPEED) fertilizer_motor_speed = blob.fertilizer_motor_speed;
+    if (fields & SETTING_SEQUENCE_MODE) {
+        sequence_pipelined = blob.sequence_pipelined != 0;
+        fill_offset_ms = blob.fill_offset_ms;
+    }
+}
+
+void settings_patch_init(SettingsPatch &patch) {
+    memset(&patch, 0, sizeof(patch));
+}
+
+void settings_patch_mark(SettingsPatch &patch, const void *field, size_t size, uint32_t group) {
+    size_t offset = (const uint8_t *)field - (const uint8_t *)&patch.values;
+    for (size_t i = offset; i < offset + size && i < sizeof(patch.values); i++) {
+        patch.mask[i / 8] |= 1 << (i % 8);
+    }
+    patch.fields |= group;
+}
+
+bool settings_patch_has(const SettingsPatch &patch, const void *field) {
+    size_t offset = (const uint8_t *)field - (const uint8_t *)&patch.values;
+    return offset < sizeof(patch.values) && (patch.mask[offset / 8] & (1 << (offset % 8)));
+}
+
+void settings_patch_slot_time(SettingsPatch &patch, int slot, int hour, int minute) {
+    ScheduleSlot &target = patch.values.schedule_slots[slot];
+    if (hour >= 0) settings_patch_set(patch, target.hour, hour, SETTING_SCHEDULE);
+    if (minute >= 0) settings_patch_set(patch, target.minute, minute, SETTING_SCHEDULE);
+    // Days already in the patch (a replaced table) are not merged over, so set them here
+    if (settings_patch_has(patch, &target.days) && target.days == 0) target.days = SCHEDULE_EVERY_DAY;
+}
+
+void settings_apply_patch(const SettingsPatch &patch) {
+    SettingsBlob blob;
+    settings_capture(blob);
+    const uint8_t *from = (const uint8_t *)&patch.values;
+    uint8_t *to = (uint8_t *)&blob;
+    for (size_t i = 0; i < sizeof(blob); i++) {
+        if (patch.mask[i / 8] & (1 << (i % 8))) to[i] = from[i];
+    }
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        const ScheduleSlot &slot = patch.values.schedule_slots[i];
+        bool time_set = settings_patch_has(patch, &slot.hour) || settings_patch_has(patch, &slot.minute);
+        if (time_set && !settings_patch_has(patch, &slot.days) && blob.schedule_slots[i].days == 0) {
+            blob.schedule_slots[i].days = SCHEDULE_EVERY_DAY;
+        }
+    }
+    settings_apply_fields(blob, patch.fields);
+}
+
+// Read the pre-blob layout (one key per value). The keys stay until the blob
+// that replaces them is stored, see remove_legacy_keys().
+static bool migrate_legacy_keys(SettingsBlob &blob) {
+    if (!hal_prefs_is_key("sched_hour")) {
+        return false; // Nothing stored yet
+    }
+    settings_defaults(blob);
+
+    for (int day = 0; day < 7; day++) {
+        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+            String key = "dose_" + String(day) + "_" + String(fert);
+            blob.weekly_dosing_ml[day][fert] = hal_prefs_get_float(key.c_str(), 1.0);
+        }
+        String enabled_key = "water_" + String(day);
+        blob.weekly_watering_enabled[day] = hal_prefs_get_bool(enabled_key.c_str(), true) ? 1 : 0;
+    }
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        String cal_key = "cal_" + String(i);
+        blob.pump_calibration[i] = hal_prefs_get_float(cal_key.c_str(), 1.0);
+        for (int p = 0; p < CAL_CURVE_POINTS; p++) {
+            String curve_key = "crv_" + String(i) + "_" + String(p);
+            blob.pump_curve[i][p] = hal_prefs_get_float(curve_key.c_str(), 0);
+        }
+        String spin_key = "spin_" + String(i);
+        blob.pump_spinup_ms[i] = hal_prefs_get_ulong(spin_key.c_str(), 0);
+    }
+    blob.schedule_slots[0].hour = hal_prefs_get_int("sched_hour", 8);
+    blob.schedule_slots[0].minute = hal_prefs_get_int("sched_min", 0);
+    blob.fertilizer_motor_speed = hal_prefs_get_int("fert_speed", 200);
+    blob.watering_duration_ms = hal_prefs_get_ulong("water_dur", MAX_WATERING_TIME_MS);
+    blob.watering_target_ml = hal_prefs_get_float("water_ml", 0);
+    blob.sequence_pipelined = hal_prefs_get_bool("seq_pipe", false) ? 1 : 0;
+    blob.fill_offset_ms = hal_prefs_get_ulong("fill_off", 0);
+    return true;
+}
+
+// Remove the per-key layout once the blob is stored. sched_hour goes last: it
+// marks the old layout, so a reset halfway leaves it to be cleaned up next boot.
+static void remove_legacy_keys() {
+    for (int day = 0; day < 7; day++) {
+        for (int fert = 0; fert < NUM_FERTILIZERS; fert++) {
+            String key = "dose_" + String(day) + "_" + String(fert);
+            hal_prefs_remove(key.c_str());
+        }
+        String enabled_key = "water_" + String(day);
+        hal_prefs_remove(enabled_key.c_str());
+    }
+    for (int i = 0; i < NUM_FERTILIZERS; i++) {
+        String cal_key = "cal_" + String(i);
+        hal_prefs_remove(cal_key.c_str());
+        for (int p = 0; p < CAL_CURVE_POINTS; p++) {
+            String curve_key = "crv_" + String(i) + "_" + String(p);
+            hal_prefs_remove(curve_key.c_str());
+        }
+        String spin_key = "spin_" + String(i);
+        hal_prefs_remove(spin_key.c_str());
+    }
+    const char *scalar_keys[] = {"sched_min", "fert_speed", "water_dur", "water_ml", "seq_pipe", "fill_off", "sched_hour"};
+    for (const char *key : scalar_keys) {
+        hal_prefs_remove(key);
+    }
+}
+
+// Version 1 layout: a single daily run time
+struct SettingsBlobV1 {
+    uint16_t version;
+    uint16_t size;
+    float weekly_dosing_ml[7][NUM_FERTILIZERS];
+    float pump_calibration[NUM_FERTILIZERS];
+    float pump_curve[NUM_FERTILIZERS][CAL_CURVE_POINTS];
+    float watering_target_ml;
+    uint32_t watering_duration_ms;
+    uint32_t fill_offset_ms;
+    uint16_t pump_spinup_ms[NUM_FERTILIZERS];
+    uint8_t weekly_watering_enabled[7];
+    uint8_t schedule_hour;
+    uint8_t schedule_minute;
+    uint8_t fertilizer_motor_speed;
+    uint8_t sequence_pipelined;
+    uint32_t crc;
+};
+
+static void migrate_v1(const SettingsBlobV1 &old, SettingsBlob &blob) {
+    settings_defaults(blob);
+    memcpy(blob.weekly_dosing_ml, old.weekly_dosing_ml, sizeof(blob.weekly_dosing_ml));
+    memcpy(blob.pump_calibration, old.pump_calibration, sizeof(blob.pump_calibration));
+    memcpy(blob.pump_curve, old.pump_curve, sizeof(blob.pump_curve));
+    blob.watering_target_ml = old.watering_target_ml;
+    blob.watering_duration_ms = old.watering_duration_ms;
+    blob.fill_offset_ms = old.fill_offset_ms;
+    memcpy(blob.pump_spinup_ms, old.pump_spinup_ms, sizeof(blob.pump_spinup_ms));
+    memcpy(blob.weekly_watering_enabled, old.weekly_watering_enabled, sizeof(blob.weekly_watering_enabled));
+    // The old daily time becomes the first slot, on every day as before
+    blob.schedule_slots[0].hour = old.schedule_hour;
+    blob.schedule_slots[0].minute = old.schedule_minute;
+    blob.fertilizer_motor_speed = old.fertilizer_motor_speed;
+    blob.sequence_pipelined = old.sequence_pipelined;
+}
+
+// Upgrade an older blob in place. Returns false if the layout is unknown.
+static bool migrate_blob(SettingsBlob &blob, size_t len, bool &upgraded) {
+    upgraded = false;
+    if (blob.version == 1 && len == sizeof(SettingsBlobV1)) {
+        SettingsBlobV1 old;
+        memcpy(&old, &blob, sizeof(old));
+        migrate_v1(old, blob);
+        upgraded = true;
+        logger_log("Settings migrated from version 1 (single daily run time)");
+        return true;
+    }
+    return blob.version == SETTINGS_VERSION && len == sizeof(SettingsBlob);
+}
+
+void settings_load() {
+    SettingsBlob blob;
+    bool write_back = false;
+
+    hal_prefs_begin(SETTINGS_NAMESPACE, false);
+    size_t len = hal_prefs_get_bytes_length(SETTINGS_KEY);
+    if (len == 0) {
+        if (migrate_legacy_keys(blob)) {
+            logger_log("Settings migrated from per-key layout to blob");
+        } else {
+            settings_defaults(blob);
+            logger_log("No stored settings - using defaults");
+        }
+        write_back = true;
+    } else {
+        memset(&blob, 0, sizeof(blob));
+        bool ok = len > offsetof(SettingsBlob, weekly_dosing_ml) && len <= sizeof(SettingsBlob) &&
+                  hal_prefs_get_bytes(SETTINGS_KEY, &blob, len) == len && blob.size == len;
+        if (ok) {
+            // The CRC is the last field in every layout version
+            uint32_t stored_crc;
+            memcpy(&stored_crc, (const uint8_t *)&blob + len - sizeof(stored_crc), sizeof(stored_crc));
+            ok = settings_crc32((const uint8_t *)&blob, len - sizeof(stored_crc)) == stored_crc &&
+                 migrate_blob(blob, len, write_back);
+        }
+        if (!ok) {
+            logger_log("ERROR: Stored settings corrupt or unknown version - using defaults");
+            settings_defaults(blob);
+            write_back = true;
+        }
+    }
+
+    bool stored = !write_back;
+    if (write_back) {
+        blob.crc = blob_crc(blob);
+        stored = hal_prefs_put_bytes(SETTINGS_KEY, &blob, sizeof(blob)) == sizeof(blob);
+        metrics_count_nvs_commit();
+        if (!stored) logger_log("ERROR: Could not store settings in NVS");
+    }
+    // Also finishes a cleanup cut short by a reset after an earlier migration
+    if (stored && hal_prefs_is_key("sched_hour")) remove_legacy_keys();
+    hal_prefs_end();
+
+    committed = blob;
+    settings_apply(blob);
+    logger_log("Settings loaded from NVS");
+}
+
+void settings_save() {
+    SettingsBlob blob;
+    settings_capture(blob);
+    blob.crc = blob_crc(blob);
+    if (memcmp(&blob, &committed, sizeof(blob)) == 0) {
+        return; // Values are unchanged - save the flash write
+    }
+
+    hal_prefs_begin(SETTINGS_NAMESPACE, false);
+    hal_prefs_put_bytes(SETTINGS_KEY, &blob, sizeof(blob));
+    hal_prefs_end();
+    metrics_count_nvs_commit();
+    committed = blob;
+    logger_log("Settings saved to NVS");
+}
+
+void settings_mark_dirty(uint32_t fields) {
+    unsigned long now = hal_millis();
+    if (__atomic_fetch_or(&dirty_fields, fields, __ATOMIC_SEQ_CST) == 0) {
+        first_dirty_ms = now;
+    }
+    last_dirty_ms = now;
+    __atomic_fetch_add(&settings_version, 1, __ATOMIC_SEQ_CST);
+}
+
+uint32_t settings_get_version() {
+    return settings_version;
+}
+
+bool settings_is_dirty() {
+    return dirty_fields != 0;
+}
+
+static void commit_dirty() {
+    uint32_t fields = __atomic_exchange_n(&dirty_fields, 0, __ATOMIC_SEQ_CST);
+    if (fields == 0) {
+        return;
+    }
+    String log_msg = "Committing settings (changed groups 0x" + String(fields, HEX) + ")";
+    logger_log(log_msg.c_str());
+    settings_save();
+}
+
+void settings_process() {
+    if (dirty_fields == 0) {
+        return;
+    }
+    unsigned long now = hal_millis();
+    if (now - last_dirty_ms >= SETTINGS_COMMIT_DELAY_MS || now - first_dirty_ms >= SETTINGS_MAX_DEFER_MS) {
+        commit_dirty();
+    }
+}
+
+void settings_flush() {
+    commit_dirty();
+}
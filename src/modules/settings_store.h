@@ -0,0 +1,108 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "config/config.h"
+
+// All persisted settings, stored as a single versioned, CRC-checked NVS blob.
+// Bump SETTINGS_VERSION when the layout changes and add a migration step.
+#define SETTINGS_VERSION 2
+
+#define SCHEDULE_EVERY_DAY 0x7f
+
+// One scheduled run time. days has bit 0 = Sunday ... bit 6 = Saturday, like
+// tm_wday; a slot without days is unused.
+struct ScheduleSlot {
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days;
+};
+
+struct SettingsBlob {
+    uint16_t version;
+    uint16_t size;                       // sizeof(SettingsBlob) when written
+    // 4-byte fields
+    float weekly_dosing_ml[7][NUM_FERTILIZERS];
+    float pump_calibration[NUM_FERTILIZERS];
+    float pump_curve[NUM_FERTILIZERS][CAL_CURVE_POINTS];
+    float watering_target_ml;
+    uint32_t watering_duration_ms;
+    uint32_t fill_offset_ms;
+    uint32_t schedule_catchup_s;
+    // 2-byte fields
+    uint16_t pump_spinup_ms[NUM_FERTILIZERS];
+    // 1-byte fields
+    uint8_t weekly_watering_enabled[7];
+    ScheduleSlot schedule_slots[SCHEDULE_MAX_SLOTS];
+    uint8_t fertilizer_motor_speed;
+    uint8_t sequence_pipelined;
+    uint32_t crc;                        // CRC32 of everything before this field
+};
+
+// Setting groups for dirty tracking
+enum SettingsField : uint32_t {
+    SETTING_WEEKLY_DOSING     = 1 << 0,
+    SETTING_WATERING_DAYS     = 1 << 1,
+    SETTING_SCHEDULE          = 1 << 2,
+    SETTING_CALIBRATION       = 1 << 3,
+    SETTING_CALIBRATION_CURVE = 1 << 4,
+    SETTING_MOTOR_SPEED       = 1 << 5,
+    SETTING_WATERING_DURATION = 1 << 6,
+    SETTING_WATERING_VOLUME   = 1 << 7,
+    SETTING_SEQUENCE_MODE     = 1 << 8,
+    SETTING_ALL               = (1 << 9) - 1
+};
+
+// A settings change queued by the web task: the submitted values, and a bit
+// per byte of values marking which of them were submitted. The control task
+// merges only those into the live settings, so two queued edits of the same
+// group (cal0, then cal1) both take effect, and the web task never has to
+// read the globals the loop is writing.
+struct SettingsPatch {
+    SettingsBlob values;
+    uint8_t mask[(sizeof(SettingsBlob) + 7) / 8];
+    uint32_t fields;                     // SettingsField groups touched
+};
+
+void settings_patch_init(SettingsPatch &patch);
+// Mark size bytes at field, which points into patch.values, as submitted
+void settings_patch_mark(SettingsPatch &patch, const void *field, size_t size, uint32_t group);
+bool settings_patch_has(const SettingsPatch &patch, const void *field);
+
+// Set the time of one slot; hour or minute < 0 leaves that part alone. An
+// unused slot is made to run every day (see settings_apply_patch).
+void settings_patch_slot_time(SettingsPatch &patch, int slot, int hour, int minute);
+
+template <typename T, typename V>
+inline void settings_patch_set(SettingsPatch &patch, T &field, V value, uint32_t group) {
+    field = (T)value;
+    settings_patch_mark(patch, &field, sizeof(field), group);
+}
+
+// Load settings into the globals (one NVS read). Migrates the old per-key layout
+// and falls back to defaults when the blob is missing or corrupt.
+void settings_load();
+
+// Save the globals now (one NVS write, skipped if nothing differs from the last commit)
+void settings_save();
+
+// Write-behind: handlers mark what they changed; settings_process() commits from the
+// control loop once edits have been quiet for SETTINGS_COMMIT_DELAY_MS
+void settings_mark_dirty(uint32_t fields);
+void settings_process();
+void settings_flush(); // Commit pending changes immediately (OTA, restart)
+bool settings_is_dirty();
+
+// Incremented on every settings change; keys the response cache
+uint32_t settings_get_version();
+
+// Snapshot of the globals / write a snapshot back to the globals
+void settings_capture(SettingsBlob &blob);
+void settings_apply(const SettingsBlob &blob);
+// Copy only the given SettingsField groups from blob into the globals
+void settings_apply_fields(const SettingsBlob &blob, uint32_t fields);
+// Control task only. Merge the submitted values of a patch into the globals.
+// A slot that gets a time but no days, and has none, runs every day.
+void settings_apply_patch(const SettingsPatch &patch);
+void settings_defaults(SettingsBlob &blob);
+
+uint32_t settings_crc32(const uint8_t *data, size_t len);
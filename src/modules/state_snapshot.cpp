@@ -0,0 +1,41 @@
+#include "state_snapshot.h"
+#include "seqlock.h"
+#include <string.h>
+
+// Only the control task writes
+static uint32_t sequence = 0;
+static StateSnapshot published;
+static StateSnapshot last; // Writer-private copy for change detection
+static uint32_t read_retries = 0;
+
+bool state_snapshot_publish(const StateSnapshot &s) {
+    StateSnapshot next = s;
+    next.version = last.version;
+    if (sequence != 0 && memcmp(&next, &last, sizeof(next)) == 0) {
+        return false;
+    }
+    next.version = last.version + 1;
+    last = next;
+
+    seqlock_write_begin(sequence);
+    memcpy(&published, &next, sizeof(published));
+    seqlock_write_end(sequence);
+    return true;
+}
+
+bool state_snapshot_read(StateSnapshot &out) {
+    if (__atomic_load_n(&sequence, __ATOMIC_ACQUIRE) == 0) return false;
+    StateSnapshot copy; // out stays untouched if no consistent copy is made
+    if (!seqlock_read(sequence, published, copy, &read_retries)) return false;
+    out = copy;
+    return true;
+}
+
+uint32_t state_snapshot_remaining_ms(uint32_t end_ms, uint32_t now_ms) {
+    int32_t left = (int32_t)(end_ms - now_ms);
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+uint32_t state_snapshot_get_read_retries() {
+    return read_retries;
+}
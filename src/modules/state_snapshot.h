@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+
+// Consistent view of the control state for readers on other tasks.
+// The control loop fills a StateSnapshot and publishes it through a seqlock;
+// readers copy it out without locking and retry if a publish overlapped, so
+// they never see a mix of old and new fields and never block the loop.
+// Timers are stored as millis() deadlines, so the snapshot only changes when
+// the state or one of the counters at the end does; use
+// state_snapshot_remaining_ms() for the time left.
+
+#define SNAPSHOT_CHANNELS 7 // Motor channels 1-7
+
+struct StateSnapshot {
+    uint32_t version;                      // Set by state_snapshot_publish()
+    uint8_t watering_state;                // WateringState of the sequence
+    int8_t dosing_stage;                   // Fertilizer being dosed, -1 when not dosing
+    bool tank_full;
+    bool filling;
+    bool valve_open;
+    bool ntp_synced;
+    uint8_t time_state;                    // TimeSyncState
+    bool humidifier_pump;
+    bool watering_pump;
+    uint8_t pump_speed[SNAPSHOT_CHANNELS]; // Per motor channel, 0 = stopped
+    uint32_t dosing_end_ms;                // Deadlines (millis), valid while the matching state is active
+    uint32_t humidifier_end_ms;
+    uint32_t watering_end_ms;
+    uint32_t fill_start_ms;
+    uint32_t fill_timeout_ms;
+    uint32_t watering_duration_ms;
+    uint32_t time_synced_epoch;            // Last SNTP sync, 0 if none is known
+    float clock_drift_ppm;
+    uint32_t next_run_epoch;               // Next scheduled run, 0 if no slot is used
+    float watering_volume_ml;              // Flow meter volume of the current or last watering run
+    uint32_t sensor_edges;                 // Liquid sensor interrupt statistics
+    uint32_t sensor_glitches;
+    uint32_t valve_close_latency_us;
+};
+
+// Control task only. Publishes s if it differs from the last published snapshot
+// and returns true in that case. Clear s with memset before filling it in.
+bool state_snapshot_publish(const StateSnapshot &s);
+
+// Any task. Copies the latest snapshot; false, leaving out untouched, if nothing
+// was published yet or a publish overlapped every attempt (see seqlock.h).
+bool state_snapshot_read(StateSnapshot &out);
+
+uint32_t state_snapshot_remaining_ms(uint32_t end_ms, uint32_t now_ms);
+
+// Reads that had to retry because a publish overlapped
+uint32_t state_snapshot_get_read_retries();
@@ -0,0 +1,202 @@
+#include "time_sync.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace_recorder.h"
+#include "hal/clock.h"
+#include "hal/isr.h"
+#include "hal/prefs.h"
+#include "config/config.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIME_RECORD_MAGIC 0x454d4954 // "TIME"
+#define TIME_RECORD_VERSION 1
+#define DRIFT_MIN_INTERVAL_MS 600000 // Shorter sync intervals give too noisy a drift sample
+#define DRIFT_MAX_OFFSET_MS 5000     // Larger corrections are not drift (clock set by hand, server change)
+#define DRIFT_WEIGHT 0.25f           // Weight of a new drift sample
+#define DRIFT_PERSIST_PPM 0.5f       // Drift change that is worth an NVS write
+#define PERSIST_INTERVAL_S 86400     // ... otherwise the last sync is written once a day
+
+// Kept in RTC memory after every sync and in NVS now and then
+struct TimeRecord {
+    uint32_t magic;
+    uint8_t version;
+    bool drift_known;
+    uint32_t last_sync;      // Epoch, 0 = never
+    float drift_ppm;
+    uint32_t checksum;       // Of everything above; RTC memory is random after power-on
+};
+
+static HAL_RETAINED_ATTR TimeRecord retained;
+static TimeRecord record;    // Live values
+static TimeRecord persisted; // Last written to NVS
+
+static TimeSyncState state = TIME_UNSET;
+static uint32_t sync_count = 0;
+static int32_t last_offset_ms = 0;
+static uint32_t last_sync_ms = 0; // hal_millis() of the last sync since power-on
+static bool synced_since_boot = false;
+
+// Handed over from the network task
+static hal_lock_t pending_lock = HAL_LOCK_INITIALIZER;
+static bool pending = false;
+static time_t pending_epoch = 0;
+static int32_t pending_offset_ms = 0;
+static bool pending_stepped = false;
+static uint32_t pending_ms = 0;
+
+static uint32_t record_checksum(const TimeRecord &r) {
+    // FNV-1a over the fields before the checksum
+    const uint8_t *bytes = (const uint8_t *)&r;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(TimeRecord, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool record_is_valid(const TimeRecord &r) {
+    return r.magic == TIME_RECORD_MAGIC && r.version == TIME_RECORD_VERSION && r.checksum == record_checksum(r);
+}
+
+static void record_seal(TimeRecord &r) {
+    r.magic = TIME_RECORD_MAGIC;
+    r.version = TIME_RECORD_VERSION;
+    r.checksum = record_checksum(r);
+}
+
+static void persist_if_due() {
+    bool drift_moved = record.drift_known &&
+                       (!persisted.drift_known || fabsf(record.drift_ppm - persisted.drift_ppm) >= DRIFT_PERSIST_PPM);
+    bool sync_old = record.last_sync - persisted.last_sync >= PERSIST_INTERVAL_S;
+    if (!drift_moved && !sync_old) return;
+    hal_prefs_begin("time", false);
+    hal_prefs_put_bytes("record", &record, sizeof(record));
+    hal_prefs_end();
+    metrics_count_nvs_commit();
+    persisted = record;
+}
+
+// Network task: the control loop picks the sync up in time_sync_process()
+static void on_sync(time_t epoch, int32_t offset_ms, bool stepped) {
+    trace_record_time_sync((uint32_t)epoch);
+    hal_lock_enter(&pending_lock);
+    pending = true;
+    pending_epoch = epoch;
+    pending_offset_ms = offset_ms;
+    pending_stepped = stepped;
+    pending_ms = hal_millis();
+    hal_lock_exit(&pending_lock);
+}
+
+static void apply_sync(time_t epoch, int32_t offset_ms, bool stepped, uint32_t at_ms) {
+    uint32_t interval_ms = at_ms - last_sync_ms;
+    // A step is the clock being set, not drift
+    if (!stepped && synced_since_boot && interval_ms >= DRIFT_MIN_INTERVAL_MS && abs(offset_ms) <= DRIFT_MAX_OFFSET_MS) {
+        // The correction is what the local clock gained or lost since the last one
+        float sample = -(float)offset_ms * 1e6f / interval_ms;
+        record.drift_ppm = record.drift_known ? record.drift_ppm + DRIFT_WEIGHT * (sample - record.drift_ppm) : sample;
+        record.drift_known = true;
+    }
+    TimeSyncState previous = state;
+    synced_since_boot = true;
+    last_sync_ms = at_ms;
+    last_offset_ms = offset_ms;
+    sync_count++;
+    record.last_sync = (uint32_t)epoch;
+    state = TIME_SYNCED;
+
+    if (stepped) {
+        String log_msg = "NTP sync successful - clock stepped by " + String(offset_ms / 1000) + " s";
+        logger_log(log_msg.c_str());
+    } else if (previous != TIME_SYNCED || abs(offset_ms) >= 1000) {
+        String log_msg = "NTP sync successful - clock corrected by " + String(offset_ms) + " ms";
+        logger_log(log_msg.c_str());
+    }
+    record_seal(record);
+    retained = record;
+    persist_if_due();
+}
+
+void time_sync_init() {
+    memset(&record, 0, sizeof(record));
+    hal_prefs_begin("time", true);
+    TimeRecord stored;
+    size_t len = hal_prefs_get_bytes("record", &stored, sizeof(stored));
+    hal_prefs_end();
+    if (len == sizeof(stored) && record_is_valid(stored)) record = stored;
+    persisted = record;
+    // The RTC copy is updated on every sync, NVS only now and then
+    if (record_is_valid(retained) && retained.last_sync >= record.last_sync) record = retained;
+
+    if (time_sync_is_valid()) {
+        state = TIME_HOLDOVER;
+        String log_msg = "Clock kept across restart";
+        if (record.last_sync) {
+            log_msg += " - last sync " + String((long)(hal_time() - record.last_sync)) + " s ago";
+        }
+        if (record.drift_known) log_msg += ", drift " + String(record.drift_ppm, 1) + " ppm";
+        logger_log(log_msg.c_str());
+    } else {
+        state = TIME_UNSET;
+        logger_log("Waiting for NTP sync");
+    }
+    hal_sntp_start(NTP_SERVER_1, NTP_SERVER_2, TIME_SYNC_INTERVAL_MS, on_sync);
+}
+
+void time_sync_process() {
+    hal_lock_enter(&pending_lock);
+    bool have_sync = pending;
+    time_t epoch = pending_epoch;
+    int32_t offset_ms = pending_offset_ms;
+    bool stepped = pending_stepped;
+    uint32_t at_ms = pending_ms;
+    pending = false;
+    hal_lock_exit(&pending_lock);
+    if (have_sync) apply_sync(epoch, offset_ms, stepped, at_ms);
+
+    if (state == TIME_SYNCED && (int64_t)hal_time() - record.last_sync > TIME_SYNC_STALE_S) {
+        state = TIME_HOLDOVER;
+        String log_msg = "No NTP sync for " + String(TIME_SYNC_STALE_S / 3600) + " h - clock in holdover";
+        logger_log(log_msg.c_str());
+    }
+}
+
+void time_sync_network_up() {
+    hal_sntp_resync();
+}
+
+bool time_sync_is_valid() {
+    return hal_time() >= TIME_VALID_EPOCH;
+}
+
+TimeSyncState time_sync_get_state() {
+    return state;
+}
+
+const char *time_sync_state_name(TimeSyncState s) {
+    switch (s) {
+    case TIME_UNSET: return "unset";
+    case TIME_HOLDOVER: return "holdover";
+    case TIME_SYNCED: return "synced";
+    }
+    return "unknown";
+}
+
+uint32_t time_sync_get_last_sync() {
+    return record.last_sync;
+}
+
+float time_sync_get_drift_ppm() {
+    return record.drift_known ? record.drift_ppm : 0;
+}
+
+int32_t time_sync_get_last_offset_ms() {
+    return last_offset_ms;
+}
+
+uint32_t time_sync_get_sync_count() {
+    return sync_count;
+}
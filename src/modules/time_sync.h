@@ -0,0 +1,33 @@
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+#include <time.h>
+
+// Wall clock state. time_sync_init() starts SNTP in the background (resync every
+// TIME_SYNC_INTERVAL_MS, small corrections slewed) and never waits for it.
+// Each sync measures how far the local clock drifted since the previous one.
+//
+// The ESP32 keeps its clock across a software reset, and the last sync and the
+// drift estimate are kept next to it in RTC memory, so after a warm reboot the
+// clock is used at once (holdover) until SNTP confirms it. The drift estimate
+// also goes to NVS for cold boots, when it changed noticeably or once a day.
+
+#define TIME_VALID_EPOCH 1672531200 // 2023-01-01; an earlier clock was never set
+
+enum TimeSyncState : uint8_t {
+    TIME_UNSET,     // No sync since power-on: the clock is not usable
+    TIME_HOLDOVER,  // Clock kept across a restart, or no sync for TIME_SYNC_STALE_S
+    TIME_SYNCED     // Synced within TIME_SYNC_STALE_S
+};
+
+void time_sync_init();
+void time_sync_process();     // loop(): applies the syncs reported by SNTP
+void time_sync_network_up();  // WiFi connected: sync now rather than at the next retry
+
+bool time_sync_is_valid();    // Any task: the clock can be used for scheduling
+TimeSyncState time_sync_get_state();
+const char *time_sync_state_name(TimeSyncState state);
+uint32_t time_sync_get_last_sync();      // Epoch of the last sync, 0 if none is known
+float time_sync_get_drift_ppm();         // Local clock rate error, positive = runs fast
+int32_t time_sync_get_last_offset_ms();  // Correction applied by the last sync (server minus local)
+uint32_t time_sync_get_sync_count();     // Since power-on
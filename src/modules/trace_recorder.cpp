@@ -0,0 +1,307 @@
+#include "trace_recorder.h"
+#include "batch_runner.h"
+#include "flow_meter.h"
+#include "logger.h"
+#include "metrics.h"
+#include "hal/clock.h"
+#include "hal/fs.h"
+#include "hal/gpio.h"
+#include "hal/isr.h"
+#include "hal/motor.h"
+#include "hal/prefs.h"
+#include "config/config.h"
+
+static_assert(sizeof(TraceHeader) == 8, "trace header layout");
+static_assert(sizeof(TraceCommand) == 24, "trace command layout");
+static_assert(sizeof(TraceState) % 4 == 0, "trace state layout");
+
+// Ring of whole records: [head, tail) is buffered, one byte kept free
+static uint8_t ring[TRACE_BUFFER_SIZE];
+static size_t ring_head = 0;
+static size_t ring_tail = 0;
+static unsigned long ring_dropped = 0; // Since the last write-out
+static hal_lock_t ring_mux = HAL_LOCK_INITIALIZER;
+
+static volatile bool recording = false;
+static volatile bool enabled = false;
+static bool saved_enabled = false;
+static volatile bool clear_requested = false;
+static bool start_pending = false;
+static unsigned long last_flow_pulses = 0;
+static size_t file_bytes = 0;              // Size of TRACE_FILE_PATH, kept here so the loop never asks the filesystem
+static unsigned long last_write_ms = 0;
+
+// Statistics
+static unsigned long records_written = 0;
+static unsigned long records_dropped = 0;
+static unsigned long files_started = 0;
+
+static void HAL_ISR_ATTR ring_copy_in(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    size_t first = TRACE_BUFFER_SIZE - ring_tail;
+    if (first > len) first = len;
+    memcpy(ring + ring_tail, p, first);
+    memcpy(ring, p + first, len - first);
+    ring_tail = (ring_tail + len) % TRACE_BUFFER_SIZE;
+}
+
+static void HAL_ISR_ATTR append(TraceType type, const void *payload, size_t len,
+                                const void *extra = nullptr, size_t extra_len = 0) {
+    if (!recording) return;
+    TraceHeader header = {(uint32_t)hal_millis(), (uint16_t)(len + extra_len), type, 0};
+    size_t total = sizeof(header) + len + extra_len;
+
+    hal_lock_enter_any(&ring_mux);
+    size_t used = (ring_tail + TRACE_BUFFER_SIZE - ring_head) % TRACE_BUFFER_SIZE;
+    if (used + total >= TRACE_BUFFER_SIZE) {
+        ring_dropped++;
+    } else {
+        ring_copy_in(&header, sizeof(header));
+        if (len) ring_copy_in(payload, len);
+        if (extra_len) ring_copy_in(extra, extra_len);
+    }
+    hal_lock_exit_any(&ring_mux);
+}
+
+size_t trace_take(uint8_t *buf, size_t size) {
+    if (size < TRACE_BUFFER_SIZE) return 0;
+    hal_lock_enter_any(&ring_mux);
+    size_t used = (ring_tail + TRACE_BUFFER_SIZE - ring_head) % TRACE_BUFFER_SIZE;
+    size_t first = TRACE_BUFFER_SIZE - ring_head;
+    if (first > used) first = used;
+    memcpy(buf, ring + ring_head, first);
+    memcpy(buf + first, ring, used - first);
+    ring_head = ring_tail;
+    hal_lock_exit_any(&ring_mux);
+    return used;
+}
+
+static void write_record(hal_file_t file, TraceType type, const void *payload, size_t len) {
+    TraceHeader header = {(uint32_t)hal_millis(), (uint16_t)len, type, 0};
+    hal_file_write(file, (const char *)&header, sizeof(header));
+    if (len) hal_file_write(file, (const char *)payload, len);
+}
+
+// Append the ring (and a gap marker if records were lost) to the current file
+static void write_out() {
+    static uint8_t buf[TRACE_BUFFER_SIZE];
+    size_t len = trace_take(buf, sizeof(buf));
+    hal_lock_enter(&ring_mux);
+    unsigned long dropped = ring_dropped;
+    ring_dropped = 0;
+    hal_lock_exit(&ring_mux);
+    last_write_ms = hal_millis();
+    if (len == 0 && dropped == 0) return;
+
+    hal_file_t file = hal_fs_open(TRACE_FILE_PATH, "a");
+    if (!file) return;
+    if (dropped) {
+        TraceGap gap = {(uint32_t)dropped};
+        write_record(file, TRACE_GAP, &gap, sizeof(gap));
+        records_dropped += dropped;
+        file_bytes += sizeof(TraceHeader) + sizeof(gap);
+    }
+    hal_file_write(file, (const char *)buf, len);
+    hal_file_close(file);
+    file_bytes += len;
+
+    for (size_t pos = 0; pos + sizeof(TraceHeader) <= len; records_written++) {
+        pos += sizeof(TraceHeader) + ((const TraceHeader *)(buf + pos))->len;
+    }
+}
+
+static size_t ring_used() {
+    hal_lock_enter(&ring_mux);
+    size_t used = (ring_tail + TRACE_BUFFER_SIZE - ring_head) % TRACE_BUFFER_SIZE;
+    hal_lock_exit(&ring_mux);
+    return used;
+}
+
+static size_t file_size(const char *path) {
+    hal_file_t file = hal_fs_open(path, "r");
+    if (!file) return 0;
+    size_t size = hal_file_size(file);
+    hal_file_close(file);
+    return size;
+}
+
+// Keep the current file as the old one and open a new one with the starting state
+static void start_file() {
+    if (hal_fs_exists(TRACE_FILE_OLD_PATH)) hal_fs_remove(TRACE_FILE_OLD_PATH);
+    if (hal_fs_exists(TRACE_FILE_PATH)) hal_fs_rename(TRACE_FILE_PATH, TRACE_FILE_OLD_PATH);
+
+    TraceState state;
+    memset(&state, 0, sizeof(state));
+    state.magic = TRACE_MAGIC;
+    state.format = TRACE_FORMAT;
+    state.sensor_level = hal_gpio_read(LIQUID_SENSOR_PIN);
+    state.motor_shields = (hal_motor_present(0) ? HAL_MOTOR_SHIELD_MAIN : 0) |
+                          (hal_motor_present(4) ? HAL_MOTOR_SHIELD_EXTRA : 0);
+    state.epoch = (uint32_t)hal_time();
+    settings_capture(state.settings);
+    hal_prefs_begin("fill_model", true);
+    state.fill_model_len = hal_prefs_get_bytes("state", state.fill_model, sizeof(state.fill_model));
+    hal_prefs_end();
+
+    hal_file_t file = hal_fs_open(TRACE_FILE_PATH, "w");
+    if (!file) {
+        logger_log("Trace: cannot create " TRACE_FILE_PATH " - recording stopped");
+        enabled = false;
+        return;
+    }
+    write_record(file, TRACE_STATE, &state, sizeof(state));
+    hal_file_close(file);
+    file_bytes = sizeof(TraceHeader) + sizeof(state);
+    last_write_ms = hal_millis();
+
+    last_flow_pulses = flow_meter_get_pulses();
+    files_started++;
+    recording = true;
+}
+
+void trace_init() {
+    uint8_t stored = 0;
+    hal_prefs_begin("trace", true);
+    hal_prefs_get_bytes("enabled", &stored, sizeof(stored));
+    hal_prefs_end();
+    enabled = saved_enabled = stored != 0;
+    // Every boot starts a new file
+    start_pending = enabled;
+    if (enabled) logger_log("Trace recording enabled - starting when the control loop is idle");
+}
+
+void trace_set_enabled(bool on) {
+    enabled = on;
+}
+
+void trace_clear() {
+    clear_requested = true;
+}
+
+bool trace_is_enabled() {
+    return enabled;
+}
+
+bool trace_is_recording() {
+    return recording;
+}
+
+void trace_process(bool idle) {
+    if (enabled != saved_enabled) {
+        saved_enabled = enabled;
+        uint8_t stored = saved_enabled;
+        hal_prefs_begin("trace", false);
+        hal_prefs_put_bytes("enabled", &stored, sizeof(stored));
+        hal_prefs_end();
+        metrics_count_nvs_commit();
+        if (saved_enabled) {
+            start_pending = true;
+            logger_log("Trace recording enabled - starting when the control loop is idle");
+        } else {
+            recording = false;
+            start_pending = false;
+            write_out();
+            logger_log("Trace recording disabled");
+        }
+    }
+
+    if (clear_requested) {
+        clear_requested = false;
+        recording = false;
+        hal_lock_enter(&ring_mux);
+        ring_head = ring_tail;
+        ring_dropped = 0;
+        hal_lock_exit(&ring_mux);
+        if (hal_fs_exists(TRACE_FILE_PATH)) hal_fs_remove(TRACE_FILE_PATH);
+        if (hal_fs_exists(TRACE_FILE_OLD_PATH)) hal_fs_remove(TRACE_FILE_OLD_PATH);
+        file_bytes = 0;
+        start_pending = enabled;
+        logger_log("Trace files cleared");
+    }
+
+    if (recording) {
+        // Pulses are counted in hardware; one sample per loop pass is as fine
+        // grained as the control code reads them
+        unsigned long pulses = flow_meter_get_pulses();
+        if (pulses < last_flow_pulses) last_flow_pulses = 0; // Counter was reset
+        if (pulses != last_flow_pulses) {
+            TraceFlow flow = {(uint32_t)(pulses - last_flow_pulses)};
+            append(TRACE_FLOW, &flow, sizeof(flow));
+            last_flow_pulses = pulses;
+        }
+        // Batched while busy: each write-out reprograms the file's last flash block
+        if (idle || ring_used() >= TRACE_BUFFER_SIZE / 2 || hal_millis() - last_write_ms >= TRACE_WRITE_INTERVAL_MS) {
+            write_out();
+        }
+
+        if (file_bytes >= TRACE_FILE_SIZE && idle) {
+            start_file();
+        } else if (file_bytes >= 2 * TRACE_FILE_SIZE) {
+            // Busy for too long: stop here and start a fresh file once idle
+            write_out();
+            recording = false;
+            start_pending = true;
+            logger_log("Trace file limit reached while busy - recording paused until idle");
+        }
+    } else if (start_pending && idle) {
+        start_pending = false;
+        start_file();
+    }
+}
+
+void trace_flush() {
+    if (recording) write_out();
+}
+
+String trace_get_status_json() {
+    String json = "{\"enabled\":" + String(enabled ? "true" : "false");
+    json += ",\"recording\":" + String(recording ? "true" : "false");
+    json += ",\"file_bytes\":" + String((unsigned long)file_size(TRACE_FILE_PATH));
+    json += ",\"old_file_bytes\":" + String((unsigned long)file_size(TRACE_FILE_OLD_PATH));
+    json += ",\"files_started\":" + String(files_started);
+    json += ",\"records\":" + String(records_written);
+    json += ",\"dropped\":" + String(records_dropped) + "}";
+    return json;
+}
+
+void HAL_ISR_ATTR trace_record_sensor_edge(bool level) {
+    TraceSensor sensor = {(uint8_t)level, 0, (uint16_t)(hal_micros() % 1000)};
+    append(TRACE_SENSOR, &sensor, sizeof(sensor));
+}
+
+void trace_record_command(const Command &cmd) {
+    TraceCommand record;
+    memset(&record, 0, sizeof(record));
+    record.job_id = cmd.job_id;
+    record.type = cmd.type;
+    memcpy(record.args, cmd.args, sizeof(record.args));
+    record.value = cmd.value;
+    // The payload types are plain structs, so they are stored as they are
+    size_t payload_len = 0;
+    if (cmd.type == CMD_APPLY_SETTINGS) payload_len = sizeof(SettingsPatch);
+    else if (cmd.type == CMD_RUN_BATCH) payload_len = sizeof(BatchProgram);
+    append(TRACE_COMMAND, &record, sizeof(record), cmd.payload, cmd.payload ? payload_len : 0);
+}
+
+void trace_record_schedule() {
+    append(TRACE_SCHEDULE, nullptr, 0);
+}
+
+void trace_record_time_sync(uint32_t epoch) {
+    TraceTimeSync sync = {epoch};
+    append(TRACE_TIME_SYNC, &sync, sizeof(sync));
+}
+
+void trace_record_manual() {
+    append(TRACE_MANUAL, nullptr, 0);
+}
+
+void trace_record_motor(int index, TraceMotorOp op, uint8_t speed) {
+    TraceMotor motor = {(uint8_t)index, op, speed, 0};
+    append(TRACE_MOTOR, &motor, sizeof(motor));
+}
+
+void HAL_ISR_ATTR trace_record_valve(bool open) {
+    TraceValve valve = {(uint8_t)open, {0, 0, 0}};
+    append(TRACE_VALVE, &valve, sizeof(valve));
+}
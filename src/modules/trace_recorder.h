@@ -0,0 +1,132 @@
+#pragma once
+#include <Arduino.h>
+#include "command_queue.h"
+#include "settings_store.h"
+
+// Optional record of everything that drives the control loop: liquid sensor
+// edges, flow meter pulses, queued API commands, scheduler triggers and time
+// syncs. Actuator commands (motors, valve) are recorded alongside as the
+// expected output. The host replay tool (replay/) feeds the inputs back through
+// the control modules on the virtual clock and checks that they issue the same
+// actuator commands.
+//
+// Records go to a RAM ring (safe from interrupts) and loop() appends them to
+// TRACE_FILE_PATH. Each file starts with a TRACE_STATE record holding what the
+// replay needs to start from the same place. New files are only started while
+// the control loop is idle, so no file begins in the middle of a sequence.
+// The previous file is kept as TRACE_FILE_OLD_PATH.
+//
+// File format: a sequence of records, each a TraceHeader followed by len bytes
+// of payload, little-endian, no padding between records.
+
+#define TRACE_FILE_PATH "/trace.bin"
+#define TRACE_FILE_OLD_PATH "/trace_old.bin"
+#define TRACE_MAGIC 0x52544952 // "IRTR"
+#define TRACE_FORMAT 3 // Follows the SettingsBlob and SettingsPatch layouts, which TraceState and settings commands embed
+
+enum TraceType : uint8_t {
+    TRACE_STATE = 1,     // TraceState
+    TRACE_SENSOR,        // TraceSensor: raw liquid sensor edge
+    TRACE_FLOW,          // TraceFlow: flow meter pulses since the last record
+    TRACE_COMMAND,       // TraceCommand, followed by the command payload
+    TRACE_SCHEDULE,      // No payload: scheduler started a sequence
+    TRACE_TIME_SYNC,     // TraceTimeSync
+    TRACE_MANUAL,        // No payload: WebSocket manual control command (not replayable)
+    TRACE_MOTOR,         // TraceMotor
+    TRACE_VALVE,         // TraceValve
+    TRACE_GAP            // TraceGap: records lost to a full ring
+};
+
+struct TraceHeader {
+    uint32_t ms;         // hal_millis() when recorded
+    uint16_t len;        // Payload bytes after the header
+    uint8_t type;        // TraceType
+    uint8_t reserved;
+};
+
+struct TraceState {
+    uint32_t magic;
+    uint16_t format;
+    uint8_t sensor_level;       // Raw liquid sensor input
+    uint8_t motor_shields;      // HAL_MOTOR_SHIELD_* bits
+    uint32_t epoch;             // Wall clock (0 before the first time sync)
+    SettingsBlob settings;      // Live settings, including unsaved edits
+    uint16_t fill_model_len;
+    uint8_t fill_model[30];     // Persisted fill model blob
+};
+
+struct TraceSensor {
+    uint8_t level;
+    uint8_t reserved;
+    uint16_t us;                // Sub-millisecond part of the edge time
+};
+
+struct TraceFlow {
+    uint32_t pulses;
+};
+
+struct TraceCommand {
+    uint32_t job_id;
+    uint8_t type;               // CommandType
+    uint8_t reserved[3];
+    int32_t args[3];
+    float value;
+};
+
+struct TraceTimeSync {
+    uint32_t epoch;
+};
+
+enum TraceMotorOp : uint8_t {
+    TRACE_MOTOR_SPEED,
+    TRACE_MOTOR_FORWARD,
+    TRACE_MOTOR_RELEASE
+};
+
+struct TraceMotor {
+    uint8_t index;              // 0-based, as in hal/motor.h
+    uint8_t op;                 // TraceMotorOp
+    uint8_t speed;              // TRACE_MOTOR_SPEED only
+    uint8_t reserved;
+};
+
+struct TraceValve {
+    uint8_t open;
+    uint8_t reserved[3];
+};
+
+struct TraceGap {
+    uint32_t dropped;
+};
+
+// Loads the persisted enable flag; call once the filesystem is mounted
+void trace_init();
+
+// Requests from any task; applied by trace_process()
+void trace_set_enabled(bool enabled);
+void trace_clear();
+bool trace_is_enabled();
+bool trace_is_recording();
+
+// Control loop, once per pass before the commands: samples the flow meter,
+// starts or rotates the file when idle and writes out the ring. While busy the
+// ring is written out only when half full or TRACE_WRITE_INTERVAL_MS old.
+void trace_process(bool idle);
+void trace_flush(); // Write out the ring now (before a restart or copying the file)
+
+// Move whole buffered records out of the ring; size must be at least
+// TRACE_BUFFER_SIZE. trace_process() uses this, and so does the host replay
+// to capture its own actuator commands.
+size_t trace_take(uint8_t *buf, size_t size);
+
+String trace_get_status_json();
+
+// Recording hooks, no-ops while not recording. The sensor and valve hooks may
+// run in interrupt context.
+void trace_record_sensor_edge(bool level);
+void trace_record_command(const Command &cmd);
+void trace_record_schedule();
+void trace_record_time_sync(uint32_t epoch);
+void trace_record_manual();
+void trace_record_motor(int index, TraceMotorOp op, uint8_t speed);
+void trace_record_valve(bool open);
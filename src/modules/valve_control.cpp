@@ -1,28 +1,48 @@
 #include "valve_control.h"
 #include "logger.h"
-#include <Arduino.h>
+#include "trace_recorder.h"
+#include "hal/gpio.h"
+#include "hal/isr.h"
 #include "config/config.h"
 
-#define VALVE_OPEN HIGH
-#define VALVE_CLOSED LOW
+#define VALVE_OPEN true
+#define VALVE_CLOSED false
 
-static bool valve_open = false;
+static volatile bool valve_open = false;
 
 void valve_control_init() {
-    pinMode(VALVE_PIN, OUTPUT);
-    digitalWrite(VALVE_PIN, VALVE_CLOSED);
+    hal_gpio_output(VALVE_PIN);
+    hal_gpio_write(VALVE_PIN, VALVE_CLOSED);
     valve_open = false;
     logger_log("Valve control initialized - valve closed");
 }
 
 void valve_control_fill_main_tank() {
     logger_log("Main tank valve opened - filling started");
-    digitalWrite(VALVE_PIN, VALVE_OPEN);
+    hal_gpio_write(VALVE_PIN, VALVE_OPEN);
+    trace_record_valve(true);
     valve_open = true;
 }
 
 void valve_control_stop_main_tank() {
     logger_log("Main tank valve closed - filling stopped");
-    digitalWrite(VALVE_PIN, VALVE_CLOSED);
+    hal_gpio_write(VALVE_PIN, VALVE_CLOSED);
+    trace_record_valve(false);
     valve_open = false;
-}
\ No newline at end of file
+}
+
+bool valve_control_is_open() {
+    return valve_open;
+}
+
+// Close the valve from interrupt context (no logging, no blocking).
+// Returns true if the valve was open and has been closed.
+bool HAL_ISR_ATTR valve_control_close_from_isr() {
+    if (!valve_open) {
+        return false;
+    }
+    hal_gpio_write(VALVE_PIN, VALVE_CLOSED);
+    trace_record_valve(false);
+    valve_open = false;
+    return true;
+}
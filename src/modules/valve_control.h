@@ -1,4 +1,6 @@
 #pragma once
 void valve_control_init();
 void valve_control_fill_main_tank();
-void valve_control_stop_main_tank(); 
\ No newline at end of file
+void valve_control_stop_main_tank();
+bool valve_control_is_open();
+bool valve_control_close_from_isr();
@@ -0,0 +1,203 @@
+#include "watering_sequence.h"
+#include "pump_control.h"
+#include "valve_control.h"
+#include "sensors.h"
+#include "fill_model.h"
+#include "flow_meter.h"
+#include "logger.h"
+#include <Arduino.h>
+#include "hal/clock.h"
+#include "config/config.h"
+
+extern unsigned long watering_duration_ms;
+extern float watering_target_ml;
+extern bool sequence_pipelined;
+extern unsigned long fill_offset_ms;
+extern bool watering_pump_active;
+
+static WateringState watering_state = IDLE;
+static unsigned long dosing_start_time = 0;
+static bool fill_started_early = false; // Pipelined mode: fill was started during DOSING
+
+static bool filling = false;
+static unsigned long fill_start_time = 0;
+static unsigned long fill_timeout_ms = MAIN_TANK_FILL_TIMEOUT_MS;
+
+const char *watering_state_name(WateringState state) {
+    switch (state) {
+        case IDLE: return "idle";
+        case DOSING: return "dosing";
+        case FILLING: return "filling";
+        case FILLED: return "filled";
+        case WATERING: return "watering";
+    }
+    return "unknown";
+}
+
+WateringState watering_sequence_get_state() {
+    return watering_state;
+}
+
+void watering_sequence_set_filling(bool on) {
+    filling = on;
+}
+
+bool watering_sequence_is_filling() {
+    return filling;
+}
+
+unsigned long watering_sequence_get_fill_start_ms() {
+    return fill_start_time;
+}
+
+unsigned long watering_sequence_get_fill_timeout_ms() {
+    return fill_timeout_ms;
+}
+
+void start_watering_sequence() {
+    if (watering_state == IDLE) {
+        if (start_fertilizer_dosing()) {
+            dosing_start_time = hal_millis();
+            fill_started_early = false;
+            watering_state = DOSING;
+            logger_log("State: IDLE -> DOSING");
+            logger_flush(); // Ensure sequence start is written
+        } else {
+            logger_log("Watering sequence aborted - not enabled for today");
+            logger_flush(); // Ensure abort message is written
+            // State remains IDLE
+        }
+    }
+}
+
+static void start_tank_fill() {
+    valve_control_fill_main_tank();
+    filling = true;
+    fill_start_time = hal_millis();
+    fill_timeout_ms = fill_model_get_timeout_ms();
+}
+
+// Time from opening the valve to the sensor's full edge
+static unsigned long fill_duration_ms() {
+    unsigned long edge_ms = sensors_get_last_full_edge_ms();
+    // Use the exact edge timestamp when it belongs to this fill
+    if ((long)(edge_ms - fill_start_time) >= 0) {
+        return edge_ms - fill_start_time;
+    }
+    return hal_millis() - fill_start_time;
+}
+
+enum FillProgress {
+    FILL_IN_PROGRESS,
+    FILL_COMPLETE,
+    FILL_FAILED
+};
+
+// Check a running tank fill; closes the valve once the tank is full or the fill timed out
+static FillProgress check_fill_progress() {
+    if (sensors_get_liquid_level()) {
+        valve_control_stop_main_tank();
+        filling = false;
+        fill_model_record(fill_duration_ms(), true);
+        logger_log("Tank filled - sensor detected full level");
+        return FILL_COMPLETE;
+    }
+    if (hal_millis() - fill_start_time > fill_timeout_ms) {
+        valve_control_stop_main_tank();
+        filling = false;
+        fill_model_record(hal_millis() - fill_start_time, false);
+        String log_msg = "[SAFETY] Main tank not full after " + String(fill_timeout_ms) + " ms (expected ~" +
+                         String(fill_model_get_expected_ms()) + " ms) - possible stuck valve or low pressure, valve closed";
+        logger_log(log_msg.c_str());
+        return FILL_FAILED;
+    }
+    return FILL_IN_PROGRESS;
+}
+
+void watering_sequence_run() {
+    switch (watering_state) {
+        case IDLE:
+            break;
+        case DOSING:
+            // Pipelined mode: open the valve while the fertilizer pumps are still running
+            if (sequence_pipelined && !fill_started_early && hal_millis() - dosing_start_time >= fill_offset_ms) {
+                logger_log("Pipelined fill started during dosing");
+                start_tank_fill();
+                fill_started_early = true;
+            }
+            if (fill_started_early && filling && check_fill_progress() == FILL_FAILED && FILL_ANOMALY_ABORTS_SEQUENCE) {
+                pump_control_abort_dosing();
+                logger_log("State: DOSING -> IDLE (fill anomaly, watering aborted)");
+                logger_flush(); // Ensure safety event is written
+                watering_state = IDLE;
+                break;
+            }
+            if (!pump_control_is_dosing()) {
+                // Dosing is complete, move to filling
+                if (fill_started_early) {
+                    logger_log("State: DOSING -> FILLING (fill started during dosing)");
+                } else {
+                    logger_log("State: DOSING -> FILLING");
+                    start_tank_fill();
+                }
+                logger_flush(); // Ensure state transition is written
+                watering_state = FILLING;
+            }
+            break;
+        case FILLING:
+            if (filling) {
+                // The sensor interrupt has already closed the valve on the full edge;
+                // this only advances the state machine
+                FillProgress progress = check_fill_progress();
+                if (progress == FILL_COMPLETE) {
+                    logger_log("State: FILLING -> FILLED");
+                    logger_flush(); // Ensure state transition is written
+                    watering_state = FILLED;
+                } else if (progress == FILL_FAILED) {
+                    if (FILL_ANOMALY_ABORTS_SEQUENCE) {
+                        logger_log("State: FILLING -> IDLE (fill anomaly, watering aborted)");
+                        watering_state = IDLE;
+                    } else {
+                        logger_log("State: FILLING -> FILLED (timeout)");
+                        watering_state = FILLED;
+                    }
+                    logger_flush(); // Ensure safety event is written
+                }
+            } else if (fill_started_early) {
+                logger_log("State: FILLING -> FILLED (fill ended during dosing)");
+                watering_state = FILLED;
+            } else {
+                logger_log("State: FILLING -> FILLED (no fill needed)");
+                watering_state = FILLED;
+            }
+            break;
+        case FILLED: {
+            // Start watering pump for configured time after tank is filled
+            logger_log("State: FILLED -> WATERING");
+            logger_flush(); // Ensure state transition is written
+            if (watering_target_ml > 0 && flow_meter_is_available()) {
+                // Volume mode: the watering duration is the safety limit
+                pump_control_run_watering_pump_volume(watering_target_ml, watering_duration_ms);
+            } else {
+                pump_control_run_watering_pump(watering_duration_ms);
+            }
+            watering_state = WATERING;
+            break;
+        }
+        case WATERING:
+            // Wait for watering to complete (pump will stop automatically)
+            if (!watering_pump_active) {
+                logger_log("Watering pump stopped - sequence finished");
+                logger_log("State: WATERING -> IDLE");
+                logger_flush(); // Ensure completion is written
+                watering_state = IDLE;
+            }
+            break;
+    }
+
+    if (filling && sensors_get_liquid_level()) {
+        valve_control_stop_main_tank();
+        filling = false;
+        logger_log("Tank filled - sensor detected full level (safety check)");
+    }
+}
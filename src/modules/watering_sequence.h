@@ -0,0 +1,25 @@
+#pragma once
+
+// Watering sequence state machine: fertilizer dosing, main tank fill, then the
+// watering pump. start_watering_sequence() kicks it off (scheduler or API) and
+// loop() advances it with watering_sequence_run().
+
+enum WateringState {
+    IDLE,
+    DOSING,
+    FILLING,
+    FILLED,
+    WATERING
+};
+
+void start_watering_sequence();
+void watering_sequence_run();
+WateringState watering_sequence_get_state();
+const char *watering_state_name(WateringState state);
+
+// Main tank fill tracking, also used for fills started outside the sequence
+// (API, debug); a tracked fill is stopped as soon as the sensor reports full
+void watering_sequence_set_filling(bool filling);
+bool watering_sequence_is_filling();
+unsigned long watering_sequence_get_fill_start_ms();
+unsigned long watering_sequence_get_fill_timeout_ms();
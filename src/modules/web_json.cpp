@@ -0,0 +1,125 @@
+#include "web_json.h"
+#include "logger.h"
+#include "state_snapshot.h"
+#include "time_sync.h"
+#include "watering_sequence.h"
+#include "hal/clock.h"
+#include <ArduinoJson.h>
+#include <string.h>
+#include <time.h>
+
+extern bool weekly_watering_enabled[7];
+
+void web_json_time_fields(const StateSnapshot &snap, time_t now, JsonObject out) {
+    if (snap.time_synced_epoch) {
+        out["time_sync_age_s"] = (long)(now - snap.time_synced_epoch);
+    }
+    if (snap.next_run_epoch) {
+        time_t next_run = snap.next_run_epoch;
+        struct tm next_tm;
+        char next_buf[24];
+        localtime_r(&next_run, &next_tm);
+        strftime(next_buf, sizeof(next_buf), "%Y-%m-%d %H:%M", &next_tm);
+        out["next_run"] = next_buf;
+        out["next_run_in_s"] = (long)(next_run - now);
+    } else {
+        out["next_run"] = "none";
+    }
+}
+
+// Everything /api/status reports about the control state comes from the
+// published snapshot, so one response never mixes two loop passes.
+size_t web_json_status(char *buf, size_t size) {
+    StateSnapshot snap;
+    if (!state_snapshot_read(snap)) {
+        memset(&snap, 0, sizeof(snap)); // Before the first loop pass, or the loop held it too long
+    }
+    uint32_t now_ms = hal_millis();
+
+    StaticJsonDocument<1024> doc;
+    doc["tank_full"] = snap.tank_full;
+    doc["filling"] = snap.filling;
+    doc["humidifier_pump"] = snap.humidifier_pump;
+    doc["watering_pump"] = snap.watering_pump;
+    doc["watering_duration_ms"] = snap.watering_duration_ms;
+    doc["ota_ready"] = true;
+    
+    // Add watering enabled status for today
+    time_t now = hal_time();
+    struct tm timeinfo;
+    int current_day = 0;
+    if (localtime_r(&now, &timeinfo)) {
+        current_day = timeinfo.tm_wday;
+        char time_buf[64];
+        strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S %Z", &timeinfo);
+        doc["time"] = time_buf;
+    } else {
+        doc["time"] = "N/A";
+    }
+    doc["watering_today"] = weekly_watering_enabled[current_day];
+    doc["ntp_synced"] = snap.ntp_synced;
+    doc["time_state"] = time_sync_state_name((TimeSyncState)snap.time_state);
+    doc["clock_drift_ppm"] = snap.clock_drift_ppm;
+    web_json_time_fields(snap, now, doc.as<JsonObject>());
+    doc["valve_open"] = snap.valve_open;
+    doc["watering_state"] = watering_state_name((WateringState)snap.watering_state);
+    doc["dosing_stage"] = snap.dosing_stage;
+    if (snap.dosing_stage >= 0) {
+        doc["dosing_remaining_ms"] = state_snapshot_remaining_ms(snap.dosing_end_ms, now_ms);
+    }
+    if (snap.humidifier_pump) {
+        doc["humidifier_remaining_ms"] = state_snapshot_remaining_ms(snap.humidifier_end_ms, now_ms);
+    }
+    if (snap.watering_pump) {
+        doc["watering_remaining_ms"] = state_snapshot_remaining_ms(snap.watering_end_ms, now_ms);
+    }
+    if (snap.filling) {
+        doc["fill_elapsed_ms"] = now_ms - snap.fill_start_ms;
+        doc["fill_timeout_ms"] = snap.fill_timeout_ms;
+    }
+    JsonArray pump_speed = doc.createNestedArray("pump_speed"); // Motor channels 1-7
+    for (int ch = 0; ch < SNAPSHOT_CHANNELS; ch++) {
+        pump_speed.add(snap.pump_speed[ch]);
+    }
+    doc["state_version"] = snap.version;
+    doc["watering_volume_ml"] = snap.watering_volume_ml;
+    doc["sensor_edges"] = snap.sensor_edges;
+    doc["sensor_glitches"] = snap.sensor_glitches;
+    doc["valve_close_latency_us"] = snap.valve_close_latency_us;
+    serializeJson(doc, buf, size);
+    return measureJson(doc);
+}
+
+String web_json_logs(int max_lines) {
+    String logs = logger_get_logs(max_lines);
+    
+    // Parse logs into an array for better readability
+    DynamicJsonDocument doc(logs.length() + 2048); // Extra space for JSON overhead
+    JsonArray logsArray = doc.createNestedArray("logs");
+    
+    if (logs.length() == 0 || logs == "null" || logs == "No log file found" || logs == "Log file is empty") {
+        logsArray.add("No logs available");
+    } else {
+        // Split logs by newline and add each entry to the array
+        int startIdx = 0;
+        int endIdx = 0;
+        while ((endIdx = logs.indexOf('\n', startIdx)) != -1) {
+            String line = logs.substring(startIdx, endIdx);
+            if (line.length() > 0) {
+                logsArray.add(line);
+            }
+            startIdx = endIdx + 1;
+        }
+        // Add last line if exists
+        if (startIdx < logs.length()) {
+            String line = logs.substring(startIdx);
+            if (line.length() > 0) {
+                logsArray.add(line);
+            }
+        }
+    }
+    
+    String response;
+    serializeJson(doc, response);
+    return response;
+}
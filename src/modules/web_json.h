@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <time.h>
+#include "state_snapshot.h"
+
+// ArduinoJson response bodies that are served by the device web server and by
+// the host stand-in server in loadtest/.
+
+// /api/status from the published state snapshot. Returns the full length
+// needed (snprintf semantics), so it can back a response cache slot.
+size_t web_json_status(char *buf, size_t size);
+
+// time_sync_age_s, next_run and next_run_in_s as in /api/status; the event
+// stream sends them in a delta when the sync time or the next run changes
+void web_json_time_fields(const StateSnapshot &snap, time_t now, JsonObject out);
+
+// /api/logs: the last max_lines log lines as {"logs":[...]}
+String web_json_logs(int max_lines);
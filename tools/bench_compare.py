@@ -0,0 +1,77 @@
+"""Compare two benchmark JSON results, e.g. from bench/logger_bench.cpp or loadtest/loadgen.cpp.
+
+    python3 tools/bench_compare.py before.json after.json [--threshold 10]
+
+Prints every numeric result that exists in both files with its relative
+change. Latencies, costs, drops, error rates and allocations are worse when
+they grow; throughput (*_per_s) and free heap are worse when they shrink.
+Exits with status 1 if any of them got worse by more than the threshold
+(percent), so it can gate a CI job.
+The config section, call and entry counts, and single worst-case samples (max_*) are
+shown but never fail the comparison; they are too noisy on a shared host.
+"""
+
+import argparse
+import json
+import sys
+
+HIGHER_IS_WORSE = ("_ns", "_ms", "ns_per_entry", "dropped", "drop_rate", "error_rate", "max_queue",
+                   "per_enqueue", "per_written_entry")
+LOWER_IS_WORSE = ("_per_s", "min_free_heap", "min_largest_block")
+
+
+def flatten(value, prefix=""):
+    if isinstance(value, dict):
+        for key, item in value.items():
+            yield from flatten(item, prefix + "." + key if prefix else key)
+    elif isinstance(value, (int, float)) and not isinstance(value, bool):
+        yield prefix, value
+
+
+def direction(key):
+    if key.startswith("config."):
+        return 0
+    name = key.rsplit(".", 1)[-1]
+    if name.startswith("max_") and name != "max_queue":
+        return 0
+    if name.endswith(HIGHER_IS_WORSE):
+        return 1
+    if name.endswith(LOWER_IS_WORSE):
+        return -1
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed regression in percent")
+    args = parser.parse_args()
+
+    with open(args.before) as f:
+        before = dict(flatten(json.load(f)))
+    with open(args.after) as f:
+        after = dict(flatten(json.load(f)))
+
+    regressions = 0
+    for key in before:
+        if key not in after:
+            continue
+        old, new = before[key], after[key]
+        if old == new:
+            change = 0.0
+        elif old == 0:
+            change = float("inf")
+        else:
+            change = (new - old) * 100.0 / abs(old)
+        worse = direction(key) * change > args.threshold
+        regressions += worse
+        print("%-40s %14g %14g %+9.1f%%%s" % (key, old, new, change, "  REGRESSION" if worse else ""))
+
+    if regressions:
+        print("%d result(s) regressed by more than %g%%" % (regressions, args.threshold))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
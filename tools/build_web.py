@@ -0,0 +1,126 @@
+"""Build the web UI into the LittleFS image.
+
+Splits web/index.html into its inline stylesheet and script, minifies all
+three, and writes gzipped files to data/:
+
+    data/index.html.gz               HTML shell, revalidated on every load
+    data/assets/app.<hash>.css.gz    immutable, cached for a year
+    data/assets/app.<hash>.js.gz     immutable, cached for a year
+    data/web_version.txt             hash of the shell, used as its ETag
+
+The minifiers are deliberately conservative (whitespace and whole-line
+comments only) so they cannot change the meaning of the page.
+
+Runs automatically before buildfs/uploadfs as a PlatformIO extra script,
+or by hand: python3 tools/build_web.py
+"""
+
+import gzip
+import hashlib
+import os
+import re
+
+HASH_LEN = 10
+
+
+def minify_css(css):
+    css = re.sub(r"/\*.*?\*/", "", css, flags=re.S)
+    css = re.sub(r"\s+", " ", css)
+    css = re.sub(r"\s*([{};,>])\s*", r"\1", css)
+    css = css.replace(";}", "}")
+    return css.strip()
+
+
+def minify_js(js):
+    # Keep line breaks so automatic semicolon insertion behaves the same
+    lines = []
+    for line in js.splitlines():
+        line = line.strip()
+        if not line or line.startswith("//"):
+            continue
+        lines.append(line)
+    return "\n".join(lines)
+
+
+def minify_html(html):
+    lines = [line.strip() for line in html.splitlines()]
+    html = "\n".join(line for line in lines if line)
+    return re.sub(r">\n<", "><", html)
+
+
+def gzip_bytes(data):
+    # Fixed mtime keeps the output (and the image) reproducible
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:HASH_LEN]
+
+
+def write_file(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def extract(pattern, html, name):
+    match = re.search(pattern, html, flags=re.S)
+    if not match:
+        raise SystemExit("build_web: no inline <%s> block in web/index.html" % name)
+    return match
+
+
+def build(project_dir):
+    src_path = os.path.join(project_dir, "web", "index.html")
+    data_dir = os.path.join(project_dir, "data")
+    assets_dir = os.path.join(data_dir, "assets")
+
+    with open(src_path, encoding="utf-8") as f:
+        html = f.read()
+
+    style = extract(r"<style>(.*?)</style>", html, "style")
+    css = minify_css(style.group(1)).encode("utf-8")
+    script = extract(r"<script>(.*?)</script>", html, "script")
+    js = minify_js(script.group(1)).encode("utf-8")
+
+    css_name = "app.%s.css" % content_hash(css)
+    js_name = "app.%s.js" % content_hash(js)
+
+    # Script moves to the head with defer so it still runs after the DOM is parsed
+    shell = html[:style.start()] + '<link rel="stylesheet" href="/assets/%s">' % css_name
+    shell += '<script src="/assets/%s" defer></script>' % js_name
+    shell += html[style.end():script.start()] + html[script.end():]
+    shell = minify_html(shell).encode("utf-8")
+
+    # Drop assets from earlier builds
+    if os.path.isdir(assets_dir):
+        for name in os.listdir(assets_dir):
+            if name.startswith("app."):
+                os.remove(os.path.join(assets_dir, name))
+
+    outputs = [
+        (os.path.join(data_dir, "index.html.gz"), gzip_bytes(shell)),
+        (os.path.join(assets_dir, css_name + ".gz"), gzip_bytes(css)),
+        (os.path.join(assets_dir, js_name + ".gz"), gzip_bytes(js)),
+        (os.path.join(data_dir, "web_version.txt"), content_hash(shell).encode("ascii")),
+    ]
+    for path, data in outputs:
+        write_file(path, data)
+
+    source_bytes = len(html.encode("utf-8"))
+    first_load = sum(len(data) for path, data in outputs[:3])
+    print("build_web: %d bytes source -> %d bytes gzipped (shell %d, css %d, js %d)" % (
+        source_bytes, first_load, len(outputs[0][1]), len(outputs[1][1]), len(outputs[2][1])))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+except NameError:
+    env = None
+
+if env is None:
+    build(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+else:
+    fs_targets = {"buildfs", "uploadfs", "uploadfsota"}
+    if fs_targets & set(COMMAND_LINE_TARGETS):  # noqa: F821
+        build(env.subst("$PROJECT_DIR"))
@@ -0,0 +1,5 @@
+# PlatformIO extra script for [env:native_asan]: the native platform passes
+# build_flags to the compiler only, so the sanitizer runtime is linked here.
+Import("env")
+
+env.Append(LINKFLAGS=["-fsanitize=address,undefined"])